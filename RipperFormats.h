@@ -117,6 +117,19 @@ struct RipResults
 		animation_frames_ripped(0), strings_ripped(0),
 		palettes_ripped(0),	audio_ripped(0), data_ripped(0) { };
 
+	// add the counts of a partial rip
+	RipResults& operator+=(const RipResults& other)
+	{
+		graphics_ripped += other.graphics_ripped;
+		animations_ripped += other.animations_ripped;
+		animation_frames_ripped += other.animation_frames_ripped;
+		audio_ripped += other.audio_ripped;
+		strings_ripped += other.strings_ripped;
+		palettes_ripped += other.palettes_ripped;
+		data_ripped += other.data_ripped;
+		return *this;
+	}
+
 	int graphics_ripped;
 	int animations_ripped;
 	int animation_frames_ripped;
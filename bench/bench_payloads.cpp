@@ -0,0 +1,298 @@
+#include "bench_payloads.h"
+
+#include <algorithm>
+
+namespace DecodeBench
+{
+
+
+namespace
+{
+
+class Random
+{
+public:
+	Random(unsigned int seed)
+		: state(seed * 2654435761u + 1) { };
+
+	// uniform in [0, n)
+	int next(int n)
+	{
+		state = state * 1664525u + 1013904223u;
+		return static_cast<int>((state >> 8) % static_cast<unsigned int>(n));
+	}
+
+private:
+	unsigned int state;
+};
+
+// least significant bit first, as read by RLBitReader
+class BitWriter
+{
+public:
+	BitWriter(std::vector<char>& o)
+		: out(o), bitpos(8) { };
+
+	void put(int value, int nbits)
+	{
+		for (int i = 0; i < nbits; i++)
+		{
+			if (bitpos == 8)
+			{
+				out.push_back(0);
+				bitpos = 0;
+			}
+			if ((value >> i) & 1)
+				out.back() |= static_cast<char>(1 << bitpos);
+			++bitpos;
+		}
+	}
+
+private:
+	std::vector<char>& out;
+	int bitpos;
+};
+
+void put_word_le(std::vector<char>& out, int pos, int value)
+{
+	out[pos] = static_cast<char>(value & 0xFF);
+	out[pos + 1] = static_cast<char>((value >> 8) & 0xFF);
+}
+
+int run_length(const std::vector<int>& pixels, int start, int end, int maxrun)
+{
+	int run = 1;
+	while (start + run < end && run < maxrun && pixels[start + run] == pixels[start])
+		++run;
+	return run;
+}
+
+};
+
+
+std::vector<int> make_scene(int width, int height, int numcolors, int meanrun,
+	unsigned int seed)
+{
+	Random rng(seed);
+	std::vector<int> pixels(width * height);
+	int color = rng.next(numcolors);
+	for (int y = 0; y < height; y++)
+	{
+		int x = 0;
+		while (x < width)
+		{
+			int run = 1 + rng.next(meanrun * 2);
+			bool repeat = (y > 0 && rng.next(10) < 7);
+			if (!repeat)
+			{
+				if (rng.next(10) < 7)
+					color += rng.next(7) - 3;
+				else
+					color = rng.next(numcolors);
+				color = std::max(0, std::min(numcolors - 1, color));
+			}
+			for (int i = 0; i < run && x < width; i++, x++)
+				pixels[x + y * width] = repeat ? pixels[x + (y - 1) * width] : color;
+		}
+	}
+	return pixels;
+}
+
+std::vector<int> to_column_major(const std::vector<int>& pixels, int width, int height)
+{
+	std::vector<int> out(pixels.size());
+	for (int x = 0; x < width; x++)
+		for (int y = 0; y < height; y++)
+			out[x * height + y] = pixels[x + y * width];
+	return out;
+}
+
+std::vector<char> encode_bitstream(const std::vector<int>& pixels, int bpabsol,
+	int bprel, bool exprange)
+{
+	std::vector<char> out;
+	out.push_back(static_cast<char>(pixels[0]));
+	BitWriter bits(out);
+
+	int n = pixels.size();
+	int prev = pixels[0];
+	bool shiftisdown = true;
+	int i = 1;
+	while (i < n)
+	{
+		int color = pixels[i];
+		int diff = color - prev;
+
+		if (diff == 0)
+		{
+			// long runs use the 8-bit run length code where available
+			int run = run_length(pixels, i, n, 255);
+			if (bprel == 3 && !exprange && run >= 12)
+			{
+				bits.put(3, 2);
+				bits.put(4, 3);
+				bits.put(run, 8);
+				i += run;
+			}
+			else
+			{
+				bits.put(0, 1);
+				++i;
+			}
+			continue;
+		}
+
+		if (bprel == 1 && (diff == 1 || diff == -1))
+		{
+			bool wantdown = (diff == -1);
+			bits.put(3, 2);
+			bits.put(wantdown != shiftisdown ? 1 : 0, 1);
+			shiftisdown = wantdown;
+		}
+		else if (bprel == 3 && !exprange && diff >= -4 && diff <= 3)
+		{
+			bits.put(3, 2);
+			bits.put(diff + 4, 3);
+		}
+		else if (bprel == 3 && exprange && diff >= -4 && diff <= 4)
+		{
+			bits.put(3, 2);
+			bits.put(diff < 0 ? diff + 4 : diff + 3, 3);
+		}
+		else
+		{
+			bits.put(1, 2);
+			bits.put(color, bpabsol);
+			if (bprel == 1)
+				shiftisdown = true;
+		}
+		prev = color;
+		++i;
+	}
+	return out;
+}
+
+std::vector<char> encode_lined_rle(const std::vector<int>& pixels, int width, int height,
+	int skipcolor)
+{
+	std::vector<char> out;
+	for (int y = 0; y < height; y++)
+	{
+		int linestart = out.size();
+		out.push_back(0);
+		out.push_back(0);
+
+		int rowstart = y * width;
+		int rowend = rowstart + width;
+		int i = rowstart;
+		while (i < rowend)
+		{
+			if (pixels[i] == skipcolor)
+			{
+				int run = run_length(pixels, i, rowend, 127);
+				out.push_back(static_cast<char>((run << 1) | 1));
+				i += run;
+				continue;
+			}
+
+			int run = run_length(pixels, i, rowend, 64);
+			if (run >= 2)
+			{
+				out.push_back(static_cast<char>(((run - 1) << 2) | 2));
+				out.push_back(static_cast<char>(pixels[i]));
+				i += run;
+				continue;
+			}
+
+			// absolute run up to the next repeat or skip
+			int count = 1;
+			while (i + count < rowend && count < 64
+				&& pixels[i + count] != skipcolor
+				&& run_length(pixels, i + count, rowend, 2) < 2)
+				++count;
+			out.push_back(static_cast<char>((count - 1) << 2));
+			for (int j = 0; j < count; j++)
+				out.push_back(static_cast<char>(pixels[i + j]));
+			i += count;
+		}
+		put_word_le(out, linestart, out.size() - linestart - 2);
+	}
+	return out;
+}
+
+std::vector<char> encode_multicomp_rle(const std::vector<int>& pixels, int clrshift)
+{
+	std::vector<char> out;
+	int runmask = (1 << clrshift) - 1;
+	int n = pixels.size();
+	int i = 0;
+	while (i < n)
+	{
+		int run = run_length(pixels, i, n, 255);
+		if (run <= runmask)
+		{
+			out.push_back(static_cast<char>((pixels[i] << clrshift) | run));
+		}
+		else
+		{
+			out.push_back(static_cast<char>(pixels[i] << clrshift));
+			out.push_back(static_cast<char>(run));
+		}
+		i += run;
+	}
+	return out;
+}
+
+std::vector<char> build_smap(const std::vector<int>& pixels, int width, int height,
+	const std::vector<int>& encodings)
+{
+	int strips = width/8;
+	std::vector<char> out(8 + strips * 4);
+	out[0] = 'S';
+	out[1] = 'M';
+	out[2] = 'A';
+	out[3] = 'P';
+
+	for (int i = 0; i < strips; i++)
+	{
+		int encoding = encodings[i % encodings.size()];
+		int offset = out.size();
+		put_word_le(out, 8 + i * 4, offset & 0xFFFF);
+		put_word_le(out, 10 + i * 4, offset >> 16);
+		out.push_back(static_cast<char>(encoding));
+
+		std::vector<int> strip(8 * height);
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < 8; x++)
+				strip[x + y * 8] = pixels[i * 8 + x + y * width];
+
+		std::vector<char> data;
+		if (encoding == 1)
+		{
+			for (int j = 0; j < 8 * height; j++)
+				data.push_back(static_cast<char>(strip[j]));
+		}
+		else if (encoding == 8 || encoding == 9)
+		{
+			data = encode_lined_rle(strip, 8, height, -1);
+		}
+		else
+		{
+			bool vertical = (encoding >= 0xE && encoding <= 0x12)
+				|| (encoding >= 0x22 && encoding <= 0x26);
+			data = encode_bitstream(vertical ? to_column_major(strip, 8, height) : strip,
+				encoding % 10, (encoding <= 0x30) ? 1 : 3, encoding >= 0x86);
+		}
+		out.insert(out.end(), data.begin(), data.end());
+	}
+
+	int size = out.size();
+	out[4] = static_cast<char>((size >> 24) & 0xFF);
+	out[5] = static_cast<char>((size >> 16) & 0xFF);
+	out[6] = static_cast<char>((size >> 8) & 0xFF);
+	out[7] = static_cast<char>(size & 0xFF);
+	return out;
+}
+
+
+};	// end namespace DecodeBench
@@ -0,0 +1,41 @@
+/* Synthetic image payloads for decode_bench: a pseudo-random "scene"
+   generator plus encoders for the bitstream, lined RLE, multicomp RLE
+   and SMAP formats */
+
+#include <vector>
+
+namespace DecodeBench
+{
+
+
+// deterministic scene of width x height pixels in [0, numcolors):
+// horizontal runs of roughly meanrun pixels, mostly small color steps
+// (as in shaded backgrounds), and rows that largely repeat the one above
+std::vector<int> make_scene(int width, int height, int numcolors, int meanrun,
+	unsigned int seed);
+
+// reorder a row-major pixel array into column-major order
+std::vector<int> to_column_major(const std::vector<int>& pixels, int width, int height);
+
+// encode pixels (given in drawing order) as a bitstream image: one byte
+// giving the first color, then the 0/10/11 coded bitstream
+std::vector<char> encode_bitstream(const std::vector<int>& pixels, int bpabsol,
+	int bprel, bool exprange);
+
+// encode row-major pixels as lined RLE; pixels of skipcolor are emitted
+// as skip counts (pass -1 for none)
+std::vector<char> encode_lined_rle(const std::vector<int>& pixels, int width, int height,
+	int skipcolor);
+
+// encode column-major pixels as 16/32/64-color AKOS RLE
+std::vector<char> encode_multicomp_rle(const std::vector<int>& pixels, int clrshift);
+
+// build a complete SMAP chunk (header included) from row-major pixels,
+// using encodings[i % encodings.size()] for strip i
+std::vector<char> build_smap(const std::vector<int>& pixels, int width, int height,
+	const std::vector<int>& encodings);
+
+
+};	// end namespace DecodeBench
+
+#pragma once
\ No newline at end of file
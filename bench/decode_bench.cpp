@@ -0,0 +1,473 @@
+/* decode_bench: times the image decoders on synthetic but representative
+   payloads and checks their output against the reference (pre-kernel)
+   decoders. Build with "make bench" */
+
+#include "bench_payloads.h"
+#include "reference_decoders.h"
+
+#include "../modules/humongous_structs.h"
+#include "../modules/humongous_rip.h"
+#include "../utils/BitmapData.h"
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+using namespace DecodeBench;
+using namespace Humongous;
+using namespace RipUtil;
+
+namespace
+{
+
+const int localtransind = 5;
+const int transind = 0;
+
+// a benchmark case: run() decodes the payload with the current decoders,
+// run_reference() with the reference ones
+class BenchCase
+{
+public:
+	virtual ~BenchCase() { };
+	virtual std::string name() const =0;
+	virtual int numpixels() const =0;
+	virtual void run(BitmapData& bmap) =0;
+	virtual void run_reference(RefImage& img) =0;
+};
+
+class SMAPCase : public BenchCase
+{
+public:
+	SMAPCase(const std::string& n, int w, int h, const std::vector<int>& encodings,
+		int threads = 1)
+		: casename(n), width(w), height(h), threads(threads)
+	{
+		std::vector<int> scene = make_scene(width, height, 256, 12, 1);
+		std::vector<char> data = build_smap(scene, width, height, encodings);
+		smapc.resize(data.size());
+		std::memcpy(smapc.data, &data[0], data.size());
+		smapc.size = data.size();
+		smapc.type = smap;
+	}
+	std::string name() const { return casename; }
+	int numpixels() const { return width * height; }
+	void run(BitmapData& bmap)
+	{
+		smap_decoding_threads = threads;
+		decode_smap(smapc, bmap, width, height, localtransind, transind);
+		smap_decoding_threads = 1;
+	}
+	void run_reference(RefImage& img)
+	{
+		img = RefImage(width, height, transind);
+		ref_decode_smap(smapc.data, smapc.datasize, img, localtransind, transind);
+	}
+
+private:
+	std::string casename;
+	int width;
+	int height;
+	int threads;
+	SputmChunk smapc;
+};
+
+class AKOSCase : public BenchCase
+{
+public:
+	// numcolors 2 = bitstream-encoded 2-color AKOS, otherwise multicomp RLE
+	AKOSCase(const std::string& n, int w, int h, int numcolors, bool deindex, bool remap)
+		: casename(n), width(w), height(h), deindex(deindex), remap(remap)
+	{
+		akosc.numcolors = numcolors;
+		akosc.akpl_chunk.alttrans = localtransind;
+
+		std::vector<char> data;
+		if (numcolors == 2)
+		{
+			std::vector<int> scene = make_scene(width, height, 256, 6, 2);
+			data = encode_bitstream(scene, 8, 3, false);
+			data.insert(data.begin(), 8);
+		}
+		else
+		{
+			int clrshift = (numcolors == 16) ? 4 : (numcolors == 32) ? 3 : 2;
+			std::vector<int> scene = make_scene(width, height, numcolors, 6, 3);
+			data = encode_multicomp_rle(to_column_major(scene, width, height), clrshift);
+			for (int i = 0; i < numcolors; i++)
+				colormap.push_back((i * 7 + 16) & 0xFF);
+		}
+		for (int i = 0; i < 256; i++)
+			colorremap.push_back(255 - i);
+
+		AKCDEntry akcde;
+		akcde.resize(data.size());
+		std::memcpy(akcde.imgdat, &data[0], data.size());
+		akcde.width = width;
+		akcde.height = height;
+		akosc.akcd_entries.push_back(akcde);
+	}
+	std::string name() const { return casename; }
+	int numpixels() const { return width * height; }
+	void run(BitmapData& bmap)
+	{
+		decode_akos(akosc, bmap, 0, palette, localtransind, transind,
+			colormap, deindex, colorremap, remap);
+	}
+	void run_reference(RefImage& img)
+	{
+		img = RefImage(width, height, transind);
+		const AKCDEntry& akcde = akosc.akcd_entries[0];
+		if (akosc.numcolors == 2)
+			ref_decode_bitstream_img(akcde.imgdat + 1, akcde.size - 1, img, 0, 0,
+				width, height, 8, 3, true, true, false, localtransind, transind,
+				colorremap, remap);
+		else
+			ref_decode_multicomp_rle(akcde.imgdat, width, height, img, akosc.numcolors,
+				colormap, deindex, colorremap, remap);
+	}
+
+private:
+	std::string casename;
+	int width;
+	int height;
+	bool deindex;
+	bool remap;
+	AKOSChunk akosc;
+	BitmapPalette palette;
+	ColorMap colormap;
+	ColorMap colorremap;
+};
+
+class AWIZCase : public BenchCase
+{
+public:
+	AWIZCase(const std::string& n, int w, int h, int meanrun)
+		: casename(n)
+	{
+		awizc.width = w;
+		awizc.height = h;
+		std::vector<int> scene = make_scene(w, h, 256, meanrun, 4);
+		std::vector<char> data = encode_lined_rle(scene, w, h, localtransind);
+		awizc.wizd_chunk.resize(data.size() + 8);
+		std::memcpy(awizc.wizd_chunk.data + 8, &data[0], data.size());
+		awizc.wizd_chunk.size = data.size() + 8;
+	}
+	std::string name() const { return casename; }
+	int numpixels() const { return awizc.width * awizc.height; }
+	void run(BitmapData& bmap)
+	{
+		decode_awiz(awizc, bmap, palette, localtransind, transind);
+	}
+	void run_reference(RefImage& img)
+	{
+		img = RefImage(awizc.width, awizc.height, transind);
+		ref_decode_lined_rle(awizc.wizd_chunk.data + 8, awizc.wizd_chunk.datasize, img,
+			0, 0, awizc.width, awizc.height, localtransind, transind, true,
+			ColorMap(), false);
+	}
+
+private:
+	std::string casename;
+	AWIZChunk awizc;
+	BitmapPalette palette;
+};
+
+// an AKOS sequence frame: components with transparent areas composited
+// onto a canvas, some of them hanging off its edges
+class BlitCase : public BenchCase
+{
+public:
+	BlitCase(const std::string& n, int w, int h, int numcomponents)
+		: casename(n), width(w), height(h)
+	{
+		for (int i = 0; i < numcomponents; i++)
+		{
+			int cw = 96 + (i % 3) * 32;
+			int ch = 240 - (i % 2) * 64;
+			std::vector<int> scene = make_scene(cw, ch, 16, 12, 10 + i);
+			BitmapData comp(cw, ch, 8, true);
+			std::memcpy(comp.get_pixels(), &scene[0], scene.size() * sizeof(int));
+			components.push_back(comp);
+			xpos.push_back((i * 97) % (w + 64) - 64);
+			ypos.push_back((i * 61) % (h + 32) - 32);
+		}
+	}
+	std::string name() const { return casename; }
+	int numpixels() const { return width * height; }
+	void run(BitmapData& bmap)
+	{
+		bmap.resize_pixels(width, height, 8);
+		bmap.clear(transind);
+		for (std::vector<BitmapData>::size_type i = 0; i < components.size(); i++)
+			bmap.blit_bitmapdata(components[i], xpos[i], ypos[i], localtransind);
+	}
+	void run_reference(RefImage& img)
+	{
+		img = RefImage(width, height, transind);
+		for (std::vector<BitmapData>::size_type i = 0; i < components.size(); i++)
+		{
+			BitmapData& comp = components[i];
+			RefImage src(comp.get_width(), comp.get_height(), 0);
+			std::memcpy(&src.pixels[0], comp.get_pixels(), src.pixels.size() * sizeof(int));
+			ref_blit_masked(img, src, xpos[i], ypos[i], localtransind);
+		}
+	}
+
+private:
+	std::string casename;
+	int width;
+	int height;
+	std::vector<BitmapData> components;
+	std::vector<int> xpos;
+	std::vector<int> ypos;
+};
+
+// a font of uncompressed n bpp glyphs of varying width, decoded to a sheet
+class CHARCase : public BenchCase
+{
+public:
+	CHARCase(const std::string& n, int numglyphs, int glyphheight, int bpp)
+		: casename(n), sheetwidth(256)
+	{
+		charc.compr = bpp;
+		charc.rowspace = glyphheight;
+		for (int i = 0; i < numglyphs; i++)
+		{
+			CHAREntry chare;
+			chare.charnum = 32 + i;
+			chare.width = 6 + i % 11;
+			chare.height = glyphheight;
+			int numbytes = (chare.width * chare.height * bpp + 7) / 8;
+			chare.resize(numbytes);
+			unsigned int seed = 1234 + i;
+			for (int j = 0; j < numbytes; j++)
+			{
+				seed = seed * 1103515245 + 12345;
+				chare.data[j] = static_cast<char>(seed >> 16);
+			}
+			charc.char_entries.push_back(chare);
+		}
+		decode_char_sheet(charc, sheet, entries, sheetwidth, palette, localtransind, transind);
+	}
+	std::string name() const { return casename; }
+	int numpixels() const { return sheet.get_width() * sheet.get_height(); }
+	void run(BitmapData& bmap)
+	{
+		decode_char_sheet(charc, bmap, entries, sheetwidth, palette, localtransind, transind);
+	}
+	void run_reference(RefImage& img)
+	{
+		img = RefImage(sheet.get_width(), sheet.get_height(), transind);
+		for (std::vector<CHAREntry>::size_type i = 0; i < charc.char_entries.size(); i++)
+		{
+			const CHAREntry& chare = charc.char_entries[i];
+			ref_decode_char_bits(chare.data, chare.datalen, img, entries[i].x, entries[i].y,
+				chare.width, chare.height, charc.compr);
+		}
+	}
+
+private:
+	std::string casename;
+	int sheetwidth;
+	CHARChunk charc;
+	BitmapData sheet;
+	std::vector<CHARSheetEntry> entries;
+	BitmapPalette palette;
+};
+
+class AWIZ16Case : public BenchCase
+{
+public:
+	AWIZ16Case(const std::string& n, int w, int h)
+		: casename(n)
+	{
+		awizc.width = w;
+		awizc.height = h;
+		std::vector<int> scene = make_scene(w, h, 65536, 4, 5);
+		awizc.wizd_chunk.resize(w * h * 2 + 8);
+		for (int i = 0; i < w * h; i++)
+		{
+			awizc.wizd_chunk.data[8 + i * 2] = static_cast<char>(scene[i] >> 8);
+			awizc.wizd_chunk.data[9 + i * 2] = static_cast<char>(scene[i] & 0xFF);
+		}
+		awizc.wizd_chunk.size = w * h * 2 + 8;
+	}
+	std::string name() const { return casename; }
+	int numpixels() const { return awizc.width * awizc.height; }
+	void run(BitmapData& bmap)
+	{
+		decode_awiz(awizc, bmap, palette, localtransind, transind);
+	}
+	void run_reference(RefImage& img)
+	{
+		img = RefImage(awizc.width, awizc.height, transind);
+		ref_decode_awiz_16bpp(awizc.wizd_chunk.data + 8, awizc.width * awizc.height, img);
+	}
+
+private:
+	std::string casename;
+	AWIZChunk awizc;
+	BitmapPalette palette;
+};
+
+// run every 16-bit value through the bulk 16bpp AWIZ converter and compare
+// with the single-pixel function
+bool check_awiz_16bpp_converter()
+{
+	std::vector<char> data(65536 * 2);
+	for (int i = 0; i < 65536; i++)
+	{
+		data[i * 2] = static_cast<char>(i >> 8);
+		data[i * 2 + 1] = static_cast<char>(i & 0xFF);
+	}
+	std::vector<int> out(65536);
+	decode_type2_awiz_pixels(&data[0], &out[0], 65536);
+
+	int mismatches = 0;
+	for (int i = 0; i < 65536; i++)
+	{
+		if (out[i] != decode_type2_awiz_pixel(i))
+			++mismatches;
+	}
+	std::cout << "16bpp AWIZ converter vs decode_type2_awiz_pixel, all 65536 values: "
+		<< (mismatches ? "MISMATCH" : "identical") << "\n\n";
+	return mismatches == 0;
+}
+
+bool outputs_match(BitmapData& bmap, const RefImage& img)
+{
+	if (bmap.get_width() != img.width || bmap.get_height() != img.height)
+		return false;
+	return std::memcmp(bmap.get_pixels(), &img.pixels[0],
+		img.pixels.size() * sizeof(int)) == 0;
+}
+
+// wall-clock seconds per iteration (so threaded decoding is credited),
+// running for at least mintime seconds
+template <class F>
+double time_per_iteration(F& f, double mintime)
+{
+	typedef std::chrono::steady_clock Clock;
+	int iterations = 0;
+	Clock::time_point start = Clock::now();
+	double elapsed = 0;
+	do
+	{
+		f();
+		++iterations;
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	} while (elapsed < mintime);
+	return elapsed / iterations;
+}
+
+struct RunCurrent
+{
+	RunCurrent(BenchCase& c) : bc(c) { };
+	void operator()() { bc.run(bmap); }
+	BenchCase& bc;
+	BitmapData bmap;
+};
+
+struct RunReference
+{
+	RunReference(BenchCase& c) : bc(c), img(0, 0, 0) { };
+	void operator()() { bc.run_reference(img); }
+	BenchCase& bc;
+	RefImage img;
+};
+
+};
+
+
+int main(int argc, char** argv)
+{
+	// usage: decode_bench [seconds per case] [case name filter]
+	double mintime = 0.3;
+	if (argc > 1)
+		mintime = std::atof(argv[1]);
+	std::string filter;
+	if (argc > 2)
+		filter = argv[2];
+
+	// make the decoding hacks deterministic: lined RLE for SMAP codes 8/9
+	// (as in everything after the 3DO games), bitstream 2-color AKOS
+	rle_encoding_method_hack_was_user_overriden = true;
+	rle_encoding_method_hack = rle_hack_always_use_lined;
+	akos_2color_decoding_hack_was_user_overriden = true;
+	akos_2color_decoding_hack = akos_2color_hack_always_use_bitmap;
+
+	std::vector<int> mixed;
+	mixed.push_back(0x1C);	// horizontal, 1-bit relative
+	mixed.push_back(0x12);	// vertical, 1-bit relative
+	mixed.push_back(0x44);	// horizontal, 3-bit relative
+	mixed.push_back(0x58);	// horizontal, 3-bit relative, transparent
+	mixed.push_back(0x8A);	// horizontal, 3-bit expanded range
+	mixed.push_back(0x26);	// vertical, 1-bit relative, transparent
+	mixed.push_back(9);		// lined RLE
+	mixed.push_back(1);		// uncompressed
+	std::vector<int> vertical;
+	vertical.push_back(0x12);
+	std::vector<int> horizontal;
+	horizontal.push_back(0x44);
+
+	std::vector<BenchCase*> cases;
+	cases.push_back(new SMAPCase("SMAP 640x480 mixed encodings", 640, 480, mixed));
+	cases.push_back(new SMAPCase("SMAP 640x480 horizontal 0x44", 640, 480, horizontal));
+	cases.push_back(new SMAPCase("SMAP 640x480 vertical 0x12", 640, 480, vertical));
+	cases.push_back(new SMAPCase("SMAP 1280x480 mixed, 4 threads", 1280, 480, mixed, 4));
+	cases.push_back(new AKOSCase("AKOS 2-color bitstream 96x240", 96, 240, 2, false, true));
+	cases.push_back(new AKOSCase("AKOS 16-color RLE 96x240", 96, 240, 16, true, false));
+	cases.push_back(new AKOSCase("AKOS 32-color RLE 96x240 remap", 96, 240, 32, true, true));
+	cases.push_back(new AKOSCase("AKOS 16-color RLE 320x960 tall", 320, 960, 16, true, false));
+	cases.push_back(new AWIZCase("AWIZ lined RLE 320x240", 320, 240, 8));
+	cases.push_back(new AWIZCase("AWIZ lined RLE 640x480 detailed", 640, 480, 1));
+	cases.push_back(new AWIZ16Case("AWIZ 16bpp 640x480", 640, 480));
+	cases.push_back(new CHARCase("CHAR sheet, 224 2bpp glyphs", 224, 16, 2));
+	cases.push_back(new BlitCase("sequence frame, 12 components", 640, 480, 12));
+
+	bool allmatch = check_awiz_16bpp_converter();
+
+	std::cout << std::left << std::setw(34) << "case"
+		<< std::right << std::setw(12) << "ref us/img"
+		<< std::setw(12) << "new us/img"
+		<< std::setw(10) << "speedup"
+		<< std::setw(12) << "new Mpix/s"
+		<< "  output" << '\n';
+
+	for (std::vector<BenchCase*>::size_type i = 0; i < cases.size(); i++)
+	{
+		BenchCase& bc = *cases[i];
+		if (bc.name().find(filter) == std::string::npos)
+		{
+			delete cases[i];
+			continue;
+		}
+
+		RunCurrent current(bc);
+		RunReference reference(bc);
+		current();
+		reference();
+		bool match = outputs_match(current.bmap, reference.img);
+		allmatch = allmatch && match;
+
+		double reftime = time_per_iteration(reference, mintime);
+		double newtime = time_per_iteration(current, mintime);
+
+		std::cout << std::left << std::setw(34) << bc.name()
+			<< std::right << std::fixed << std::setprecision(1)
+			<< std::setw(12) << reftime * 1e6
+			<< std::setw(12) << newtime * 1e6
+			<< std::setprecision(2)
+			<< std::setw(9) << reftime / newtime << "x"
+			<< std::setprecision(1)
+			<< std::setw(12) << bc.numpixels() / newtime / 1e6
+			<< "  " << (match ? "identical" : "MISMATCH") << '\n';
+
+		delete cases[i];
+	}
+
+	return allmatch ? 0 : 1;
+}
@@ -0,0 +1,486 @@
+#include "reference_decoders.h"
+
+#include <algorithm>
+
+namespace DecodeBench
+{
+
+
+namespace
+{
+
+struct DrawPos
+{
+	int x;
+	int y;
+};
+
+// one bit per call, least significant first, as RLBitStream did it
+struct RefBitStream
+{
+	RefBitStream(const char* d)
+		: data(d), datapos(0), bitpos(0) { };
+
+	int get_bit()
+	{
+		int bit = (data[datapos] >> bitpos) & 1;
+		if (++bitpos > 7)
+		{
+			++datapos;
+			bitpos = 0;
+		}
+		return bit;
+	}
+
+	const char* data;
+	int datapos;
+	int bitpos;
+};
+
+int byte_at(const char* data, int pos)
+{
+	return static_cast<unsigned char>(data[pos]);
+}
+
+int word_at(const char* data, int pos)
+{
+	return byte_at(data, pos) | (byte_at(data, pos + 1) << 8);
+}
+
+int draw_row(RefImage& img, int color, int count, int x, int y,
+	int boxx, int boxy, int boxw, int boxh)
+{
+	if (x < 0 || x >= boxw
+		|| y < 0 || y >= boxh
+		|| boxx < 0 || boxy < 0
+		|| count < 0)
+		return count;
+
+	int drawcount = count - std::max(0, x + count - (boxx + boxw));
+	int startpos = boxx + x + (y + boxy) * img.width;
+	for (int i = 0; i < drawcount; i++)
+		img.pixels[startpos + i] = color;
+
+	return count - drawcount;
+}
+
+int draw_col(RefImage& img, int color, int count, int x, int y,
+	int boxx, int boxy, int boxw, int boxh)
+{
+	if (x < 0 || x >= boxw
+		|| y < 0 || y >= boxh
+		|| boxx < 0 || boxy < 0
+		|| count < 0)
+		return count;
+
+	int drawcount = count - std::max(0, y + count - (boxy + boxh));
+	int startpos = boxx + x + (y + boxy) * img.width;
+	for (int i = 0; i < drawcount; i++)
+		img.pixels[startpos + img.width * i] = color;
+
+	return count - drawcount;
+}
+
+DrawPos draw_row_wrap(RefImage& img, int color, int count, int x, int y,
+	int boxx, int boxy, int boxw, int boxh)
+{
+	DrawPos d = { x, y };
+	if (x < 0 || x >= boxw
+		|| y < 0 || y >= boxh
+		|| boxx < 0 || boxy < 0
+		|| count < 0)
+		return d;
+
+	int totalpix = std::min(count, (boxw - x) + (boxw * (boxh - y)));
+	int currx = x;
+	int curry = y;
+	while (totalpix > 0)
+	{
+		int drawcount = std::min(totalpix, boxw - currx);
+		draw_row(img, color, drawcount, currx, curry, boxx, boxy, boxw, boxh);
+		currx += drawcount;
+		if (currx >= boxw)
+		{
+			curry += currx/boxw;
+			currx = currx % boxw;
+		}
+		totalpix -= drawcount;
+	}
+	d.x = currx;
+	d.y = curry;
+	return d;
+}
+
+DrawPos draw_col_wrap(RefImage& img, int color, int count, int x, int y,
+	int boxx, int boxy, int boxw, int boxh)
+{
+	DrawPos d = { x, y };
+	if (x < 0 || x >= boxw
+		|| y < 0 || y >= boxh
+		|| boxx < 0 || boxy < 0
+		|| count < 0)
+		return d;
+
+	int totalpix = std::min(count, (boxh - y) + (boxh * (boxw - x)));
+	int currx = x;
+	int curry = y;
+	while (totalpix > 0)
+	{
+		int drawcount = std::min(totalpix, boxh - curry);
+		draw_col(img, color, drawcount, currx, curry, boxx, boxy, boxw, boxh);
+		curry += drawcount;
+		if (curry >= img.height)
+		{
+			currx += curry/img.height;
+			curry = curry % img.height;
+		}
+		totalpix -= drawcount;
+	}
+	d.x = currx;
+	d.y = curry;
+	return d;
+}
+
+void draw_and_update_pos(RefImage& img, DrawPos& pos, int color, int count,
+	int xoff, int yoff, int width, int height, bool horiz)
+{
+	if (horiz)
+		pos = draw_row_wrap(img, color, count, pos.x, pos.y, xoff, yoff, width, height);
+	else
+		pos = draw_col_wrap(img, color, count, pos.x, pos.y, xoff, yoff, width, height);
+}
+
+int ref_drawcolor(int color, bool trans, int localtransind, int transind,
+	const std::vector<int>& colorremap, bool remap)
+{
+	int drawcolor = color;
+	if (remap)
+		drawcolor = colorremap[color];
+	if (trans && drawcolor == localtransind)
+		drawcolor = transind;
+	return drawcolor;
+}
+
+};
+
+
+void ref_decode_bitstream_img(const char* data, int datlen, RefImage& img,
+	int x, int y, int width, int height, int bpabsol, int bprel,
+	bool horiz, bool trans, bool exprange, int localtransind, int transind,
+	const std::vector<int>& colorremap, bool remap)
+{
+	int remaining = width * height;
+	DrawPos pos = { 0, 0 };
+
+	int color = byte_at(data, 0);
+	draw_and_update_pos(img, pos, ref_drawcolor(color, trans, localtransind, transind,
+		colorremap, remap), 1, x, y, width, height, horiz);
+	--remaining;
+	RefBitStream bstr(data + 1);
+	bool shiftisdown = true;
+	while (remaining > 0)
+	{
+		while (remaining > 0 && bstr.get_bit() == 0)
+		{
+			draw_and_update_pos(img, pos, ref_drawcolor(color, trans, localtransind,
+				transind, colorremap, remap), 1, x, y, width, height, horiz);
+			--remaining;
+		}
+		if (remaining > 0)
+		{
+			if (bstr.get_bit() == 0)
+			{
+				int newcol = 0;
+				for (int i = 0; i < bpabsol; i++)
+					newcol |= (bstr.get_bit() << i);
+				color = newcol;
+				draw_and_update_pos(img, pos, ref_drawcolor(color, trans, localtransind,
+					transind, colorremap, remap), 1, x, y, width, height, horiz);
+				--remaining;
+				if (bprel == 1)
+					shiftisdown = true;
+			}
+			else
+			{
+				int shift = 0;
+				int length = 1;
+				for (int i = 0; i < bprel; i++)
+					shift |= (bstr.get_bit() << i);
+
+				if (bprel != 1)
+				{
+					shift -= (1 << (bprel - 1));
+					if (exprange)
+					{
+						if (shift >= 0)
+							shift += 1;
+					}
+					else if (shift == 0)
+					{
+						int newlen = 0;
+						for (int i = 0; i < 8; i++)
+							newlen |= (bstr.get_bit() << i);
+						length = newlen;
+					}
+				}
+				else
+				{
+					if (shift == 1)
+						shiftisdown = !shiftisdown;
+					shift = shiftisdown ? -1 : 1;
+				}
+
+				color += shift;
+				draw_and_update_pos(img, pos, ref_drawcolor(color, trans, localtransind,
+					transind, colorremap, remap), length, x, y, width, height, horiz);
+				remaining -= length;
+			}
+		}
+	}
+}
+
+void ref_decode_lined_rle(const char* data, int datlen, RefImage& img,
+	int x, int y, int width, int height, int localtransind, int transind, bool trans,
+	const std::vector<int>& colormap, bool deindex)
+{
+	int currx = 0;
+	int curry = 0;
+
+	int pos = 0;
+	int next_pos = pos;
+	while (pos < datlen && curry < height)
+	{
+		int bytecount = word_at(data, next_pos);
+		pos = next_pos + 2;
+		next_pos += bytecount + 2;
+		while (pos < datlen && pos < next_pos)
+		{
+			int code = byte_at(data, pos);
+			++pos;
+
+			if (code & 1)
+			{
+				currx += (code >> 1);
+			}
+			else if (code & 2)
+			{
+				int count = (code >> 2) + 1;
+				int color = byte_at(data, pos);
+				++pos;
+				if (deindex)
+					color = colormap[color];
+				if (trans && color == localtransind)
+					color = transind;
+				draw_row(img, color, count, currx, curry, x, y, width, height);
+				currx += count;
+			}
+			else
+			{
+				int count = (code >> 2) + 1;
+				for (int i = 0; i < count; i++)
+				{
+					int color = byte_at(data, pos);
+					if (deindex)
+						color = colormap[color];
+					if (trans && color == localtransind)
+						color = transind;
+					draw_row(img, color, 1, currx, curry, x, y, width, height);
+					++pos;
+					++currx;
+				}
+			}
+		}
+		currx = 0;
+		++curry;
+	}
+}
+
+void ref_decode_multicomp_rle(const char* data, int width, int height, RefImage& img,
+	int clrcmp, const std::vector<int>& colormap, bool deindex,
+	const std::vector<int>& colorremap, bool remap)
+{
+	if (clrcmp == 16 || clrcmp == 32 || clrcmp == 64)
+	{
+		int clrshift = (clrcmp == 16) ? 4 : (clrcmp == 32) ? 3 : 2;
+		int runmask = (1 << clrshift) - 1;
+
+		int totalpix = width * height;
+		int drawn = 0;
+		int x = 0;
+		int y = 0;
+		while (drawn < totalpix)
+		{
+			int code = byte_at(data++, 0);
+			int color = code >> clrshift;
+			int runlen = code & runmask;
+			if (runlen == 0)
+				runlen = byte_at(data++, 0);
+			if (color != 0)
+			{
+				if (deindex)
+					color = colormap[color];
+				if (remap)
+					color = colorremap[color];
+				DrawPos result = draw_col_wrap(img, color, runlen, x, y,
+					0, 0, img.width, img.height);
+				x = result.x;
+				y = result.y;
+			}
+			else
+			{
+				y += runlen;
+				if (y >= height)
+				{
+					x += y/height;
+					y = y % height;
+				}
+			}
+			drawn += runlen;
+		}
+	}
+	else if (clrcmp == 256)
+	{
+		int x = 0;
+		int y = 0;
+
+		const char* nextstart = data;
+		while (y < height)
+		{
+			int bytecount = word_at(nextstart, 0);
+			data = nextstart + 2;
+			nextstart += bytecount + 2;
+			while (data < nextstart)
+			{
+				int code = byte_at(data++, 0);
+				if (code & 1)
+				{
+					x += (code >> 1);
+				}
+				else if (code & 2)
+				{
+					int count = (code >> 2) + 1;
+					int color = byte_at(data++, 0);
+					draw_row(img, color, count, x, y, 0, 0, img.width, img.height);
+					x += count;
+				}
+				else
+				{
+					int count = (code >> 2) + 1;
+					for (int i = 0; i < count; i++)
+					{
+						draw_row(img, byte_at(data++, 0), 1, x, y,
+							0, 0, img.width, img.height);
+						++x;
+					}
+				}
+			}
+			x = 0;
+			++y;
+		}
+	}
+}
+
+void ref_decode_awiz_16bpp(const char* data, int count, RefImage& img)
+{
+	for (int i = 0; i < count; i++)
+	{
+		int full = (byte_at(data, i * 2) << 8) | byte_at(data, i * 2 + 1);
+		int r = (full & 0x7C00) >> 7;
+		int g = (full & 0x03E0) >> 2;
+		int b = (full & 0x001F) << 3;
+		img.pixels[i] = (b << 16) | (g << 8) | r;
+	}
+}
+
+void ref_decode_char_bits(const char* data, int datlen, RefImage& img,
+	int x, int y, int width, int height, int bpp)
+{
+	int bitpos = 0;
+	for (int i = 0; i < height; i++)
+	{
+		for (int j = 0; j < width; j++)
+		{
+			int color = 0;
+			for (int k = 0; k < bpp; k++, bitpos++)
+			{
+				int bit = 0;
+				if (bitpos / 8 < datlen)
+					bit = (byte_at(data, bitpos / 8) >> (7 - bitpos % 8)) & 1;
+				color = (color << 1) | bit;
+			}
+			if (color != 0)
+				img.pixels[(y + i) * img.width + x + j] = color;
+		}
+	}
+}
+
+void ref_blit_masked(RefImage& dest, const RefImage& src, int xpos, int ypos,
+	int transcolor)
+{
+	if (xpos >= dest.width
+		|| ypos >= dest.height
+		|| xpos + src.width < 0
+		|| ypos + src.height < 0)
+		return;
+
+	int xdiff = std::max(0, -xpos);
+	int ydiff = std::max(0, -ypos);
+	int thisx = std::max(0, xpos);
+	int thisy = std::max(0, ypos);
+	int bwidth = src.width - xdiff - std::max(0, xpos + src.width - dest.width);
+	int bheight = src.height - ydiff - std::max(0, ypos + src.height - dest.height);
+
+	for (int i = 0; i < bheight; i++)
+	{
+		const int* source = &src.pixels[xdiff + (ydiff + i) * src.width];
+		int* putpos = &dest.pixels[thisx + (thisy + i) * dest.width];
+		for (int j = 0; j < bwidth; j++)
+		{
+			if (source[j] != transcolor)
+				putpos[j] = source[j];
+		}
+	}
+}
+
+void ref_decode_smap(const char* data, int datasize, RefImage& img,
+	int localtransind, int transind)
+{
+	int strips = img.width/8;
+	for (int i = 0; i < strips; i++)
+	{
+		int offset = word_at(data, 8 + i * 4) | (word_at(data, 10 + i * 4) << 16);
+		int encoding = byte_at(data, offset);
+		const char* strip = data + offset + 1;
+		int datlen = datasize - offset;
+
+		if (encoding == 1 || encoding == 149)
+		{
+			for (int y = 0; y < img.height; y++)
+				for (int x = 0; x < 8; x++)
+					img.pixels[i * 8 + x + y * img.width] = byte_at(strip, x + y * 8);
+		}
+		else if (encoding == 8 || encoding == 9)
+		{
+			ref_decode_lined_rle(strip, datlen, img, i * 8, 0, 8, img.height,
+				localtransind, transind, encoding == 8, std::vector<int>(), false);
+		}
+		else
+		{
+			bool horiz = !((encoding >= 0xE && encoding <= 0x12)
+				|| (encoding >= 0x22 && encoding <= 0x26));
+			bool trans = (encoding >= 0x22 && encoding <= 0x26)
+				|| (encoding >= 0x2C && encoding <= 0x30)
+				|| (encoding >= 0x54 && encoding <= 0x58)
+				|| (encoding >= 0x7C && encoding <= 0x80)
+				|| (encoding >= 0x90 && encoding <= 0x94);
+			bool exprange = encoding >= 0x86;
+			int bprel = (encoding <= 0x30) ? 1 : 3;
+			ref_decode_bitstream_img(strip, datlen, img, i * 8, 0, 8, img.height,
+				encoding % 10, bprel, horiz, trans, exprange, localtransind, transind,
+				std::vector<int>(), false);
+		}
+	}
+}
+
+
+};	// end namespace DecodeBench
@@ -0,0 +1,54 @@
+/* Copies of the image decoders as they stood before the specialized
+   kernels went in, working on a plain pixel buffer. decode_bench uses
+   them as the timing baseline and to check the current decoders for
+   bit-exact output */
+
+#include <vector>
+
+namespace DecodeBench
+{
+
+
+struct RefImage
+{
+	RefImage(int w, int h, int fill)
+		: width(w), height(h), pixels(w * h, fill) { };
+
+	int width;
+	int height;
+	std::vector<int> pixels;
+};
+
+void ref_decode_bitstream_img(const char* data, int datlen, RefImage& img,
+	int x, int y, int width, int height, int bpabsol, int bprel,
+	bool horiz, bool trans, bool exprange, int localtransind, int transind,
+	const std::vector<int>& colorremap, bool remap);
+
+void ref_decode_lined_rle(const char* data, int datlen, RefImage& img,
+	int x, int y, int width, int height, int localtransind, int transind, bool trans,
+	const std::vector<int>& colormap, bool deindex);
+
+void ref_decode_multicomp_rle(const char* data, int width, int height, RefImage& img,
+	int clrcmp, const std::vector<int>& colormap, bool deindex,
+	const std::vector<int>& colorremap, bool remap);
+
+// 16bpp AWIZ: count big-endian 5-5-5 pixels
+void ref_decode_awiz_16bpp(const char* data, int count, RefImage& img);
+
+// uncompressed 1/2/4 bpp CHAR glyph, a bit at a time, drawn at x, y;
+// color 0 is left as is
+void ref_decode_char_bits(const char* data, int datlen, RefImage& img,
+	int x, int y, int width, int height, int bpp);
+
+// BitmapData::blit_bitmapdata with a transparent color, pixel by pixel
+void ref_blit_masked(RefImage& dest, const RefImage& src, int xpos, int ypos,
+	int transcolor);
+
+// SMAP with RLE strips always treated as lined
+void ref_decode_smap(const char* data, int datasize, RefImage& img,
+	int localtransind, int transind);
+
+
+};	// end namespace DecodeBench
+
+#pragma once
\ No newline at end of file
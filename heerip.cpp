@@ -0,0 +1,116 @@
+#include "heerip.h"
+#include "launch.h"
+#include "RipModules.h"
+#include "utils/MembufStream.h"
+#include "utils/datmanip.h"
+
+namespace Ripper
+{
+
+
+namespace
+{
+
+// the parameters as a command line for the settings to be read from,
+// with name in place of the input file
+class CommandLine
+{
+public:
+	CommandLine(const std::string& name, const std::vector<std::string>& params)
+		: args(1, "heerip")
+	{
+		args.push_back(name);
+		args.insert(args.end(), params.begin(), params.end());
+		for (std::vector<std::string>::size_type i = 0; i < args.size(); i++)
+			argv.push_back(&args[i][0]);
+		argv.push_back(0);
+	}
+
+	void configure(RipperFormats::RipperSettings& ripset)
+	{
+		configure_parameters(args.size(), &argv[0], ripset);
+		ripset.argc = args.size();
+		ripset.argv = &argv[0];
+	}
+
+private:
+	CommandLine(const CommandLine&);
+	CommandLine& operator=(const CommandLine&);
+
+	std::vector<std::string> args;
+	std::vector<char*> argv;
+};
+
+std::string output_prefix(const std::string& filename,
+	const RipperFormats::RipperSettings& ripset)
+{
+	if (ripset.outpath != "")
+		return ripset.outpath;
+	return RipUtil::strip_extension(filename);
+}
+
+bool rip_stream(RipUtil::MembufStream& stream, const std::string& filename,
+	const RipperFormats::RipperSettings& ripset, RipperFormats::RipResults& results,
+	RipUtil::AssetVisitor* visitor)
+{
+	// despite how this code is written, there is only one "mod,"
+	// which handles all recognized Humongous files
+	RipModules mods;
+	std::string fprefix = output_prefix(filename, ripset);
+	RipperFormats::FileFormatData fmtdat;
+	bool ripped = false;
+	for (int i = 0; i < mods.num_mods(); i++)
+	{
+		mods[i]->set_visitor(visitor);
+		if (mods[i]->can_rip(stream, ripset, fmtdat))
+		{
+			results = mods[i]->rip(stream, fprefix, ripset, fmtdat);
+			ripped = true;
+		}
+
+		stream.reset();
+	}
+	return ripped;
+}
+
+};
+
+std::string get_output_prefix(const std::string& filename,
+	const std::vector<std::string>& params)
+{
+	CommandLine cmd(filename, params);
+	RipperFormats::RipperSettings ripset;
+	cmd.configure(ripset);
+	return output_prefix(filename, ripset);
+}
+
+bool rip_file(const std::string& filename, const std::vector<std::string>& params,
+	RipperFormats::RipResults& results, RipUtil::AssetVisitor* visitor)
+{
+	CommandLine cmd(filename, params);
+	RipperFormats::RipperSettings ripset;
+	cmd.configure(ripset);
+
+	RipUtil::MembufStream stream(filename, RipUtil::MembufStream::rb,
+		ripset.encoding, ripset.bufsize);
+	return rip_stream(stream, filename, ripset, results, visitor);
+}
+
+bool rip_memory(const char* data, int size, const std::string& name,
+	const std::vector<std::string>& params, RipperFormats::RipResults& results,
+	RipUtil::AssetVisitor* visitor)
+{
+	// there's no directory to look for external files in
+	std::vector<std::string> memparams(params);
+	memparams.push_back("--noextdmu");
+
+	CommandLine cmd(name, memparams);
+	RipperFormats::RipperSettings ripset;
+	cmd.configure(ripset);
+
+	RipUtil::MembufStream stream(data, size, name, ripset.encoding, ripset.bufsize);
+	return rip_stream(stream, name, ripset, results, visitor);
+}
+
+
+};	// end namespace Ripper
@@ -0,0 +1,38 @@
+/* HEErip as a library: rips a datafile from disk or from memory, either
+   writing files exactly as the program does or handing the decoded assets
+   to an AssetVisitor */
+
+#include "RipperFormats.h"
+#include "utils/AssetVisitor.h"
+#include <string>
+#include <vector>
+
+namespace Ripper
+{
+
+
+// params are the parameters as they'd be given to the program after the
+// input file, e.g. { "--nosound", "-format", "png" }
+
+// the output prefix a rip of filename with params would use
+std::string get_output_prefix(const std::string& filename,
+	const std::vector<std::string>& params);
+
+// rip the file at filename. With a visitor, every asset goes to it and
+// nothing is written, not even the log file; otherwise files are written
+// to the output prefix
+// returns false if the file isn't a recognized Humongous datafile
+// throws RipUtil::FileOpenException if the file can't be opened
+bool rip_file(const std::string& filename, const std::vector<std::string>& params,
+	RipperFormats::RipResults& results, RipUtil::AssetVisitor* visitor = 0);
+
+// as rip_file, but reading size bytes of a datafile from memory. name stands
+// in for the filename; external DMU files aren't looked for
+bool rip_memory(const char* data, int size, const std::string& name,
+	const std::vector<std::string>& params, RipperFormats::RipResults& results,
+	RipUtil::AssetVisitor* visitor = 0);
+
+
+};	// end namespace Ripper
+
+#pragma once
\ No newline at end of file
@@ -15,16 +15,25 @@ void print_base_usage_text()
 	cout << "Usage: heerip <infile> [options]" << '\n';
 	cout << "Parameters: " << '\n';
 	cout << '\t' << "-alttrans <val>" << '\t' << '\t' << "Force transparency color index (0-255)" << '\n'
+		<< '\t' << "-archive <val>" << '\t' << '\t' << "Write all output into one archive: tar or zip" << '\n'
 		<< '\t' << "-bufsize <val>"<< '\t' << '\t'
 		<< "Max read buffer size in bytes (def: " 
 			<< (double)RipperFormats::RipConsts::default_bufsize/1000000 << " mb)" << '\n'
 		<< '\t' << "-decode <val>" << '\t' << '\t' << "Force decoding byte (def: 0)" << '\n'
+		<< '\t' << "-dedup <val>" << '\t' << '\t' << "Write repeated files once: link or ref" << '\n'
 		<< '\t' << "-end <val>" << '\t' << '\t' << "Set ending room (def: read to end)" << '\n'
+		<< '\t' << "-format <val>" << '\t' << '\t' << "Image output format: bmp or png (def: bmp)" << '\n'
+		<< '\t' << "-hashstore <val>" << '\t' << "Remember output in this file for dedup across runs" << '\n'
 		<< '\t' << "-ignoreend <val>" << '\t' << "Audio: # of trailing sample bytes to ignore" << '\n'
 		<< '\t' << "-ignorestart <val>" << '\t' << "Audio: # of initial sample bytes to ignore" << '\n'
+		<< '\t' << "-layout <val>" << '\t' << '\t' << "Output layout: flat or tree (def: flat)" << '\n'
+		<< '\t' << "-nowrite <val>" << '\t' << '\t' << "Decode but discard output: count or hash it" << '\n'
 		<< '\t' << "-output <val>" << '\t' << '\t' << "Set output prefix (def: filename w/o extension)" << '\n'
 		<< '\t' << "-palettenum" << '\t' << '\t' << "Force use of this room number's palette" << '\n'
-		<< '\t' << "-start <val>" << '\t' << '\t' << "Set starting room (def: 0)" << '\n';
+		<< '\t' << "-smapthreads <val>" << '\t' << "Threads for decoding room backgrounds (0 = all cores; def: 1)" << '\n'
+		<< '\t' << "-start <val>" << '\t' << '\t' << "Set starting room (def: 0)" << '\n'
+		<< '\t' << "-threads <val>" << '\t' << "Rooms to rip at once (0 = all cores; def: 1)" << '\n'
+		<< '\t' << "-writequeue <val>" << '\t' << "MB of output waiting to be written (def: 64)" << '\n';
 	cout << '\n';
 	cout << '\t' << "--noakos" << '\t' << '\t' << "Disable AKOS ripping" << '\n'
 		<< '\t' << "--noawiz" << '\t' << '\t' << "Disable AWIZ ripping" << '\n'
@@ -48,15 +57,27 @@ void print_base_usage_text()
 		<< '\t' << "--sequenceonly" << '\t' << '\t' << "Enable only animation sequence ripping" << '\n'
 		<< '\t' << "--tlkeonly" << '\t' << '\t' << "Enable only TLKE ripping" << '\n'
 		<< '\n';
-	cout << '\t' << "--decodeaudio" << '\t' << '\t' << "Decode audio instead of copying" << '\n'
+	cout << '\t' << "--atlas" << '\t' << '\t' << '\t' << "Pack AKOS and AWIZ images onto sheets" << '\n'
+		<< '\t' << "--catalog" << '\t' << '\t' << "Write a JSON Lines record of every asset" << '\n'
+		<< '\t' << "--charsheet" << '\t' << '\t' << "Rip each font as one sheet plus metrics" << '\n'
+		<< '\t' << "--dedup" << '\t' << '\t' << '\t' << "Same as -dedup link" << '\n'
+		<< '\t' << "--decodeaudio" << '\t' << '\t' << "Decode audio instead of copying" << '\n'
 		<< '\t' << "--decodeonly" << '\t' << '\t' << "Decode XOR encoded file: no other output" << '\n'
 		<< '\t' << "--disablelog" << '\t' << '\t' << "Disable log file writing" << '\n'
 		<< '\t' << "--force_lined_rle" << '\t' << "Force lined RLE hack" << '\n'
 		<< '\t' << "--force_unlined_rle" << '\t' << "Force unlined RLE hack" << '\n'
 		<< '\t' << "--force_akos2c_rle" << '\t' << "Force AKOS RLE hack" << '\n'
 		<< '\t' << "--force_akos2c_bitmap" << '\t' << "Force AKOS bitmap hack" << '\n'
+		<< '\t' << "--incremental" << '\t' << '\t' << "Skip rooms unchanged since the last rip" << '\n'
 		<< '\t' << "--localpalettes" << '\t' << '\t' << "Use local instead of global palettes" << '\n'
 		<< '\t' << "--norip" << '\t' << '\t' << '\t' << "Read-only mode: no output" << '\n'
+		<< '\t' << "--nowrite" << '\t' << '\t' << "Same as -nowrite count" << '\n'
+		<< '\t' << "--packscripts" << '\t' << '\t' << "Dump scripts into one indexed container" << '\n'
+		<< '\t' << "--pngfast" << '\t' << '\t' << "Faster, less thorough PNG compression" << '\n'
+		<< '\t' << "--pngtrans" << '\t' << '\t' << "Make the background transparent in PNGs" << '\n'
+		<< '\t' << "--separatepalettes" << '\t' << "Write room palettes once, not per image" << '\n'
+		<< '\t' << "--syncwrite" << '\t' << '\t' << "Write files on the ripping thread" << '\n'
+		<< '\t' << "--trim" << '\t' << '\t' << '\t' << "Cut sprites down to their visible pixels" << '\n'
 		<< '\t' << "--normalize" << '\t' << '\t' << "Normalize audio (auto-decodeaudio)" << '\n';
 }
 
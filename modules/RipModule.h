@@ -3,12 +3,15 @@
 	extracting data from a file */
 
 #include "../utils/MembufStream.h"
+#include "../utils/AssetVisitor.h"
 #include "../RipperFormats.h"
 
 class RipModule
 {
 public:
 
+	virtual ~RipModule() { };
+
 	// levels of support for ripping types
 	enum SupportLevel
 	{
@@ -44,6 +47,10 @@ public:
 	virtual RipperFormats::RipResults rip(RipUtil::MembufStream& stream, const std::string& fprefix,
 		const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat) =0;
 
+	// hand assets to v instead of writing files (0 = write files);
+	// must be set before can_rip()
+	void set_visitor(RipUtil::AssetVisitor* v) { visitor = v; }
+
 protected:
 	RipModule(const std::string& name, const std::string& desc,
 		bool hasext, const std::string& ext,
@@ -57,7 +64,10 @@ protected:
 		supports_graphics(grp),
 		supports_animations(ani),
 		supports_audio(aud),
-		supports_strings(str) { };
+		supports_strings(str),
+		visitor(0) { };
+
+	RipUtil::AssetVisitor* visitor;
 private:
 };
 
@@ -3,7 +3,6 @@
 #include "../utils/BitmapData.h"
 #include "../utils/PCMData.h"
 #include "../utils/IMAADPCMDecoder.h"
-#include "../utils/BitStream.h"
 #include "../utils/datmanip.h"
 
 #include <iostream>
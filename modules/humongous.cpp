@@ -2,20 +2,31 @@
 #include "humongous_read.h"
 #include "humongous_rip.h"
 #include "humongous_structs.h"
+#include "humongous_manifest.h"
 
 #include "../utils/MembufStream.h"
 #include "../utils/BitmapData.h"
 #include "../utils/PCMData.h"
+#include "../utils/RectPacker.h"
+#include "../utils/XXHash.h"
+#include "../utils/ThreadPool.h"
 #include "../utils/datmanip.h"
 #include "../utils/ErrorLog.h"
 #include "../utils/logger.h"
 #include "../RipperFormats.h"
 #include "common.h"
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <cstring>
 #include <iostream>
 #include <ctime>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
 
 using namespace RipUtil;
 using namespace RipperFormats;
@@ -181,14 +192,72 @@ RipperFormats::RipResults HERip::rip(RipUtil::MembufStream& stream, const std::s
 	{
 		logger.qprint("decoding only");
 
-		std::ofstream ofs((fprefix + "-decoded").c_str(), std::ios_base::binary);
 		char* outbytes = new char[stream.get_fsize()];
 		stream.read(outbytes, stream.get_fsize());
-		ofs.write(outbytes, stream.get_fsize());
+		if (visitor)
+			write_file(fprefix + "-decoded", outbytes, stream.get_fsize());
+		else
+		{
+			std::ofstream ofs((fprefix + "-decoded").c_str(), std::ios_base::binary);
+			ofs.write(outbytes, stream.get_fsize());
+		}
 		delete[] outbytes;
 		return results;
 	}
 
+	std::chrono::steady_clock::time_point riptime = std::chrono::steady_clock::now();
+
+	// all output files go through the output sink: to disk, or into an
+	// archive, optionally deduplicated on the way; or nowhere, to time
+	// the decoders alone
+	FileSink filesink;
+	NullSink nullsink(nowrite_hash);
+	ArchiveSink* archivesink = 0;
+	if (archive == archive_tar)
+		archivesink = new TarSink(fprefix + ".tar", get_lowest_directory(fprefix));
+	else if (archive == archive_zip)
+		archivesink = new ZipSink(fprefix + ".zip", get_lowest_directory(fprefix));
+	if (archivesink && !archivesink->is_open())
+	{
+		logger.error("couldn't create archive, writing files instead");
+		delete archivesink;
+		archivesink = 0;
+	}
+	OutputSink& filesout = nowrite ? static_cast<OutputSink&>(nullsink)
+		: archivesink ? static_cast<OutputSink&>(*archivesink) : filesink;
+
+	// directories only need making for files on disk
+	make_output_dirs = (&filesout == &filesink) && !visitor;
+	output_dirs.clear();
+
+	// files in an archive can't be linked
+	DedupSink dedupsink(filesout, archivesink ? DedupSink::dedup_reference : dedupmode,
+		fprefix + "-duplicates.txt", hashstore);
+	OutputSink& dedupout = dedup ? static_cast<OutputSink&>(dedupsink) : filesout;
+
+	// write on another thread so decoding doesn't wait on the file system
+	AsyncSink* asyncsink = 0;
+	if (asyncwrite)
+	{
+		asyncsink = new AsyncSink(dedupout, (long long)std::max(1, writequeue_mb) << 20);
+		output = asyncsink;
+	}
+	else
+		output = &dedupout;
+
+	catalog_file = fprefix + "-catalog.jsonl";
+	catalog_asset = CatalogAsset();
+	catalog_records.clear();
+	scriptpack.clear();
+
+	// note what each room writes for the manifest
+	RecordingSink recordingsink(*output);
+	if (incremental)
+	{
+		recorder = &recordingsink;
+		output = recorder;
+	}
+
 	// HE1/(A)/(B) data file
 	if (formatsubtype == lecf_type1 || formatsubtype == lecf_type2)
 	{
@@ -215,6 +284,43 @@ RipperFormats::RipResults HERip::rip(RipUtil::MembufStream& stream, const std::s
 		rip_song_dmu(stream, fprefix, ripset, fmtdat, results);
 	}
 
+	if (!scriptpack.empty())
+	{
+		std::vector<char> pack;
+		scriptpack.build(pack);
+		write_file(fprefix + "-scripts.pak", &pack[0], pack.size());
+		scriptpack.clear();
+	}
+
+	flush_catalog();
+	output->finish();
+	if (dedup)
+	{
+		logger.print(to_string(dedupsink.get_duplicates()) + " duplicate files, "
+			+ to_string(dedupsink.get_bytes_saved()) + " bytes saved");
+	}
+	if (nowrite)
+	{
+		double seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - riptime).count();
+		std::ostringstream summary;
+		summary << nullsink.get_files() << " files, " << nullsink.get_bytes()
+			<< " bytes decoded in " << seconds << " s";
+		if (seconds > 0)
+			summary << " (" << nullsink.get_bytes() / seconds / 1000000 << " MB/s)";
+		if (nowrite_hash)
+		{
+			char digest[17];
+			std::sprintf(digest, "%016llx", nullsink.get_digest());
+			summary << ", digest " << digest;
+		}
+		logger.print(summary.str());
+	}
+	output = 0;
+	recorder = 0;
+	delete asyncsink;
+	delete archivesink;
+
 	if (logger.get_errflag())
 	{
 		std::cout << "One or more errors occured; please check the log file" << '\n';
@@ -233,6 +339,9 @@ RipperFormats::RipResults HERip::rip(RipUtil::MembufStream& stream, const std::s
 
 void HERip::check_params(const RipperFormats::RipperSettings& ripset)
 {
+	// an earlier rip in the same program may have changed these
+	reset_decoding_settings();
+
 	if (!ripset.ripgraphics)
 	{
 		rmimrip = false;
@@ -363,6 +472,57 @@ void HERip::check_params(const RipperFormats::RipperSettings& ripset)
 			catscripts = true;
 			scriptrip = true;
 		}
+		else if (quickstrcmp(ripset.argv[i], "--packscripts"))
+		{
+			packscripts = true;
+			scriptrip = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--charsheet"))
+		{
+			charsheet = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--separatepalettes"))
+		{
+			separatepalettes = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--atlas"))
+		{
+			atlas = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--dedup"))
+		{
+			dedup = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--syncwrite"))
+		{
+			asyncwrite = false;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--incremental"))
+		{
+			incremental = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--nowrite"))
+		{
+			nowrite = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--catalog"))
+		{
+			catalog = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--trim"))
+		{
+			// the catalog is where the trimmed offsets go
+			trim = true;
+			catalog = true;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--pngfast"))
+		{
+			pngsettings.level = deflate_fast;
+		}
+		else if (quickstrcmp(ripset.argv[i], "--pngtrans"))
+		{
+			pngsettings.transparent = true;
+		}
 		else if (quickstrcmp(ripset.argv[i], "--disablelog"))
 		{
 			disablelog = true;
@@ -394,8 +554,502 @@ void HERip::check_params(const RipperFormats::RipperSettings& ripset)
 				alttrans = true;
 				transcol = from_string<int>(std::string(ripset.argv[i + 1]));
 			}
+			else if (quickstrcmp(ripset.argv[i], "-smapthreads"))
+			{
+				// 0 = one thread per core
+				smap_decoding_threads = from_string<int>(std::string(ripset.argv[i + 1]));
+				if (smap_decoding_threads <= 0)
+					smap_decoding_threads = std::max(1u, std::thread::hardware_concurrency());
+			}
+			else if (quickstrcmp(ripset.argv[i], "-threads"))
+			{
+				// 0 = one thread per core
+				room_threads = from_string<int>(std::string(ripset.argv[i + 1]));
+				if (room_threads <= 0)
+					room_threads = std::max(1u, std::thread::hardware_concurrency());
+			}
+			else if (quickstrcmp(ripset.argv[i], "-dedup"))
+			{
+				dedup = true;
+				if (quickstrcmp(ripset.argv[i + 1], "ref"))
+					dedupmode = DedupSink::dedup_reference;
+				else if (quickstrcmp(ripset.argv[i + 1], "link"))
+					dedupmode = DedupSink::dedup_link;
+				else
+					std::cout << "Unknown dedup mode " << ripset.argv[i + 1]
+						<< "; using hard links" << '\n';
+			}
+			else if (quickstrcmp(ripset.argv[i], "-nowrite"))
+			{
+				nowrite = true;
+				if (quickstrcmp(ripset.argv[i + 1], "hash"))
+					nowrite_hash = true;
+				else if (!quickstrcmp(ripset.argv[i + 1], "count"))
+					std::cout << "Unknown nowrite mode " << ripset.argv[i + 1]
+						<< "; counting only" << '\n';
+			}
+			else if (quickstrcmp(ripset.argv[i], "-archive"))
+			{
+				if (quickstrcmp(ripset.argv[i + 1], "tar"))
+					archive = archive_tar;
+				else if (quickstrcmp(ripset.argv[i + 1], "zip"))
+					archive = archive_zip;
+				else
+					std::cout << "Unknown archive format " << ripset.argv[i + 1]
+						<< "; writing files instead" << '\n';
+			}
+			else if (quickstrcmp(ripset.argv[i], "-layout"))
+			{
+				if (quickstrcmp(ripset.argv[i + 1], "flat"))
+					layout = layout_flat;
+				else if (quickstrcmp(ripset.argv[i + 1], "tree"))
+					layout = layout_tree;
+				else
+					std::cout << "Unknown output layout " << ripset.argv[i + 1]
+						<< "; writing files flat instead" << '\n';
+			}
+			else if (quickstrcmp(ripset.argv[i], "-hashstore"))
+			{
+				dedup = true;
+				hashstore = ripset.argv[i + 1];
+			}
+			else if (quickstrcmp(ripset.argv[i], "-writequeue"))
+			{
+				writequeue_mb = from_string<int>(std::string(ripset.argv[i + 1]));
+			}
+			else if (quickstrcmp(ripset.argv[i], "-format"))
+			{
+				if (quickstrcmp(ripset.argv[i + 1], "png"))
+					imageformat = image_png;
+				else if (quickstrcmp(ripset.argv[i + 1], "bmp"))
+					imageformat = image_bmp;
+				else
+					std::cout << "Unknown image format " << ripset.argv[i + 1]
+						<< "; using BMP" << '\n';
+			}
+		}
+	}
+
+	// a visitor gets the assets before they would reach a sink, and nothing
+	// should touch the disk
+	if (visitor)
+	{
+		nowrite = false;
+		disablelog = true;
+	}
+
+	// for -nowrite, nothing but the decoders should run on the ripping
+	// thread, so that's all that's timed
+	if (nowrite || visitor)
+	{
+		archive = archive_none;
+		dedup = false;
+		asyncwrite = false;
+		incremental = false;
+	}
+
+	// unchanged rooms are recognized by their files still being on disk
+	if (incremental && (archive != archive_none
+		|| (dedup && dedupmode == DedupSink::dedup_reference)))
+	{
+		std::cout << "--incremental can't be used with -archive or -dedup ref; "
+			<< "ripping everything" << '\n';
+		incremental = false;
+	}
+}
+
+std::string HERip::get_output_settings(const RipperFormats::RipperSettings& ripset)
+{
+	// everything but the room range and options that only affect how the
+	// rip runs
+	const char* ignored_flags[] = { "--syncwrite", "--disablelog", "--incremental" };
+	const char* ignored_params[] = { "-start", "-st", "-end", "-en", "-bufsize", "-b",
+		"-smapthreads", "-threads", "-writequeue", "-hashstore" };
+
+	std::string settings;
+	for (int i = 2; i < ripset.argc; i++)
+	{
+		bool ignored = false;
+		for (int j = 0; j < (int)(sizeof(ignored_flags) / sizeof(char*)); j++)
+		{
+			if (quickstrcmp(ripset.argv[i], ignored_flags[j]))
+				ignored = true;
+		}
+		for (int j = 0; j < (int)(sizeof(ignored_params) / sizeof(char*)); j++)
+		{
+			if (quickstrcmp(ripset.argv[i], ignored_params[j]))
+			{
+				ignored = true;
+				++i;
+			}
+		}
+
+		if (!ignored)
+			settings += std::string(settings.size() ? " " : "") + ripset.argv[i];
+	}
+	return settings;
+}
+
+std::string HERip::write_image(RipUtil::BitmapData& bmp, const std::string& outfile_base,
+	int transind)
+{
+	std::string filename;
+	if (visitor)
+	{
+		filename = outfile_base;
+		visitor->visit_image(filename, bmp, transind);
+	}
+	else
+	{
+		std::vector<char> file;
+		if (imageformat == image_png)
+		{
+			PNGSettings settings = pngsettings;
+			settings.transind = transind;
+			encode_bitmapdata_png(bmp, file, settings);
+			filename = outfile_base + ".png";
+		}
+		else
+		{
+			bmp.encode(file);
+			filename = outfile_base + ".bmp";
+		}
+
+		output->put(filename, file);
+	}
+
+	if (catalog)
+	{
+		std::ostringstream details;
+		details << ",\"width\":" << bmp.get_width() << ",\"height\":" << bmp.get_height()
+			<< ",\"bpp\":" << bmp.get_bpp() << catalog_trim;
+
+		// which of the room's palettes the image goes with (with separate
+		// palettes, all of them); none if it has its own
+		if (bmp.get_palettized())
+		{
+			details << ",\"palettes\":[";
+			bool first = true;
+			for (std::vector<BitmapPalette>::size_type j = 0;
+				catalog_lflf && j < catalog_lflf->apals.size(); j++)
+			{
+				if (catalog_lflf->apals[separatepalettes ? 0 : j] == bmp.get_palette())
+				{
+					details << (first ? "" : ",") << j;
+					first = false;
+				}
+			}
+			details << "]";
 		}
+		add_catalog_record(filename, details.str());
+	}
+	return filename;
+}
+
+void HERip::write_wave(RipUtil::PCMData& wave, const std::string& filename,
+	const RipperFormats::RipperSettings& ripset)
+{
+	if (catalog)
+	{
+		std::ostringstream details;
+		details << ",\"samplerate\":" << wave.get_samprate()
+			<< ",\"channels\":" << wave.get_channels()
+			<< ",\"bits\":" << wave.get_sampwidth()
+			<< ",\"samples\":" << (wave.get_blockalign()
+				? wave.get_wavesize() / wave.get_blockalign() : 0);
+		add_catalog_record(filename, details.str());
+	}
+
+	if (visitor)
+	{
+		visitor->visit_sound(filename, wave);
+		return;
+	}
+
+	std::vector<char> file;
+	encode_pcmdata_wave(wave, file, ripset.ignorebytes, ripset.ignoreend);
+	output->put(filename, file);
+}
+
+void HERip::write_file(const std::string& filename, const char* data, int size)
+{
+	if (catalog)
+		add_catalog_record(filename, ",\"bytes\":" + to_string(size));
+
+	std::vector<char> file(data, data + size);
+	if (visitor)
+		visitor->visit_file(filename, file);
+	else
+		output->put(filename, file);
+}
+
+void HERip::write_file(const std::string& filename, const std::string& contents)
+{
+	if (visitor)
+	{
+		visitor->visit_text(filename, contents);
+		return;
+	}
+
+	std::vector<char> file(contents.begin(), contents.end());
+	output->put(filename, file);
+}
+
+void HERip::append_file(const std::string& filename, const std::string& contents)
+{
+	if (visitor)
+	{
+		visitor->visit_text(filename, contents);
+		return;
+	}
+
+	std::vector<char> file(contents.begin(), contents.end());
+	output->append(filename, file);
+}
+
+std::string HERip::output_prefix(const std::string& fprefix, const std::string& subdir)
+{
+	if (layout != layout_tree)
+		return fprefix;
+
+	std::string dir = fprefix + '/' + subdir;
+	if (make_output_dirs && output_dirs.insert(dir).second)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		if (ec)
+			logger.error("couldn't create directory " + dir);
+	}
+	return dir + '/' + strip_path(fprefix);
+}
+
+std::string HERip::room_prefix(const std::string& fprefix, int rmnum,
+	const std::string& type)
+{
+	std::string rmnumstr = to_string(rmnum);
+	if (layout != layout_tree)
+		return fprefix + "-room-" + rmnumstr;
+	return output_prefix(fprefix, "room-" + rmnumstr + '/' + type)
+		+ "-room-" + rmnumstr;
+}
+
+void HERip::begin_catalog_asset(const std::string& type, int index,
+	int offset, int size)
+{
+	catalog_asset.type = type;
+	catalog_asset.index = index;
+	catalog_asset.offset = offset;
+	catalog_asset.size = size;
+	catalog_asset.fields.clear();
+	catalog_trim.clear();
+}
+
+void HERip::begin_catalog_asset(const std::string& type, int index,
+	const SputmChunkHead& chunk)
+{
+	begin_catalog_asset(type, index, chunk.address, chunk.size);
+}
+
+void HERip::add_catalog_name(const std::string& key, const std::string& name)
+{
+	if (catalog && name.size())
+		catalog_asset.fields += "," + json_string(key) + ":" + json_string(name);
+}
+
+void HERip::add_catalog_names(const std::string& key,
+	const std::vector<std::string>& names)
+{
+	if (!catalog || names.empty())
+		return;
+
+	catalog_asset.fields += "," + json_string(key) + ":[";
+	for (std::vector<std::string>::size_type i = 0; i < names.size(); i++)
+		catalog_asset.fields += (i ? "," : "") + json_string(names[i]);
+	catalog_asset.fields += "]";
+}
+
+void HERip::add_catalog_record(const std::string& path, const std::string& details)
+{
+	if (catalog_asset.type.empty())
+		return;
+
+	std::ostringstream record;
+	record << "{\"type\":" << json_string(catalog_asset.type);
+	if (catalog_asset.room != -1)
+		record << ",\"room\":" << catalog_asset.room;
+	if (catalog_asset.index != -1)
+		record << ",\"index\":" << catalog_asset.index;
+	record << ",\"offset\":" << catalog_asset.offset
+		<< ",\"size\":" << catalog_asset.size
+		<< ",\"path\":" << json_string(path)
+		<< details << catalog_asset.fields << "}\n";
+	catalog_records += record.str();
+}
+
+void HERip::flush_catalog()
+{
+	if (catalog_records.size())
+		append_file(catalog_file, catalog_records);
+	catalog_records.clear();
+}
+
+RipUtil::BitmapData& HERip::trim_image(RipUtil::BitmapData& bmp,
+	RipUtil::BitmapData& trimmed, int bgcolor, const RipUtil::DrawRect& drawn)
+{
+	catalog_trim.clear();
+
+	// only palettized images have a single background color
+	if (!trim || !bmp.get_palettized() || !bmp.get_width() || !bmp.get_height())
+		return bmp;
+
+	DrawRect bounds = bmp.find_bounds(bgcolor, drawn);
+
+	// nothing drawn: keep one pixel, as an empty image can't be written
+	if (!bounds.width)
+	{
+		bounds.width = 1;
+		bounds.height = 1;
+	}
+
+	std::ostringstream fields;
+	fields << ",\"trimx\":" << bounds.x << ",\"trimy\":" << bounds.y
+		<< ",\"fullwidth\":" << bmp.get_width() << ",\"fullheight\":" << bmp.get_height();
+	catalog_trim = fields.str();
+
+	if (bounds.width == bmp.get_width() && bounds.height == bmp.get_height())
+		return bmp;
+
+	bmp.copy_rect(trimmed, bounds.x, bounds.y, bounds.width, bounds.height);
+	return trimmed;
+}
+
+RipUtil::BitmapData& HERip::trim_image(RipUtil::BitmapData& bmp,
+	RipUtil::BitmapData& trimmed, int bgcolor)
+{
+	DrawRect all = { 0, 0, bmp.get_width(), bmp.get_height() };
+	return trim_image(bmp, trimmed, bgcolor, all);
+}
+
+void HERip::write_multipalette_image(RipUtil::BitmapData& bmp, const LFLFChunk& lflfc,
+	const std::string& outfile_base, int transind, RipperFormats::RipResults& results)
+{
+	if (separatepalettes)
+	{
+		// the pixels are the same whichever palette is used, so write them
+		// once; the first palette keeps the image viewable
+		bmp.set_palette(lflfc.apals[0]);
+		std::string filename = write_image(bmp, outfile_base, transind);
+		if (bmp.get_palettized())
+			palette_manifest.push_back(filename);
+		++results.graphics_ripped;
+		return;
+	}
+
+	for (std::vector<BitmapPalette>::size_type j = 0;
+		j < lflfc.apals.size(); j++)
+	{
+		bmp.set_palette(lflfc.apals[j]);
+		write_image(bmp, outfile_base + "-apal-" + to_string(j), transind);
+		++results.graphics_ripped;
+	}
+}
+
+void HERip::write_atlas(std::vector<RipUtil::BitmapData>& images,
+	const std::vector<std::string>& names, const LFLFChunk& lflfc,
+	const RipUtil::BitmapPalette* palette, const std::string& outfile_base,
+	int transind, RipperFormats::RipResults& results)
+{
+	std::vector<PackedRect> rects(images.size());
+	for (std::vector<BitmapData>::size_type i = 0; i < images.size(); i++)
+	{
+		rects[i].width = images[i].get_width();
+		rects[i].height = images[i].get_height();
+	}
+	int width, height;
+	pack_rects(rects, 1, width, height);
+
+	BitmapData sheet;
+	sheet.resize_pixels(width, height, 8);
+	sheet.set_palettized(true);
+	sheet.clear(transind);
+	for (std::vector<BitmapData>::size_type i = 0; i < images.size(); i++)
+	{
+		if (rects[i].width > 0 && rects[i].height > 0)
+			sheet.blit_bitmapdata(images[i], rects[i].x, rects[i].y);
+	}
+
+	if (palette)
+	{
+		sheet.set_palette(*palette);
+		write_image(sheet, outfile_base + "-atlas", transind);
+		++results.graphics_ripped;
+	}
+	else if (lflfc.apals.size() == 1)
+	{
+		sheet.set_palette(lflfc.apals[0]);
+		write_image(sheet, outfile_base + "-atlas", transind);
+		++results.graphics_ripped;
+	}
+	else if (lflfc.apals.size())
+	{
+		write_multipalette_image(sheet, lflfc, outfile_base + "-atlas",
+			transind, results);
+	}
+
+	std::ostringstream ofs;
+	ofs << "width: " << width << '\n';
+	ofs << "height: " << height << '\n';
+	ofs << "images: " << images.size() << '\n';
+	ofs << "name" << '\t' << "x" << '\t' << "y" << '\t' << "width" << '\t'
+		<< "height" << '\n';
+	for (std::vector<PackedRect>::size_type i = 0; i < rects.size(); i++)
+	{
+		ofs << names[i] << '\t' << rects[i].x << '\t' << rects[i].y << '\t'
+			<< rects[i].width << '\t' << rects[i].height << '\n';
 	}
+	write_file(outfile_base + "-atlas.txt", ofs.str());
+}
+
+void HERip::write_room_palettes(const LFLFChunk& lflfc, const std::string& fprefix)
+{
+	// palettes are referred to by name only, relative to the manifest
+	std::vector<std::string> palnames;
+	for (std::vector<BitmapPalette>::size_type j = 0;
+		j < lflfc.apals.size(); j++)
+	{
+		std::string filename = fprefix + "-apal-" + to_string(j) + ".pal";
+		palnames.push_back(strip_path(filename));
+
+		// JASC-PAL: header, then one "r g b" line per color
+		const BitmapPalette& palette = lflfc.apals[j];
+		std::ostringstream ofs;
+		ofs << "JASC-PAL\r\n" << "0100\r\n" << "256\r\n";
+		for (int k = 0; k < 256; k++)
+		{
+			int color = 0;
+			BitmapPalette::const_iterator it = palette.find(k);
+			if (it != palette.end())
+				color = (*it).second;
+			ofs << (color & 0xFF) << ' ' << ((color >> 8) & 0xFF) << ' '
+				<< ((color >> 16) & 0xFF) << "\r\n";
+		}
+		write_file(filename, ofs.str());
+	}
+
+	// one line per image: its name, then the palettes it can be shown with
+	std::ostringstream ofs;
+	for (std::vector<std::string>::size_type i = 0;
+		i < palette_manifest.size(); i++)
+	{
+		ofs << strip_path(palette_manifest[i]);
+		for (std::vector<std::string>::size_type j = 0;
+			j < palnames.size(); j++)
+			ofs << '\t' << palnames[j];
+		ofs << '\n';
+	}
+	write_file(fprefix + "-palettes.txt", ofs.str());
+
+	palette_manifest.clear();
 }
 
 void HERip::disable_all_ripping()
@@ -419,15 +1073,6 @@ void HERip::rip_lecf(RipUtil::MembufStream& stream, const std::string& fprefix,
 	const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat,
 	RipperFormats::RipResults& results)
 {
-	// clear any files we need to write to
-	if (metadatarip)
-	{
-		std::ofstream((fprefix + "-metadata.txt").c_str(), std::ios_base::trunc);
-	}
-	if (catscripts && scriptrip) {
-		std::ofstream((fprefix + "-scripts").c_str(), std::ios_base::trunc);
-	}
-
 	SputmChunkHead lecf_hd;
 	SputmChunk loffc;
 	read_sputm_chunkhead(stream, lecf_hd);
@@ -441,12 +1086,41 @@ void HERip::rip_lecf(RipUtil::MembufStream& stream, const std::string& fprefix,
 		stream.seekg(lecfstart);
 	}
 
+	// rooms left as they were at the last rip with the same settings are
+	// skipped; rooms outside the ripped range keep their old entries
+	RipManifest oldmanifest;
+	RipManifest manifest;
+	std::string manifestfile = fprefix + "-manifest.txt";
+	int rooms_skipped = 0;
+	if (incremental)
+	{
+		manifest.settings = get_output_settings(ripset);
+		if (oldmanifest.read(manifestfile))
+		{
+			if (oldmanifest.settings == manifest.settings)
+				manifest.rooms = oldmanifest.rooms;
+			else
+			{
+				logger.print("settings have changed since the last rip, "
+					"ripping all rooms");
+				oldmanifest.rooms.clear();
+			}
+		}
+	}
+
+	// with threads, the rooms are found first and ripped afterwards
+	bool parallel = room_threads > 1 && !visitor;
+	std::vector<int> offsets;
+	std::vector<int> sizes;
+	int firstroom = 0;
+	bool endedread = false;
+
 	int rmnum = 0;
 	while (stream.tellg() < lecf_hd.nextaddr())
 	{
 		if (roomend != not_set && rmnum > roomend)
 		{
-			logger.print("ending read at room " + to_string(rmnum));
+			endedread = true;
 			break;
 		}
 		else if (roomstart != not_set && rmnum < roomstart)
@@ -456,150 +1130,460 @@ void HERip::rip_lecf(RipUtil::MembufStream& stream, const std::string& fprefix,
 			read_sputm_chunkhead(stream, skiphd);
 			stream.seekg(skiphd.nextaddr());
 			++rmnum;
+			firstroom = rmnum;
 			continue;
 		}
 
-		int starttime = std::clock();
+		if (parallel)
+		{
+			int offset = stream.tellg();
+			SputmChunkHead roomhd;
+			read_sputm_chunkhead(stream, roomhd);
+			offsets.push_back(offset);
+			sizes.push_back(std::max(std::min(roomhd.size,
+				stream.get_fsize() - offset), 0));
+			stream.seekg(roomhd.nextaddr());
+			++rmnum;
+			continue;
+		}
 
-		std::string rmstr = "-room-" + to_string(rmnum);
+		// don't pick up anything written by earlier rooms' text rippers
+		if (incremental)
+		{
+			std::vector<RecordingSink::Record> discard;
+			recorder->take_records(discard);
+		}
 
-		logger.print("reading room " + to_string(rmnum) + "...");
+		ManifestRoom manifestroom;
+		bool skip = false;
+		rip_room(stream, fprefix, ripset, fmtdat, rmnum, lecf_hd.nextaddr(),
+			oldmanifest, manifestroom, skip, results);
+		if (skip)
+			++rooms_skipped;
+		if (incremental && !skip)
+			recorder->take_records(manifestroom.outputs);
+		if (incremental)
+			manifest.rooms[rmnum] = manifestroom;
 
-		LFLFChunk lflfc;
-		read_lflf(stream, lflfc);
+	++rmnum;
 
-		logger.print("...finished read");
-			
-		starttime = std::clock() - starttime;
-		logger.qprint("\tread time: " + to_string((double)starttime/CLOCKS_PER_SEC)
-			+ " s");
-		logger.qprint("\tread stats:");
-		if (lflfc.rmim_chunk.images.size())
-			logger.qprint("\t\tRMIM: " + to_string(lflfc.rmim_chunk.images.size()));
-		if (lflfc.obim_chunks.size())
-			logger.qprint("\t\tOBIM: " + to_string(lflfc.obim_chunks.size()));
-		if (lflfc.akos_chunks.size())
-			logger.qprint("\t\tAKOS: " + to_string(lflfc.akos_chunks.size()));
-		if (lflfc.awiz_chunks.size())
-			logger.qprint("\t\tAWIZ: " + to_string(lflfc.awiz_chunks.size()));
-		if (lflfc.mult_chunks.size())
-			logger.qprint("\t\tMULT: " + to_string(lflfc.mult_chunks.size()));
-		if (lflfc.char_chunks.size())
-			logger.qprint("\t\tCHAR: " + to_string(lflfc.char_chunks.size()));
-		if (lflfc.digi_chunks.size())
-			logger.qprint("\t\tDIGI: " + to_string(lflfc.digi_chunks.size()));
-		if (lflfc.talk_chunks.size())
-			logger.qprint("\t\tTALK: " + to_string(lflfc.talk_chunks.size()));
-		if (lflfc.wsou_chunks.size())
-			logger.qprint("\t\tWSOU: " + to_string(lflfc.wsou_chunks.size()));
+	}
 
-		if (!stream.eof())
-		{
-			stream.seekg(lflfc.nextaddr());
-		}
-		else if (stream.eof() && lflfc.nextaddr() < lecf_hd.nextaddr())
-		{
-			logger.error("stream unexpectedly reached end of file -- "
-				"probably hit a misaligned chunk, recovering to next room");
-			stream.clear();
-			stream.seekg(lflfc.nextaddr());
-		}
+	if (parallel)
+	{
+		rip_rooms_parallel(stream, fprefix, ripset, fmtdat, offsets, sizes, firstroom,
+			lecf_hd.nextaddr(), oldmanifest, manifest, rooms_skipped, results);
+	}
 
-		// set alternate transparency color, if requested
-		if (!alttrans)
-			transcol = lflfc.trns_chunk.trns_val;
+	if (endedread)
+		logger.print("ending read at room " + to_string(rmnum));
 
-		if (rmimrip && lflfc.rmim_chunk.type == rmim)
-		{
-			logger.print("\tripping RMIM");
-			rip_rmim(lflfc, ripset, fprefix + rmstr, results, transcol);
-		}
+	if (incremental)
+	{
+		manifest.write(manifestfile);
+		logger.print(to_string(rooms_skipped) + " unchanged rooms skipped");
+	}
+}
 
-		if (obimrip && lflfc.obim_chunks.size())
-		{
-			logger.print("\tripping OBIM");
-			rip_obim(lflfc, ripset, fprefix + rmstr, results, transcol);
-		}
+void HERip::rip_room(RipUtil::MembufStream& stream, const std::string& fprefix,
+	const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat,
+	int rmnum, int lecfend, const RipManifest& oldmanifest,
+	ManifestRoom& manifestroom, bool& skip, RipperFormats::RipResults& results)
+{
+	bool textrip = tlkerip || scriptrip || metadatarip;
 
-		if ((akosrip || sequencerip) && lflfc.akos_chunks.size())
-		{
-			if (akosrip && sequencerip)
-			{
-				logger.print("\tripping AKOS and sequences");
-			}
-			else if (akosrip)
-			{
-				logger.print("\tripping AKOS");
-			}
-			else if (sequencerip)
+	skip = false;
+	if (incremental)
+	{
+		manifestroom.offset = stream.tellg();
+		SputmChunkHead roomhd;
+		read_sputm_chunkhead(stream, roomhd);
+		manifestroom.size = std::min(roomhd.size,
+			stream.get_fsize() - manifestroom.offset);
+		std::vector<char> roomdata(std::max(manifestroom.size, 0));
+		stream.seekg(manifestroom.offset);
+		stream.read(roomdata.size() ? &roomdata[0] : 0, roomdata.size());
+		stream.clear();
+		stream.seekg(manifestroom.offset);
+		manifestroom.hash = xxh64(roomdata.size() ? &roomdata[0] : 0,
+			roomdata.size());
+		manifestroom.before.capture();
+
+		skip = oldmanifest.room_unchanged(rmnum, manifestroom);
+		if (skip)
+		{
+			logger.print("room " + to_string(rmnum) + " is unchanged, skipping");
+			manifestroom = oldmanifest.rooms.find(rmnum)->second;
+			manifestroom.after.restore();
+			catalog_records += manifestroom.catalog;
+			flush_catalog();
+			if (!textrip)
 			{
-				logger.print("\tripping sequences");
+				stream.seekg(roomhd.nextaddr());
+				return;
 			}
-			rip_akos(lflfc, ripset, fprefix + rmstr, results, transcol);
 		}
+	}
 
-		if (awizrip && lflfc.awiz_chunks.size())
-		{
-			logger.print("\tripping AWIZ");
-			rip_awiz(lflfc, ripset, fprefix + rmstr, results, transcol);
-		}
+	int starttime = std::clock();
 
-		if (charrip && lflfc.char_chunks.size())
-		{
-			logger.print("\tripping CHAR");
-			rip_char(lflfc, ripset, fprefix + rmstr, results, transcol);
-		}
+	logger.print("reading room " + to_string(rmnum) + "...");
 
-		if (digirip && lflfc.digi_chunks.size())
-		{
-			logger.print("\tripping DIGI");
-			rip_sound(lflfc.digi_chunks, ripset, fprefix + rmstr + "-digi-",
-				results);
-		}
+	LFLFChunk lflfc;
+	read_lflf(stream, lflfc);
 
-		if (talkrip && lflfc.talk_chunks.size())
-		{
-			logger.print("\tripping TALK");
-			rip_sound(lflfc.talk_chunks, ripset, fprefix + rmstr + "-talk-",
-				results);
-		}
+	logger.print("...finished read");
+		
+	starttime = std::clock() - starttime;
+	logger.qprint("\tread time: " + to_string((double)starttime/CLOCKS_PER_SEC)
+		+ " s");
+	logger.qprint("\tread stats:");
+	if (lflfc.rmim_chunk.images.size())
+		logger.qprint("\t\tRMIM: " + to_string(lflfc.rmim_chunk.images.size()));
+	if (lflfc.obim_chunks.size())
+		logger.qprint("\t\tOBIM: " + to_string(lflfc.obim_chunks.size()));
+	if (lflfc.akos_chunks.size())
+		logger.qprint("\t\tAKOS: " + to_string(lflfc.akos_chunks.size()));
+	if (lflfc.awiz_chunks.size())
+		logger.qprint("\t\tAWIZ: " + to_string(lflfc.awiz_chunks.size()));
+	if (lflfc.mult_chunks.size())
+		logger.qprint("\t\tMULT: " + to_string(lflfc.mult_chunks.size()));
+	if (lflfc.char_chunks.size())
+		logger.qprint("\t\tCHAR: " + to_string(lflfc.char_chunks.size()));
+	if (lflfc.digi_chunks.size())
+		logger.qprint("\t\tDIGI: " + to_string(lflfc.digi_chunks.size()));
+	if (lflfc.talk_chunks.size())
+		logger.qprint("\t\tTALK: " + to_string(lflfc.talk_chunks.size()));
+	if (lflfc.wsou_chunks.size())
+		logger.qprint("\t\tWSOU: " + to_string(lflfc.wsou_chunks.size()));
+
+	if (!stream.eof())
+	{
+		stream.seekg(lflfc.nextaddr());
+	}
+	else if (stream.eof() && lflfc.nextaddr() < lecfend)
+	{
+		logger.error("stream unexpectedly reached end of file -- "
+			"probably hit a misaligned chunk, recovering to next room");
+		stream.clear();
+		stream.seekg(lflfc.nextaddr());
+	}
 
-		if (wsourip && lflfc.wsou_chunks.size())
-		{
-			logger.print("\tripping WSOU");
-			rip_wsou(lflfc, ripset, fprefix + rmstr, results,
-				// override decoding settings if normaliziation requested
-				ripset.normalize ? true : ripset.decode_audio);
-		}
+	// set alternate transparency color, if requested
+	if (!alttrans)
+		transcol = lflfc.trns_chunk.trns_val;
+
+	// the catalog records of the room's files are kept in the manifest;
+	// those of the text rippers are made again when a room is skipped
+	if (!skip)
+	{
+		catalog_asset.room = rmnum;
+		catalog_lflf = &lflfc;
+		rip_room_files(lflfc, fprefix, ripset, fmtdat, rmnum, results);
+		catalog_lflf = 0;
+		if (incremental)
+			manifestroom.catalog = catalog_records;
+	}
+	catalog_asset = CatalogAsset();
+	catalog_asset.room = rmnum;
+
+	if (tlkerip && lflfc.tlke_chunks.size())
+	{
+		logger.print("\tripping TLKE");
+		rip_tlke(lflfc, ripset, fprefix + "-tlke.txt",
+			rmnum, results);
+	}
+
+	if (scriptrip)
+	{
+		logger.print("\tripping scripts");
+		rip_scripts(lflfc, ripset, fprefix, 
+			rmnum, results);
+	}
+
+	if (metadatarip)
+	{
+		logger.print("\tripping metadata");
+		rip_metadata(lflfc, ripset, fprefix + "-metadata.txt", 
+			rmnum, results);
+	}
+
+	if (incremental && !skip)
+		manifestroom.after.capture();
+	catalog_asset = CatalogAsset();
+	flush_catalog();
+}
+
+// The state the threads of a window share for handing rooms on: the hack
+// state left by the rooms handed on so far, and which of the rest have
+// finished. Rooms are only handed on by the thread holding the mutex
+struct HERip::RoomHandoff
+{
+	RoomHandoff(int count, const DecodingHackState& state_, RipManifest& manifest_,
+		int& rooms_skipped_, RipperFormats::RipResults& results_)
+		: finished(count), next(0), state(state_), manifest(manifest_),
+		rooms_skipped(rooms_skipped_), results(results_) { };
+
+	std::mutex mutex;
+	std::vector<char> finished;
+	int next;					// the room to be handed on next
+	DecodingHackState state;
+	RipManifest& manifest;
+	int& rooms_skipped;
+	RipperFormats::RipResults& results;
+};
+
+// Runs the jobs of a window of rooms. Each job reads its room through a
+// stream of its own, and sends its log messages to the job. Whichever
+// thread finishes the room next in line hands it on, along with any rooms
+// after it that finished first, so a room's files are only held for as
+// long as the rooms before it take
+struct HERip::RoomJobRunner
+{
+	RoomJobRunner(HERip& owner_, std::vector<RoomJob>& jobs_, RoomHandoff& handoff_,
+		RipUtil::MembufStream& stream_, const std::string& fprefix_,
+		const RipperFormats::RipperSettings& ripset_,
+		const RipperFormats::FileFormatData& fmtdat_, int lecfend_,
+		const RipManifest& oldmanifest_)
+		: owner(owner_), jobs(jobs_), handoff(handoff_), stream(stream_),
+		fprefix(fprefix_), ripset(ripset_), fmtdat(fmtdat_), lecfend(lecfend_),
+		oldmanifest(oldmanifest_) { };
+
+	void operator()(int i) const
+	{
+		run(jobs[i]);
+
+		std::lock_guard<std::mutex> lock(handoff.mutex);
+		handoff.finished[i] = true;
+		while (handoff.next < (int)jobs.size() && handoff.finished[handoff.next])
+			owner.hand_on_room(jobs[handoff.next++], *this, handoff);
+	}
+
+	// the calling thread's hack state is left as it was, since the calling
+	// thread may be the one handing the rooms on
+	void run(RoomJob& job) const
+	{
+		DecodingHackState threadstate;
+		threadstate.capture();
+		bool threadused = decoding_hacks_used;
+
+		ErrorLog::set_capture(&job.log);
+		job.before.restore();
+		decoding_hacks_used = false;
+
+		// a buffer the size of the room, rather than the whole file
+		MembufStream roomstream(stream, job.offset, std::max(job.size, 1));
+		job.ripper->rip_room(roomstream, fprefix, ripset, fmtdat, job.rmnum, lecfend,
+			oldmanifest, job.manifestroom, job.skip, job.results);
+
+		job.hacks_used = decoding_hacks_used;
+		job.after.capture();
+		ErrorLog::set_capture(0);
+
+		threadstate.restore();
+		decoding_hacks_used = threadused;
+	}
+
+	HERip& owner;
+	std::vector<RoomJob>& jobs;
+	RoomHandoff& handoff;
+	RipUtil::MembufStream& stream;
+	const std::string& fprefix;
+	const RipperFormats::RipperSettings& ripset;
+	const RipperFormats::FileFormatData& fmtdat;
+	int lecfend;
+	const RipManifest& oldmanifest;
+};
+
+void HERip::prepare_room_job(RoomJob& job)
+{
+	delete job.ripper;
+
+	// the copy starts with no scripts or directories of its own; they're
+	// merged back in when the room is handed on
+	ScriptPackWriter pack;
+	std::set<std::string> dirs;
+	std::swap(pack, scriptpack);
+	std::swap(dirs, output_dirs);
+	job.ripper = new HERip(*this);
+	std::swap(pack, scriptpack);
+	std::swap(dirs, output_dirs);
+
+	job.files = BufferSink();
+	job.ripper->output = &job.files;
+	job.ripper->recorder = 0;
+	job.log.entries.clear();
+	job.manifestroom = ManifestRoom();
+	job.skip = false;
+	job.hacks_used = false;
+	job.results = RipResults();
+}
+
+void HERip::hand_on_room(RoomJob& job, const RoomJobRunner& runner, RoomHandoff& handoff)
+{
+	bool depends = job.hacks_used || incremental;
+	if (depends && job.before != handoff.state)
+	{
+		job.before = handoff.state;
+		prepare_room_job(job);
+		runner.run(job);
+	}
+
+	// don't pick up anything written by earlier rooms' text rippers
+	if (incremental)
+	{
+		std::vector<RecordingSink::Record> discard;
+		recorder->take_records(discard);
+	}
+
+	logger.replay(job.log);
+	job.files.replay(*output);
+	if (job.skip)
+		++handoff.rooms_skipped;
+	if (incremental && !job.skip)
+		recorder->take_records(job.manifestroom.outputs);
+	if (incremental)
+		handoff.manifest.rooms[job.rmnum] = job.manifestroom;
+
+	if (depends)
+		handoff.state = job.after;
+	scriptpack.add(job.ripper->scriptpack);
+	output_dirs.insert(job.ripper->output_dirs.begin(),
+		job.ripper->output_dirs.end());
+	handoff.results += job.results;
+
+	// the rest of the window may take a while yet
+	delete job.ripper;
+	job.ripper = 0;
+	job.files = BufferSink();
+	job.log.entries.clear();
+}
 
-		if (extdmurip && lflfc.fmus_chunks.size())
+void HERip::rip_rooms_parallel(RipUtil::MembufStream& stream, const std::string& fprefix,
+	const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat,
+	const std::vector<int>& offsets, const std::vector<int>& sizes, int firstroom,
+	int lecfend, const RipManifest& oldmanifest, RipManifest& manifest,
+	int& rooms_skipped, RipperFormats::RipResults& results)
+{
+	ThreadPool pool(room_threads);
+
+	// Rooms are ripped a window at a time, all from the hack state at the
+	// start of the window, and handed on in order as they finish. The hacks
+	// settle after their first few images, so the guess is nearly always
+	// right; a room that used the hacks from the wrong state is ripped again
+	// when its turn comes. Until they settle, windows are kept small so that
+	// few rooms can need ripping again. Incremental rips check the state even
+	// for rooms that didn't use the hacks, since it decides whether a room
+	// is skipped. Rooms are started in order, so that the ones handed on
+	// first are the ones finished first
+	for (int start = 0; start < (int)offsets.size(); )
+	{
+		int window = decoding_hacks_settled() ? room_threads * 4 : room_threads;
+		int count = std::min(window, (int)offsets.size() - start);
+
+		DecodingHackState guess;
+		guess.capture();
+
+		std::vector<RoomJob> jobs(count);
+		for (int i = 0; i < count; i++)
 		{
-			rip_extdmu(lflfc, fprefix, ripset, fmtdat, results);
+			jobs[i].rmnum = firstroom + start + i;
+			jobs[i].offset = offsets[start + i];
+			jobs[i].size = sizes[start + i];
+			jobs[i].before = guess;
+			prepare_room_job(jobs[i]);
 		}
 
-		if (tlkerip && lflfc.tlke_chunks.size())
+		RoomHandoff handoff(count, guess, manifest, rooms_skipped, results);
+		RoomJobRunner runner(*this, jobs, handoff, stream, fprefix, ripset, fmtdat,
+			lecfend, oldmanifest);
+		pool.parallel_for(count, runner);
+
+		// the next window starts from where the rooms handed on left off
+		handoff.state.restore();
+		start += count;
+	}
+}
+
+void HERip::rip_room_files(LFLFChunk& lflfc, const std::string& fprefix,
+	const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat,
+	int rmnum, RipperFormats::RipResults& results)
+{
+	if (rmimrip && lflfc.rmim_chunk.type == rmim)
+	{
+		logger.print("\tripping RMIM");
+		rip_rmim(lflfc, ripset, room_prefix(fprefix, rmnum, "rmim"), results, transcol);
+	}
+
+	if (obimrip && lflfc.obim_chunks.size())
+	{
+		logger.print("\tripping OBIM");
+		rip_obim(lflfc, ripset, room_prefix(fprefix, rmnum, "obim"), results, transcol);
+	}
+
+	if ((akosrip || sequencerip) && lflfc.akos_chunks.size())
+	{
+		if (akosrip && sequencerip)
 		{
-			logger.print("\tripping TLKE");
-			rip_tlke(lflfc, ripset, fprefix + "-tlke.txt",
-				rmnum, results);
+			logger.print("\tripping AKOS and sequences");
 		}
-
-		if (scriptrip)
+		else if (akosrip)
 		{
-			logger.print("\tripping scripts");
-			rip_scripts(lflfc, ripset, fprefix, 
-				rmnum, results);
+			logger.print("\tripping AKOS");
 		}
-
-		if (metadatarip)
+		else if (sequencerip)
 		{
-			logger.print("\tripping metadata");
-			rip_metadata(lflfc, ripset, fprefix + "-metadata.txt", 
-				rmnum, results);
+			logger.print("\tripping sequences");
 		}
+		rip_akos(lflfc, ripset, room_prefix(fprefix, rmnum, "akos"), results, transcol);
+	}
 
-	++rmnum;
+	if (awizrip && lflfc.awiz_chunks.size())
+	{
+		logger.print("\tripping AWIZ");
+		rip_awiz(lflfc, ripset, room_prefix(fprefix, rmnum, "awiz"), results, transcol);
+	}
+
+	if (charrip && lflfc.char_chunks.size())
+	{
+		logger.print("\tripping CHAR");
+		rip_char(lflfc, ripset, room_prefix(fprefix, rmnum, "char"), results, transcol);
+	}
+
+	if (palette_manifest.size())
+	{
+		logger.print("\twriting palettes");
+		write_room_palettes(lflfc, room_prefix(fprefix, rmnum, "palettes"));
+	}
+
+	if (digirip && lflfc.digi_chunks.size())
+	{
+		logger.print("\tripping DIGI");
+		rip_sound(lflfc.digi_chunks, ripset,
+			room_prefix(fprefix, rmnum, "digi") + "-digi-",
+			results);
+	}
+
+	if (talkrip && lflfc.talk_chunks.size())
+	{
+		logger.print("\tripping TALK");
+		rip_sound(lflfc.talk_chunks, ripset,
+			room_prefix(fprefix, rmnum, "talk") + "-talk-",
+			results);
+	}
+
+	if (wsourip && lflfc.wsou_chunks.size())
+	{
+		logger.print("\tripping WSOU");
+		rip_wsou(lflfc, ripset, room_prefix(fprefix, rmnum, "wsou"), results,
+			// override decoding settings if normaliziation requested
+			ripset.normalize ? true : ripset.decode_audio);
+	}
 
+	if (extdmurip && lflfc.fmus_chunks.size())
+	{
+		rip_extdmu(lflfc, output_prefix(fprefix, "room-" + to_string(rmnum) + "/extdmu"),
+			ripset, fmtdat, results);
 	}
 }
 
@@ -609,6 +1593,8 @@ void HERip::rip_tlkb(RipUtil::MembufStream& stream, const std::string& fprefix,
 {
 	logger.print("\tripping TLKB");
 
+	std::string tlkbprefix = output_prefix(fprefix, "tlkb");
+
 	SputmChunkHead tlkbhd;
 	read_sputm_chunkhead(stream, tlkbhd);
 	
@@ -627,14 +1613,13 @@ void HERip::rip_tlkb(RipUtil::MembufStream& stream, const std::string& fprefix,
 		{
 			SoundChunk soundc;
 			read_digi_talk(stream, soundc);
+			begin_catalog_asset("talk", sndnum, soundc);
 			if (ripset.normalize)
 				soundc.wave.normalize();
 
-			write_pcmdata_wave(soundc.wave, fprefix
+			write_wave(soundc.wave, tlkbprefix
 				+ "-tlkb-talk-" + to_string(sndnum)
-				+ ".wav",
-				ripset.ignorebytes,
-				ripset.ignoreend);
+				+ ".wav", ripset);
 
 			++results.audio_ripped;
 			break;
@@ -643,6 +1628,7 @@ void HERip::rip_tlkb(RipUtil::MembufStream& stream, const std::string& fprefix,
 		{
 			WSOUChunk wsouc;
 			read_wsou(stream, wsouc);
+			begin_catalog_asset("wsou", sndnum, wsouc);
 			RIFFEntry& riffe = wsouc.riff_entry;
 
 			if (ripset.decode_audio)
@@ -654,20 +1640,17 @@ void HERip::rip_tlkb(RipUtil::MembufStream& stream, const std::string& fprefix,
 				if (ripset.normalize)
 					wave.normalize();
 
-				write_pcmdata_wave(wave, fprefix
+				write_wave(wave, tlkbprefix
 					+ "-tlkb-wsou-" + to_string(sndnum)
-					+ ".wav",
-					ripset.ignorebytes,
-					ripset.ignoreend);
+					+ ".wav", ripset);
 
 				++results.audio_ripped;
 			}
 			else
 			{
-				std::ofstream ofs((fprefix
+				write_file(tlkbprefix
 					+ "-tlkb-wsou-" + to_string(sndnum)
-					+ ".wav").c_str(), std::ios_base::binary);
-				ofs.write(riffe.riffdat, riffe.riffdat_size);
+					+ ".wav", riffe.riffdat, riffe.riffdat_size);
 
 				++results.audio_ripped;
 			}
@@ -788,6 +1771,8 @@ void HERip::rip_song_entries(RipUtil::MembufStream& stream, const SONGHeader& so
 	const std::string& fprefix, const RipperFormats::RipperSettings& ripset, 
 	RipperFormats::RipResults& results)
 {
+	std::string songprefix = output_prefix(fprefix, "song");
+
 	for (std::vector<SONGEntry>::size_type i = 0;
 		i < song_header.song_entries.size(); i++)
 	{
@@ -801,6 +1786,7 @@ void HERip::rip_song_entries(RipUtil::MembufStream& stream, const SONGHeader& so
 		}
 
 		const SONGEntry& songe = song_header.song_entries[i];
+		begin_catalog_asset("song", i, songe.address, songe.length);
 
 		stream.seekg(songe.address);
 
@@ -817,11 +1803,9 @@ void HERip::rip_song_entries(RipUtil::MembufStream& stream, const SONGHeader& so
 			if (ripset.normalize)
 				soundc.wave.normalize();
 
-			write_pcmdata_wave(soundc.wave, fprefix
+			write_wave(soundc.wave, songprefix
 				+ "-song-digi-" + to_string(i)
-				+ ".wav",
-				ripset.ignorebytes,
-				ripset.ignoreend);
+				+ ".wav", ripset);
 
 			++results.audio_ripped;
 			break;
@@ -840,11 +1824,9 @@ void HERip::rip_song_entries(RipUtil::MembufStream& stream, const SONGHeader& so
 				if (ripset.normalize)
 					wave.normalize();
 
-				write_pcmdata_wave(wave, fprefix
+				write_wave(wave, songprefix
 					+ "-song-riff-" + to_string(i)
-					+ ".wav",
-					ripset.ignorebytes,
-					ripset.ignoreend);
+					+ ".wav", ripset);
 
 				++results.audio_ripped;
 			}
@@ -854,10 +1836,9 @@ void HERip::rip_song_entries(RipUtil::MembufStream& stream, const SONGHeader& so
 				int sz = set_end(hdcheck.size, 4, DatManip::le) + 8;
 				char* data = new char[sz];
 				stream.read(data, sz);
-				std::ofstream ofs((fprefix
+				write_file(songprefix
 					+ "-song-riff-" + to_string(i)
-					+ ".wav").c_str(), std::ios_base::binary);
-				ofs.write(data, sz);
+					+ ".wav", data, sz);
 				delete[] data;
 
 				++results.audio_ripped;
@@ -875,11 +1856,9 @@ void HERip::rip_song_entries(RipUtil::MembufStream& stream, const SONGHeader& so
 			if (ripset.normalize)
 				wave.normalize();
 
-			write_pcmdata_wave(wave, fprefix
+			write_wave(wave, songprefix
 				+ "-song-unheadered-" + to_string(i)
-				+ ".wav",
-				ripset.ignorebytes,
-				ripset.ignoreend);
+				+ ".wav", ripset);
 
 			++results.audio_ripped;
 			break;
@@ -905,6 +1884,7 @@ void HERip::rip_song_dmu(RipUtil::MembufStream& stream, const std::string& fpref
 	stream.seekg(0);
 	SoundChunk soundc;
 	read_digi_talk(stream, soundc);
+	begin_catalog_asset("dmu", -1, soundc);
 
 	// account for DMU signedness
 	soundc.wave.set_signed(DatManip::has_sign);
@@ -913,10 +1893,8 @@ void HERip::rip_song_dmu(RipUtil::MembufStream& stream, const std::string& fpref
 	if (ripset.normalize)
 		soundc.wave.normalize();
 
-	write_pcmdata_wave(soundc.wave, fprefix
-		+ ".wav",
-		ripset.ignorebytes,
-		ripset.ignoreend);
+	write_wave(soundc.wave, fprefix
+		+ ".wav", ripset);
 
 	++results.audio_ripped;
 }
@@ -964,6 +1942,7 @@ void HERip::rip_rmim(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 		i < lflfc.rmim_chunk.images.size(); i++)
 	{
 		const IMxxChunk& imxxc = lflfc.rmim_chunk.images[i];
+		begin_catalog_asset("rmim", i, imxxc);
 		
 		BitmapData bmp;
 		decode_imxx(imxxc, bmp, lflfc.rmhd_chunk.width, lflfc.rmhd_chunk.height,
@@ -973,29 +1952,23 @@ void HERip::rip_rmim(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 		{
 			bmp.set_palettized(true);
 			bmp.set_palette(room_palettes[ripset.palettenum]);
-			write_bitmapdata_8bitpalettized_bmp(bmp, fprefix + "-rmim-" 
-				+ to_string(i) + ".bmp");
+			write_image(bmp, fprefix + "-rmim-" 
+				+ to_string(i), transind);
 			++results.graphics_ripped;
 		}
 		else if (lflfc.apals.size() == 1)	// one palette: use abbreviated filenames
 		{
 			bmp.set_palettized(true);
 			bmp.set_palette(lflfc.apals[0]);
-			write_bitmapdata_8bitpalettized_bmp(bmp, fprefix + "-rmim-" 
-				+ to_string(i) + ".bmp");
+			write_image(bmp, fprefix + "-rmim-" 
+				+ to_string(i), transind);
 			++results.graphics_ripped;
 		}
 		else if (lflfc.apals.size())	// multiple palettes: use full filenames
 		{
 			bmp.set_palettized(true);
-			for (std::vector<BitmapPalette>::size_type j = 0; 
-				j < lflfc.apals.size(); j++)
-			{
-				bmp.set_palette(lflfc.apals[j]);
-				write_bitmapdata_8bitpalettized_bmp(bmp, fprefix + "-rmim-" 
-					+ to_string(i) + "-apal-" + to_string(j) + ".bmp");
-				++results.graphics_ripped;
-			}
+			write_multipalette_image(bmp, lflfc, fprefix + "-rmim-" 
+				+ to_string(i), transind, results);
 		}
 	}
 }
@@ -1016,6 +1989,10 @@ void HERip::rip_obim(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 				for (std::vector<IMxxChunk>::size_type i = 0;
 					i < (*obim_it).second.images.size(); i++)
 				{
+					begin_catalog_asset("obim", (*obim_it).first,
+						(*obim_it).second.images[i]);
+					add_catalog_name("OBNA", (*obcd_it).second.obna_val);
+
 					BitmapData bmp;
 					decode_imxx((*obim_it).second.images[i], bmp, width, height,
 						lflfc.trns_chunk.trns_val, transind);
@@ -1024,30 +2001,24 @@ void HERip::rip_obim(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 					{
 						bmp.set_palettized(true);
 						bmp.set_palette(room_palettes[ripset.palettenum]);
-						write_bitmapdata_8bitpalettized_bmp(bmp, fprefix + "-obim-" 
-							+ to_string((*obim_it).first) + "-im-" + to_string(i) + ".bmp");
+						write_image(bmp, fprefix + "-obim-" 
+							+ to_string((*obim_it).first) + "-im-" + to_string(i), transind);
 						++results.graphics_ripped;
 					}
 					else if (lflfc.apals.size() == 1)
 					{
 						bmp.set_palettized(true);
 						bmp.set_palette(lflfc.apals[0]);
-						write_bitmapdata_8bitpalettized_bmp(bmp, fprefix + "-obim-" 
-							+ to_string((*obim_it).first) + "-im-" + to_string(i) + ".bmp");
+						write_image(bmp, fprefix + "-obim-" 
+							+ to_string((*obim_it).first) + "-im-" + to_string(i), transind);
 						++results.graphics_ripped;
 					}
 					else if (lflfc.apals.size())
 					{
 						bmp.set_palettized(true);
-						for (std::vector<BitmapPalette>::size_type j = 0;
-							j < lflfc.apals.size(); j++)
-						{
-							bmp.set_palette(lflfc.apals[j]);
-							write_bitmapdata_8bitpalettized_bmp(bmp, fprefix + "-obim-" 
-								+ to_string((*obim_it).first) + "-im-" + to_string(i) 
-								+ "-apal-" + to_string(j) + ".bmp");
-							++results.graphics_ripped;
-						}
+						write_multipalette_image(bmp, lflfc, fprefix + "-obim-" 
+							+ to_string((*obim_it).first) + "-im-" + to_string(i),
+							transind, results);
 					}
 				}
 			}
@@ -1068,51 +2039,68 @@ void HERip::rip_akos(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 		const AKOSChunk& akosc = lflfc.akos_chunks[i];
 		AKOSComponentContainer akos_components;
 
+		begin_catalog_asset("akos", i, akosc);
+		add_catalog_name("SP2C", akosc.file_date);
+		add_catalog_name("SPLF", akosc.file_name);
+		add_catalog_name("CLRS", akosc.file_compr);
+		if (catalog)
+		{
+			std::vector<std::string> seqi_names;
+			for (std::vector<SEQIChunk>::size_type j = 0;
+				j < akosc.sqdb_chunk.seqi_chunks.size(); j++)
+				seqi_names.push_back(akosc.sqdb_chunk.seqi_chunks[j].name_val);
+			add_catalog_names("SEQI", seqi_names);
+		}
+
 		// if sequence ripping is enabled, we have to decode the AKOSes first
 		if (akosrip || sequencerip)
 		{
+			// adjust parameters based on chunk properties and user settings
+
+			// is a REMP chunk present?
+			bool has_remap_chunk = (lflfc.remp_chunk.type == remp);
+
+			// use local palette if enabled and existent,
+			// OR if the palette is full (implying a remap)
+			bool use_local_palette = (ripset.localpalettes && akosc.palette.size())
+				|| (ripset.palettenum == RipperFormats::RipConsts::not_set
+				&& !ripset.localpalettes && akosc.palette.size() == 256);
+
+			// should the local colormap be used?
+			// with the local palette, only if it is full and there is no remap chunk
+			bool use_colormap = !use_local_palette
+				|| (akosc.palette.size() == 256 && !has_remap_chunk);
+
+			// the color translation is the same for every image in the AKOS
+			AKOSColorLUTs luts(akosc, lflfc.trns_chunk.trns_val, transind,
+				akosc.colormap, use_colormap,
+				lflfc.remp_chunk.colormap, has_remap_chunk);
 
 			for (std::vector<AKOFEntry>::size_type j = 0; j < akosc.akof_entries.size(); j++)
 			{
 				BitmapData bmp;
+				BitmapData trimmed;
 
 				// pointer to ripping palette
 				const RipUtil::BitmapPalette* ripping_palette;
 
-				// is a REMP chunk present?
-				bool has_remap_chunk = (lflfc.remp_chunk.type == remp);
-
-				// should the local colormap be used?
-				bool use_colormap = true;
-
 				// base name of the file to output
 				std::string outfile_base;
 				outfile_base += fprefix + "-akos-" + to_string(i) + "-im-"
 					+ to_string(j);
 
-				// adjust parameters based on chunk properties and user settings
-
-				// use local palette if enabled and existent,
-				// OR if the palette is full (implying a remap)
-				if ((ripset.localpalettes && akosc.palette.size())
-					|| (ripset.palettenum == RipperFormats::RipConsts::not_set
-					&& !ripset.localpalettes && akosc.palette.size() == 256))
+				if (use_local_palette)
 				{
 					ripping_palette = &(akosc.palette);
 
-					// only use the colormap if the local palette is full and there
-					// is no remap chunk
-					use_colormap = (akosc.palette.size() == 256 && !has_remap_chunk);
-
-					decode_akos(akosc, bmp, j, *ripping_palette,
-						lflfc.trns_chunk.trns_val, transind,
-						akosc.colormap, use_colormap,
-						lflfc.remp_chunk.colormap, has_remap_chunk);
+					decode_akos(akosc, bmp, j, *ripping_palette, transind, luts);
 
 					// don't write file if only sequence ripping is enabled
-					if (akosrip)
+					// or it's going on the atlas
+					if (akosrip && !atlas)
 					{
-						write_bitmapdata_8bitpalettized_bmp(bmp, outfile_base + ".bmp");
+						write_image(trim_image(bmp, trimmed, transind), outfile_base, transind);
+						++results.graphics_ripped;
 					}
 				}
 				// use user-specified room palette if enabled
@@ -1120,42 +2108,37 @@ void HERip::rip_akos(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 				{
 					ripping_palette = &(room_palettes[ripset.palettenum]);
 
-					decode_akos(akosc, bmp, j, *ripping_palette,
-						lflfc.trns_chunk.trns_val, transind,
-						akosc.colormap, use_colormap,
-						lflfc.remp_chunk.colormap, has_remap_chunk);
+					decode_akos(akosc, bmp, j, *ripping_palette, transind, luts);
 					
 					// don't write file if only sequence ripping is enabled
-					if (akosrip)
+					// or it's going on the atlas
+					if (akosrip && !atlas)
 					{
-						write_bitmapdata_8bitpalettized_bmp(bmp, outfile_base + ".bmp");
+						write_image(trim_image(bmp, trimmed, transind), outfile_base, transind);
+						++results.graphics_ripped;
 					}
 				}
 				// otherwise, use current room palette(s)
-				else
+				else if (lflfc.apals.size())
 				{
-					for (std::vector<BitmapPalette>::size_type k = 0;
-						k < lflfc.apals.size(); k++)
-					{
-						ripping_palette = &(lflfc.apals[k]);
+					// the palette doesn't affect the decoded pixels, so
+					// decode once and write with each palette
+					ripping_palette = &(lflfc.apals[0]);
 
-						// extend filename to include palette number if using
-						// multiple palettes for same image
-						if (lflfc.apals.size() > 1)
-						{
-							outfile_base += "-apal-" + to_string(k);
-						}
+					decode_akos(akosc, bmp, j, *ripping_palette, transind, luts);
 
-						decode_akos(akosc, bmp, j, *ripping_palette,
-							lflfc.trns_chunk.trns_val, transind,
-							akosc.colormap, use_colormap,
-							lflfc.remp_chunk.colormap, has_remap_chunk);
-						
-						// don't write file if only sequence ripping is enabled
-						if (akosrip)
-						{
-							write_bitmapdata_8bitpalettized_bmp(bmp, outfile_base + ".bmp");
-						}
+					// don't write file if only sequence ripping is enabled
+					// or it's going on the atlas
+					if (akosrip && !atlas && lflfc.apals.size() == 1)
+					{
+						write_image(trim_image(bmp, trimmed, transind), outfile_base, transind);
+						++results.graphics_ripped;
+					}
+					else if (akosrip && !atlas)
+					{
+						write_multipalette_image(trim_image(bmp, trimmed, transind),
+							lflfc, outfile_base,
+							transind, results);
 					}
 				}
 
@@ -1172,6 +2155,24 @@ void HERip::rip_akos(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 				// last one used will be saved
 				akos_components.push_back(bmp);
 			}
+
+			// the saved components are exactly the images of the AKOS
+			if (akosrip && atlas && akos_components.size())
+			{
+				std::vector<std::string> names;
+				for (AKOSComponentContainer::size_type j = 0;
+					j < akos_components.size(); j++)
+					names.push_back("im-" + to_string(j));
+
+				const BitmapPalette* palette = 0;
+				if (use_local_palette)
+					palette = &(akosc.palette);
+				else if (ripset.palettenum != RipperFormats::RipConsts::not_set)
+					palette = &(room_palettes[ripset.palettenum]);
+
+				write_atlas(akos_components, names, lflfc, palette,
+					fprefix + "-akos-" + to_string(i), transind, results);
+			}
 		}
 
 		// extract animation sequences
@@ -1235,23 +2236,31 @@ void HERip::rip_akos(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 //					seqbmp.set_palette(lflfc.apals[0]);
 
 					// blit each component to frame
+					DrawRect drawn = { 0, 0, 0, 0 };
 					for (AKSQStaticFrameComponentContainer::iterator cit = fit->components.begin();
 						cit != fit->components.end(); cit++)
 					{
-						seqbmp.blit_bitmapdata(akos_components[cit->graphic],
+						BitmapData& compbmp = akos_components[cit->graphic];
+						seqbmp.blit_bitmapdata(compbmp,
 							cit->xoffset + sizeinf.centerx,
 							cit->yoffset + sizeinf.centery,
 							lflfc.trns_chunk.trns_val);
 
+						DrawRect comprect = { cit->xoffset + sizeinf.centerx,
+							cit->yoffset + sizeinf.centery,
+							compbmp.get_width(), compbmp.get_height() };
+						drawn = enclose_rects(drawn, comprect);
+
 						// mark component as used
 						usedgraphics[cit->graphic] = true;
 					}
 
 					// write out frame
-					write_bitmapdata_8bitpalettized_bmp(seqbmp, fprefix + "-akos-"
+					BitmapData trimmed;
+					write_image(trim_image(seqbmp, trimmed, lflfc.trns_chunk.trns_val, drawn),
+						fprefix + "-akos-"
 						+ to_string(i) + "-sequence-" + to_string(seqnum)
-						+ "-frame-" + to_string(fit->framenum)
-						+ ".bmp");
+						+ "-frame-" + to_string(fit->framenum), transind);
 
 					++results.animation_frames_ripped;
 				}
@@ -1289,17 +2298,22 @@ void HERip::rip_akos(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 						compbmp.blit_bitmapdata(akos_components[cit->graphic],
 							cit->xoffset + sizeinf.centerx,
 							cit->yoffset + sizeinf.centery);
+						DrawRect drawn = { cit->xoffset + sizeinf.centerx,
+							cit->yoffset + sizeinf.centery,
+							akos_components[cit->graphic].get_width(),
+							akos_components[cit->graphic].get_height() };
 
 						// mark component as used
 						usedgraphics[cit->graphic] = true;
 
 						// write out frame
-						write_bitmapdata_8bitpalettized_bmp(compbmp, fprefix + "-akos-"
+						BitmapData trimmed;
+						write_image(trim_image(compbmp, trimmed, lflfc.trns_chunk.trns_val, drawn),
+							fprefix + "-akos-"
 							+ to_string(i) + "-sequence-" + to_string(seqnum)
 							+ "-frame-" + to_string(fit->framenum)
 							+ "-component-" + /*to_string(cit->compid)*/ to_string(componentnum)
-							+ "-id-" + to_string(cit->compid)
-							+ ".bmp");
+							+ "-id-" + to_string(cit->compid), transind);
 
 						++componentnum;
 					}
@@ -1347,6 +2361,10 @@ void HERip::rip_akos(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 
 			bmp.clear(lflfc.trns_chunk.trns_val);
 
+			// frames are drawn over the ones before them, so everything
+			// drawn so far can show
+			DrawRect drawn = { 0, 0, 0, 0 };
+
 			for (std::vector<AUXDChunk>::size_type j = 0; 
 				j < akaxc.auxd_chunks.size(); j++)
 			{
@@ -1355,10 +2373,16 @@ void HERip::rip_akos(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 				{
 					decode_auxd(auxdc, bmp, lflfc.trns_chunk.trns_val, transind);
 
-					write_bitmapdata_8bitpalettized_bmp(bmp, fprefix
+					const AXFDChunk& axfdc = auxdc.axfd_chunk;
+					DrawRect framerect = { axfdc.off1 + 320, axfdc.off2 + 240,
+						axfdc.width, axfdc.height };
+					drawn = enclose_rects(drawn, framerect);
+
+					BitmapData trimmed;
+					write_image(trim_image(bmp, trimmed, lflfc.trns_chunk.trns_val, drawn),
+						fprefix
 						+ "-akos-" + to_string(i)
-						+ "-auxd-" + to_string(j)
-						+ ".bmp");
+						+ "-auxd-" + to_string(j), transind);
 
 					++results.animation_frames_ripped;
 				}
@@ -1372,17 +2396,23 @@ void HERip::rip_awiz(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 {
 	// rewrite these to call a common function
 
+	// images colored with the room palette(s), when building an atlas
+	std::vector<BitmapData> atlas_images;
+	std::vector<std::string> atlas_names;
+
 	// rip regular AWIZ
 	for (std::vector<AWIZChunk>::size_type i = 0;
 		i < lflfc.awiz_chunks.size(); i++)
 	{
 		const AWIZChunk& awizc = lflfc.awiz_chunks[i];
+		begin_catalog_asset("awiz", i, awizc);
 
 		// some games have "empty" AWIZs just to make us mad
 		if (awizc.wizd_chunk.type == wizd)
 		{
 
 			BitmapData bmp;
+			BitmapData trimmed;
 
 			// use local palette if enabled and existent,
 			// OR if the palette is full (implying a remap)
@@ -1392,8 +2422,8 @@ void HERip::rip_awiz(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 			{
 				decode_awiz(awizc, bmp, awizc.palette,
 					lflfc.trns_chunk.trns_val, transind, awizc.rmap_chunk.colormap, awizc.rmap_chunk.type == rmap);
-				bmp.write(fprefix
-					+ "-awiz-" + to_string(i) + ".bmp");
+				write_image(trim_image(bmp, trimmed, transind), fprefix
+					+ "-awiz-" + to_string(i), transind);
 				++results.graphics_ripped;
 			}
 			// use user-specified room palette if enabled
@@ -1401,30 +2431,50 @@ void HERip::rip_awiz(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 			{
 				decode_awiz(awizc, bmp, room_palettes[ripset.palettenum],
 					lflfc.trns_chunk.trns_val, transind);
-				bmp.write(fprefix
-					+ "-awiz-" + to_string(i) + ".bmp");
-				++results.graphics_ripped;
+				if (atlas && bmp.get_palettized())
+				{
+					atlas_images.push_back(bmp);
+					atlas_names.push_back("awiz-" + to_string(i));
+				}
+				else
+				{
+					write_image(trim_image(bmp, trimmed, transind), fprefix
+						+ "-awiz-" + to_string(i), transind);
+					++results.graphics_ripped;
+				}
 			}
 			// otherwise, use room palette(s)
 			else if (lflfc.apals.size() == 1)
 			{
 				decode_awiz(awizc, bmp, lflfc.apals[0],
 					lflfc.trns_chunk.trns_val, transind);
-				bmp.write(fprefix
-					+ "-awiz-" + to_string(i) + ".bmp");
-				++results.graphics_ripped;
+				if (atlas && bmp.get_palettized())
+				{
+					atlas_images.push_back(bmp);
+					atlas_names.push_back("awiz-" + to_string(i));
+				}
+				else
+				{
+					write_image(trim_image(bmp, trimmed, transind), fprefix
+						+ "-awiz-" + to_string(i), transind);
+					++results.graphics_ripped;
+				}
 			}
 			else if (lflfc.apals.size())
 			{
-				for (std::vector<BitmapPalette>::size_type j = 0;
-					j < lflfc.apals.size(); j++)
+				// only the palette differs, so decode once
+				decode_awiz(awizc, bmp, lflfc.apals[0],
+					lflfc.trns_chunk.trns_val, transind);
+				if (atlas && bmp.get_palettized())
 				{
-					decode_awiz(awizc, bmp, lflfc.apals[j],
-						lflfc.trns_chunk.trns_val, transind);
-					bmp.write(fprefix
-						+ "-awiz-" + to_string(i) 
-						+ "-apal-" + to_string(j) + ".bmp");
-					++results.graphics_ripped;
+					atlas_images.push_back(bmp);
+					atlas_names.push_back("awiz-" + to_string(i));
+				}
+				else
+				{
+					write_multipalette_image(trim_image(bmp, trimmed, transind),
+						lflfc, fprefix
+						+ "-awiz-" + to_string(i), transind, results);
 				}
 			}
 		}
@@ -1440,11 +2490,13 @@ void HERip::rip_awiz(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 			j < multc.awiz_chunks.size(); j++)
 		{
 			const AWIZChunk& awizc = multc.awiz_chunks[j];
+			begin_catalog_asset("mult", i, awizc);
 
 			if (awizc.wizd_chunk.type == wizd)
 			{
 
 				BitmapData bmp;
+				BitmapData trimmed;
 
 				// use local palette if enabled and existent
 				// OR if the palette is full (implying a remap)
@@ -1455,9 +2507,9 @@ void HERip::rip_awiz(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 					decode_awiz(awizc, bmp, awizc.palette,
 						lflfc.trns_chunk.trns_val, transind,
 						awizc.rmap_chunk.colormap, awizc.rmap_chunk.type == rmap);
-					bmp.write(fprefix
+					write_image(trim_image(bmp, trimmed, transind), fprefix
 						+ "-mult-" + to_string(i)
-						+ "-awiz-" + to_string(j) + ".bmp");
+						+ "-awiz-" + to_string(j), transind);
 					++results.graphics_ripped;
 				}
 				// use user-specified room palette if enabled
@@ -1466,10 +2518,19 @@ void HERip::rip_awiz(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 					decode_awiz(awizc, bmp, room_palettes[ripset.palettenum],
 						lflfc.trns_chunk.trns_val, transind,
 						multc.defa_chunk.rmap_chunk.colormap, multc.defa_chunk.rmap_chunk.type == rmap);
-					bmp.write(fprefix
-						+ "-mult-" + to_string(i)
-						+ "-awiz-" + to_string(j) + ".bmp");
-					++results.graphics_ripped;
+					if (atlas && bmp.get_palettized())
+					{
+						atlas_images.push_back(bmp);
+						atlas_names.push_back("mult-" + to_string(i)
+							+ "-awiz-" + to_string(j));
+					}
+					else
+					{
+						write_image(trim_image(bmp, trimmed, transind), fprefix
+							+ "-mult-" + to_string(i)
+							+ "-awiz-" + to_string(j), transind);
+						++results.graphics_ripped;
+					}
 				}
 				// otherwise, use MULT palette if it exists
 				else if (ripset.localpalettes && multc.defa_chunk.palette.size())
@@ -1477,9 +2538,9 @@ void HERip::rip_awiz(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 					decode_awiz(awizc, bmp, multc.defa_chunk.palette,
 						lflfc.trns_chunk.trns_val, transind,
 						multc.defa_chunk.rmap_chunk.colormap, multc.defa_chunk.rmap_chunk.type == rmap);
-					bmp.write(fprefix
+					write_image(trim_image(bmp, trimmed, transind), fprefix
 						+ "-mult-" + to_string(i)
-						+ "-awiz-" + to_string(j) + ".bmp");
+						+ "-awiz-" + to_string(j), transind);
 					++results.graphics_ripped;
 				}
 				// otherwise, use room palette(s)
@@ -1488,29 +2549,53 @@ void HERip::rip_awiz(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 					decode_awiz(awizc, bmp, lflfc.apals[0],
 						lflfc.trns_chunk.trns_val, transind,
 						multc.defa_chunk.rmap_chunk.colormap, multc.defa_chunk.rmap_chunk.colormap.size() != 0);
-					bmp.write(fprefix
-						+ "-mult-" + to_string(i)
-						+ "-awiz-" + to_string(j) + ".bmp");
-					++results.graphics_ripped;
+					if (atlas && bmp.get_palettized())
+					{
+						atlas_images.push_back(bmp);
+						atlas_names.push_back("mult-" + to_string(i)
+							+ "-awiz-" + to_string(j));
+					}
+					else
+					{
+						write_image(trim_image(bmp, trimmed, transind), fprefix
+							+ "-mult-" + to_string(i)
+							+ "-awiz-" + to_string(j), transind);
+						++results.graphics_ripped;
+					}
 				}
 				else if (lflfc.apals.size() != 0)
 				{
-					for (std::vector<BitmapPalette>::size_type k = 0;
-						k < lflfc.apals.size(); k++)
+					decode_awiz(awizc, bmp, lflfc.apals[0],
+						lflfc.trns_chunk.trns_val, transind,
+						multc.defa_chunk.rmap_chunk.colormap, multc.defa_chunk.rmap_chunk.colormap.size() != 0);
+					if (atlas && bmp.get_palettized())
 					{
-						decode_awiz(awizc, bmp, lflfc.apals[k],
-							lflfc.trns_chunk.trns_val, transind,
-							multc.defa_chunk.rmap_chunk.colormap, multc.defa_chunk.rmap_chunk.colormap.size() != 0);
-						bmp.write(fprefix
+						atlas_images.push_back(bmp);
+						atlas_names.push_back("mult-" + to_string(i)
+							+ "-awiz-" + to_string(j));
+					}
+					else
+					{
+						write_multipalette_image(trim_image(bmp, trimmed, transind),
+							lflfc, fprefix
 							+ "-mult-" + to_string(i)
-							+ "-awiz-" + to_string(j) 
-							+ "-apal-" + to_string(k) + ".bmp");
-						++results.graphics_ripped;
+							+ "-awiz-" + to_string(j), transind, results);
 					}
 				}
 			}
 		}
 	}
+
+	if (atlas_images.size())
+	{
+		const BitmapPalette* palette = 0;
+		if (ripset.palettenum != RipperFormats::RipConsts::not_set)
+			palette = &(room_palettes[ripset.palettenum]);
+
+		begin_catalog_asset("atlas", -1, lflfc);
+		write_atlas(atlas_images, atlas_names, lflfc, palette,
+			fprefix + "-awiz", transind, results);
+	}
 }
 
 void HERip::rip_char(const LFLFChunk& lflfc, const RipperFormats::RipperSettings& ripset,
@@ -1531,6 +2616,41 @@ void HERip::rip_char(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 		i < lflfc.char_chunks.size(); i++)
 	{
 		const CHARChunk& charc = lflfc.char_chunks[i];
+		begin_catalog_asset("char", i, charc);
+		if (charsheet)
+		{
+			// one image for the whole font, plus a table of where each
+			// glyph is and how it's positioned
+			BitmapData sheet;
+			std::vector<CHARSheetEntry> entries;
+			decode_char_sheet(charc, sheet, entries, 256, testpal,
+				lflfc.trns_chunk.trns_val, transind);
+			write_image(sheet, fprefix
+				+ "-char-" + to_string(i)
+				+ "-sheet", transind);
+
+			std::ostringstream ofs;
+			ofs << "compr: " << charc.compr << '\n';
+			ofs << "rowspace: " << charc.rowspace << '\n';
+			ofs << "glyphs: " << entries.size() << '\n';
+			ofs << "char" << '\t' << "x" << '\t' << "y" << '\t' << "width" << '\t'
+				<< "height" << '\t' << "off1" << '\t' << "off2" << '\n';
+			for (std::vector<CHARSheetEntry>::size_type j = 0;
+				j < entries.size(); j++)
+			{
+				const CHARSheetEntry& entry = entries[j];
+				ofs << entry.charnum << '\t' << entry.x << '\t' << entry.y << '\t'
+					<< entry.width << '\t' << entry.height << '\t'
+					<< entry.off1 << '\t' << entry.off2 << '\n';
+			}
+			write_file(fprefix
+				+ "-char-" + to_string(i)
+				+ "-sheet.txt", ofs.str());
+
+			++results.graphics_ripped;
+			continue;
+		}
+
 		for (std::vector<CHAREntry>::size_type j = 0;
 			j < charc.char_entries.size(); j++)
 		{
@@ -1538,10 +2658,9 @@ void HERip::rip_char(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 			BitmapData bmp;
 			decode_char(bmp, chare, charc.compr, testpal,
 				lflfc.trns_chunk.trns_val, transind);
-			write_bitmapdata_8bitpalettized_bmp(bmp, fprefix
+			write_image(bmp, fprefix
 				+ "-char-" + to_string(i)
-				+ "-num-" + to_string(j)
-				+ ".bmp");
+				+ "-num-" + to_string(j), transind);
 			++results.graphics_ripped;
 		}
 	}
@@ -1555,15 +2674,14 @@ void HERip::rip_sound(std::vector<SoundChunk>& sound_chunks,
 		i < sound_chunks.size(); i++)
 	{
 		SoundChunk& soundc = sound_chunks[i];
+		begin_catalog_asset(soundc.type == talk ? "talk" : "digi", i, soundc);
 
 		if (ripset.normalize)
 			soundc.wave.normalize();
 
-		write_pcmdata_wave(soundc.wave, fprefix
+		write_wave(soundc.wave, fprefix
 			+ to_string(i)
-			+ ".wav",
-			ripset.ignorebytes,
-			ripset.ignoreend);
+			+ ".wav", ripset);
 
 		++results.audio_ripped;
 	}
@@ -1577,13 +2695,13 @@ void HERip::rip_wsou(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 		i < lflfc.wsou_chunks.size(); i++)
 	{
 		const RIFFEntry& riff_entry = lflfc.wsou_chunks[i].riff_entry;
+		begin_catalog_asset("wsou", i, lflfc.wsou_chunks[i]);
 
 		if (!decode_audio)
 		{
-			std::ofstream ofs((fprefix
+			write_file(fprefix
 				+ "-wsou-" + to_string(i)
-				+ ".wav").c_str(), std::ios_base::binary);
-			ofs.write(riff_entry.riffdat, riff_entry.riffdat_size);
+				+ ".wav", riff_entry.riffdat, riff_entry.riffdat_size);
 		}
 		else
 		{
@@ -1593,11 +2711,9 @@ void HERip::rip_wsou(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 				wave);
 			if (ripset.normalize)
 				wave.normalize();
-			write_pcmdata_wave(wave, fprefix
+			write_wave(wave, fprefix
 				+ "-wsou-" + to_string(i)
-				+ ".wav",
-				ripset.ignorebytes,
-				ripset.ignoreend);
+				+ ".wav", ripset);
 		}
 
 		++results.audio_ripped;
@@ -1607,14 +2723,7 @@ void HERip::rip_wsou(const LFLFChunk& lflfc, const RipperFormats::RipperSettings
 void HERip::rip_tlke(LFLFChunk& lflfc, const RipperFormats::RipperSettings& ripset,
 	const std::string& filename, int rmnum, RipperFormats::RipResults& results)
 {
-	// only create the TLKE file if there are TLKEs to rip
-	if (!cleared_tlke_file)
-	{
-		std::ofstream(filename.c_str(), std::ios_base::trunc);
-		cleared_tlke_file = true;
-	}
-
-	std::ofstream ofs(filename.c_str(), std::ios_base::app);
+	std::ostringstream ofs;
 
 	ofs << "room " << rmnum << '\n';
 	for (std::vector<TLKEChunk>::size_type i = 0;
@@ -1624,18 +2733,27 @@ void HERip::rip_tlke(LFLFChunk& lflfc, const RipperFormats::RipperSettings& rips
 		++results.strings_ripped;
 	}
 	ofs << '\n';
+	append_file(filename, ofs.str());
 }
 
 void HERip::rip_scripts(LFLFChunk& lflfc, const RipperFormats::RipperSettings& ripset,
 	const std::string& filename, int rmnum, RipperFormats::RipResults& results)
 {
+	// each script is a file of its own unless they're concatenated or packed
+	std::string scriptprefix;
+	if (!catscripts && !packscripts && (lflfc.scrp_chunks.size()
+		|| lflfc.lscr_chunks.size() || lflfc.lsc2_chunks.size()))
+		scriptprefix = room_prefix(filename, rmnum, "scripts");
+
 	// SCRPs
 	for (int i = 0; i < lflfc.scrp_chunks.size(); i++) {
 		SputmChunk& scrpc = lflfc.scrp_chunks[i];
+		begin_catalog_asset("scrp", i, scrpc);
 		
-		if (catscripts) {
-			std::ofstream ofs((filename + "-scripts").c_str(),
-				std::ios_base::app | std::ios_base::binary);
+		if (packscripts)
+			scriptpack.add(rmnum, "SCRP", i, scrpc.data, scrpc.datasize);
+		else if (catscripts) {
+			std::ostringstream ofs;
 
 			ofs << std::string("<--SCRIPT ")
 				+ to_string(rmnum)
@@ -1646,22 +2764,23 @@ void HERip::rip_scripts(LFLFChunk& lflfc, const RipperFormats::RipperSettings& r
 				+ to_string(rmnum)
 				+ "-" + to_string(i)
 				+ " END-->";
+			append_file(filename + "-scripts", ofs.str());
 		}
 		else {
-			std::ofstream ofs((filename
-				+ "-room-" + to_string(rmnum)
-				+ "-scrp-" + to_string(i)).c_str(), std::ios_base::binary);
-			ofs.write(scrpc.data, scrpc.datasize);
+			write_file(scriptprefix
+				+ "-scrp-" + to_string(i), scrpc.data, scrpc.datasize);
 		}
 	}
 
 	// LSCRs
 	for (int i = 0; i < lflfc.lscr_chunks.size(); i++) {
 		SputmChunk& lscrc = lflfc.lscr_chunks[i];
+		begin_catalog_asset("lscr", i, lscrc);
 		
-		if (catscripts) {
-			std::ofstream ofs((filename + "-scripts").c_str(),
-				std::ios_base::app | std::ios_base::binary);
+		if (packscripts)
+			scriptpack.add(rmnum, "LSCR", i, lscrc.data, lscrc.datasize);
+		else if (catscripts) {
+			std::ostringstream ofs;
 
 			ofs << std::string("<--SCRIPT ")
 				+ to_string(rmnum)
@@ -1672,22 +2791,23 @@ void HERip::rip_scripts(LFLFChunk& lflfc, const RipperFormats::RipperSettings& r
 				+ to_string(rmnum)
 				+ "-" + to_string(i)
 				+ " END-->";
+			append_file(filename + "-scripts", ofs.str());
 		}
 		else {
-			std::ofstream ofs((filename
-				+ "-room-" + to_string(rmnum)
-				+ "-lscr-" + to_string(i)).c_str(), std::ios_base::binary);
-			ofs.write(lscrc.data, lscrc.datasize);
+			write_file(scriptprefix
+				+ "-lscr-" + to_string(i), lscrc.data, lscrc.datasize);
 		}
 	}
 
 	// LSC2s
 	for (int i = 0; i < lflfc.lsc2_chunks.size(); i++) {
 		SputmChunk& lsc2c = lflfc.lsc2_chunks[i];
+		begin_catalog_asset("lsc2", i, lsc2c);
 		
-		if (catscripts) {
-			std::ofstream ofs((filename + "-scripts").c_str(),
-				std::ios_base::app | std::ios_base::binary);
+		if (packscripts)
+			scriptpack.add(rmnum, "LSC2", i, lsc2c.data, lsc2c.datasize);
+		else if (catscripts) {
+			std::ostringstream ofs;
 
 			ofs << std::string("<--SCRIPT ")
 				+ to_string(rmnum)
@@ -1698,12 +2818,11 @@ void HERip::rip_scripts(LFLFChunk& lflfc, const RipperFormats::RipperSettings& r
 				+ to_string(rmnum)
 				+ "-" + to_string(i)
 				+ " END-->";
+			append_file(filename + "-scripts", ofs.str());
 		}
 		else {
-			std::ofstream ofs((filename
-				+ "-room-" + to_string(rmnum)
-				+ "-lsc2-" + to_string(i)).c_str(), std::ios_base::binary);
-			ofs.write(lsc2c.data, lsc2c.datasize);
+			write_file(scriptprefix
+				+ "-lsc2-" + to_string(i), lsc2c.data, lsc2c.datasize);
 		}
 	}
 }
@@ -1711,7 +2830,7 @@ void HERip::rip_scripts(LFLFChunk& lflfc, const RipperFormats::RipperSettings& r
 void HERip::rip_metadata(const LFLFChunk& lflfc, const RipperFormats::RipperSettings& ripset,
 	const std::string& filename, int rmnum, RipperFormats::RipResults& results)
 {
-	std::ofstream ofs(filename.c_str(), std::ios_base::app);
+	std::ostringstream ofs;
 	ofs << "room " << rmnum << '\n';
 	
 	ofs << '\t' << "TRNS: " << lflfc.trns_chunk.trns_val << '\n';
@@ -1768,6 +2887,7 @@ void HERip::rip_metadata(const LFLFChunk& lflfc, const RipperFormats::RipperSett
 	}
 
 	ofs << '\n';
+	append_file(filename, ofs.str());
 }
 
 void HERip::scan_palettes(RipUtil::MembufStream& stream)
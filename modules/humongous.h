@@ -3,12 +3,19 @@
    Responsible for detecting valid formats and initiating ripping */
 
 #include "humongous_structs.h"
+#include "humongous_manifest.h"
 
 #include "RipModule.h"
 #include "../utils/MembufStream.h"
 #include "../utils/BitmapData.h"
+#include "../utils/PNGWriter.h"
+#include "../utils/OutputSink.h"
+#include "../utils/ArchiveSink.h"
+#include "../utils/ScriptPack.h"
+#include "../utils/ErrorLog.h"
 #include "../RipperFormats.h"
 #include <map>
+#include <set>
 #include <vector>
 
 namespace Humongous
@@ -30,9 +37,16 @@ public:
 		digirip(true), talkrip(true), wsourip(true), extdmurip(true), tlkerip(true),
 		scriptrip(false), metadatarip(true),
 		alttrans(false), transcol(not_set),
-		catscripts(false),
-		disablelog(false),
-		cleared_tlke_file(false) { };
+		catscripts(false), packscripts(false), charsheet(false), separatepalettes(false), atlas(false),
+		trim(false),
+		imageformat(image_bmp),
+		dedup(false), dedupmode(RipUtil::DedupSink::dedup_link),
+		archive(archive_none), layout(layout_flat), make_output_dirs(false),
+		asyncwrite(true), writequeue_mb(64),
+		incremental(false), nowrite(false), nowrite_hash(false), room_threads(1),
+		catalog(false), catalog_lflf(0),
+		output(0), recorder(0),
+		disablelog(false) { };
 
 	bool can_rip(RipUtil::MembufStream& stream, const RipperFormats::RipperSettings& ripset,
 		RipperFormats::FileFormatData& fmtdat);
@@ -64,6 +78,29 @@ public:
 		const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat,
 		RipperFormats::RipResults& results);
 
+	// rip one room, with stream at its LFLF, leaving stream after it. If
+	// incremental, the room is noted in manifestroom, and skip is set if it
+	// hasn't changed since the last rip (only the text rippers then run)
+	void rip_room(RipUtil::MembufStream& stream, const std::string& fprefix,
+		const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat,
+		int rmnum, int lecfend, const RipManifest& oldmanifest,
+		ManifestRoom& manifestroom, bool& skip, RipperFormats::RipResults& results);
+
+	// rip the rooms at offsets (with the given sizes), numbered from
+	// firstroom, on room_threads threads, with the same results as ripping
+	// them in turn
+	void rip_rooms_parallel(RipUtil::MembufStream& stream, const std::string& fprefix,
+		const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat,
+		const std::vector<int>& offsets, const std::vector<int>& sizes, int firstroom,
+		int lecfend, const RipManifest& oldmanifest, RipManifest& manifest,
+		int& rooms_skipped, RipperFormats::RipResults& results);
+
+	// rip the images, sounds and external DMUs of a room, which each go
+	// to their own files
+	void rip_room_files(LFLFChunk& lflfc, const std::string& fprefix,
+		const RipperFormats::RipperSettings& ripset, const RipperFormats::FileFormatData& fmtdat,
+		int rmnum, RipperFormats::RipResults& results);
+
 	void rip_extdmu(const LFLFChunk& lflfc, const std::string& fprefix, 
 		const RipperFormats::RipperSettings& ripset, 
 		const RipperFormats::FileFormatData& fmtdat, 
@@ -156,15 +193,212 @@ private:
 	int transcol;		// internal transparency index
 
 	bool catscripts;	// when dumping scripts, concatenate to single file
+	bool packscripts;	// when dumping scripts, put them in an indexed container
+	RipUtil::ScriptPackWriter scriptpack;	// scripts to be written, if packing
 
-	bool disablelog;
+	bool charsheet;		// rip each CHAR as a single sheet plus metrics
+
+	bool separatepalettes;	// write images once and room palettes separately
+							// instead of once per palette
+
+	bool atlas;		// pack AKOS and AWIZ images onto sheets
+
+	bool trim;		// cut sprites down to their non-transparent pixels
+
+	// images of the current room written with separate palettes
+	std::vector<std::string> palette_manifest;
+
+	enum ImageFormat
+	{
+		image_bmp,
+		image_png
+	};
+
+	ImageFormat imageformat;			// format graphics are written in
+	RipUtil::PNGSettings pngsettings;
+
+	bool dedup;		// write repeated files only once?
+	RipUtil::DedupSink::Mode dedupmode;
+	std::string hashstore;		// file remembering output across runs
+
+	enum ArchiveFormat
+	{
+		archive_none,
+		archive_tar,
+		archive_zip
+	};
+
+	ArchiveFormat archive;		// write all output into one archive?
+
+	enum OutputLayout
+	{
+		layout_flat,		// every file next to the output prefix
+		layout_tree			// files in a directory per room and type
+	};
+
+	OutputLayout layout;
+	bool make_output_dirs;		// are the files going to disk?
+	std::set<std::string> output_dirs;	// made so far, with the tree layout
+
+	bool asyncwrite;		// write files on a separate thread?
+	int writequeue_mb;		// max megabytes waiting to be written
 
-	bool cleared_tlke_file;
+	bool incremental;		// skip rooms unchanged since the last rip?
+
+	bool nowrite;			// decode everything, but discard the output?
+	bool nowrite_hash;		// hash the discarded output?
+
+	int room_threads;		// rooms ripped at once (1 = in turn)
+
+	// A room ripped on a pool thread by its own copy of the ripper, which
+	// keeps the room's files and log messages until it's the room's turn
+	// to pass them on. The room is ripped from the hack state before, a
+	// guess at the state the rooms ahead of it will leave; the guess only
+	// matters if the room used the hacks
+	struct RoomJob
+	{
+		RoomJob()
+			: rmnum(0), offset(0), size(0), hacks_used(false), ripper(0),
+			skip(false) { };
+		~RoomJob() { delete ripper; }
+
+		int rmnum;
+		int offset;
+		int size;
+		DecodingHackState before;
+		DecodingHackState after;
+		bool hacks_used;
+		HERip* ripper;
+		RipUtil::BufferSink files;
+		ErrLog::LogCapture log;
+		ManifestRoom manifestroom;
+		bool skip;
+		RipperFormats::RipResults results;
+
+	private:
+		RoomJob(const RoomJob&);
+		RoomJob& operator=(const RoomJob&);
+	};
+
+	// runs RoomJobs on a pool, handing each room on as soon as the rooms
+	// before it have been
+	struct RoomJobRunner;
+	// what the rooms of a window handed on so far have left behind
+	struct RoomHandoff;
+
+	// get job ready to be run (again) with a fresh copy of this ripper
+	void prepare_room_job(RoomJob& job);
+
+	// pass a finished job's files, log messages and results on, ripping
+	// the room again first if it used the hacks from the wrong state
+	void hand_on_room(RoomJob& job, const RoomJobRunner& runner, RoomHandoff& handoff);
+
+	bool catalog;			// write a JSON Lines record of every asset?
+	std::string catalog_file;
+
+	// the asset being ripped, for the catalog
+	struct CatalogAsset
+	{
+		CatalogAsset()
+			: room(-1), index(-1), offset(0), size(0) { };
+
+		std::string type;
+		int room;			// -1 if not from a room
+		int index;			// -1 if there's only one
+		int offset;			// source chunk in the datafile
+		int size;
+		std::string fields;	// names from the datafile, as JSON members
+	};
+
+	CatalogAsset catalog_asset;
+	std::string catalog_trim;	// where the image being written was trimmed from
+	const LFLFChunk* catalog_lflf;	// room being ripped, for palette numbers
+	std::string catalog_records;	// not yet written to the catalog
+
+	RipUtil::OutputSink* output;	// where finished files go during a rip
+	RipUtil::RecordingSink* recorder;	// notes the files of each room, if incremental
+
+	bool disablelog;
 
 	std::vector<RipUtil::BitmapPalette> room_palettes;
 
 	void check_params(const RipperFormats::RipperSettings& ripset);
 
+	// the command line options that affect what is ripped, for the manifest
+	std::string get_output_settings(const RipperFormats::RipperSettings& ripset);
+
+	// The prefix for files of one type: fprefix, or with the tree layout,
+	// fprefix/subdir/ followed by the name of fprefix, so that the files
+	// have the same names either way. The directory is made the first time
+	// it's asked for
+	std::string output_prefix(const std::string& fprefix, const std::string& subdir);
+
+	// the prefix for files of one type from a room: fprefix-room-n, or
+	// with the tree layout, the same in fprefix/room-n/type/
+	std::string room_prefix(const std::string& fprefix, int rmnum,
+		const std::string& type);
+
+	// start the catalog records of an asset
+	void begin_catalog_asset(const std::string& type, int index, int offset, int size);
+	void begin_catalog_asset(const std::string& type, int index,
+		const SputmChunkHead& chunk);
+
+	// add names from the datafile to the records of the current asset
+	void add_catalog_name(const std::string& key, const std::string& name);
+	void add_catalog_names(const std::string& key, const std::vector<std::string>& names);
+
+	// add a record for an output file of the current asset; details are
+	// more JSON members, each starting with a comma
+	void add_catalog_record(const std::string& path, const std::string& details);
+
+	// append the records so far to the catalog file
+	void flush_catalog();
+
+	// With --trim, the part of bmp within drawn (all of it by default) that
+	// isn't bgcolor, copied into trimmed if that's smaller than bmp. Returns
+	// the image to write, and notes the trim for the catalog
+	RipUtil::BitmapData& trim_image(RipUtil::BitmapData& bmp, RipUtil::BitmapData& trimmed,
+		int bgcolor, const RipUtil::DrawRect& drawn);
+	RipUtil::BitmapData& trim_image(RipUtil::BitmapData& bmp, RipUtil::BitmapData& trimmed,
+		int bgcolor);
+
+	// write an image in the selected format, adding the extension to
+	// outfile_base; transind is the background color of the image
+	// returns the name of the file written
+	std::string write_image(RipUtil::BitmapData& bmp, const std::string& outfile_base,
+		int transind);
+
+	// write audio as a WAVE file, applying the sample trimming settings
+	void write_wave(RipUtil::PCMData& wave, const std::string& filename,
+		const RipperFormats::RipperSettings& ripset);
+
+	// write a file copied as-is from the input
+	void write_file(const std::string& filename, const char* data, int size);
+
+	// write a file built in memory, such as a text file
+	void write_file(const std::string& filename, const std::string& contents);
+
+	// add to the end of a file built up over the rip, such as the metadata
+	void append_file(const std::string& filename, const std::string& contents);
+
+	// write an image that can be shown with any of the room's palettes:
+	// once per palette, or once with the first palette (and a manifest entry)
+	// if palettes are separated
+	void write_multipalette_image(RipUtil::BitmapData& bmp, const LFLFChunk& lflfc,
+		const std::string& outfile_base, int transind, RipperFormats::RipResults& results);
+
+	// pack images onto one sheet, written as outfile_base-atlas with a table
+	// (outfile_base-atlas.txt) of where each of names went. The sheet is
+	// colored with palette, or the room palette(s) if palette is null
+	void write_atlas(std::vector<RipUtil::BitmapData>& images,
+		const std::vector<std::string>& names, const LFLFChunk& lflfc,
+		const RipUtil::BitmapPalette* palette, const std::string& outfile_base,
+		int transind, RipperFormats::RipResults& results);
+
+	// write each of the room's palettes and the manifest of images that use
+	// them, then clear the manifest
+	void write_room_palettes(const LFLFChunk& lflfc, const std::string& fprefix);
+
 	// disable all rip settings
 	void disable_all_ripping();
 
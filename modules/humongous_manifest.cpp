@@ -0,0 +1,204 @@
+#include "humongous_manifest.h"
+#include "humongous_rip.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <filesystem>
+
+namespace Humongous
+{
+
+
+DecodingHackState::DecodingHackState()
+{
+	for (int i = 0; i < num_values; i++)
+		values[i] = 0;
+}
+
+void DecodingHackState::capture()
+{
+	values[0] = rle_encoding_method_hack;
+	values[1] = rle_encoding_method_hack_images_to_test;
+	values[2] = rle_encoding_method_hack_lined_images;
+	values[3] = rle_encoding_method_hack_unlined_images;
+	values[4] = akos_2color_decoding_hack;
+	values[5] = akos_2color_decoding_hack_images_to_test;
+	values[6] = akos_2color_decoding_hack_rle_images;
+	values[7] = akos_2color_decoding_hack_bitmap_images;
+}
+
+void DecodingHackState::restore() const
+{
+	rle_encoding_method_hack = (RLEEncodingMethodHackValue)values[0];
+	rle_encoding_method_hack_images_to_test = values[1];
+	rle_encoding_method_hack_lined_images = values[2];
+	rle_encoding_method_hack_unlined_images = values[3];
+	akos_2color_decoding_hack = (AKOS2ColorDecodingHackValue)values[4];
+	akos_2color_decoding_hack_images_to_test = values[5];
+	akos_2color_decoding_hack_rle_images = values[6];
+	akos_2color_decoding_hack_bitmap_images = values[7];
+}
+
+bool DecodingHackState::operator==(const DecodingHackState& other) const
+{
+	for (int i = 0; i < num_values; i++)
+	{
+		if (values[i] != other.values[i])
+			return false;
+	}
+	return true;
+}
+
+
+namespace
+{
+
+const char* manifest_magic = "heerip-manifest 1";
+
+void write_hack_state(std::ostream& ofs, const char* key,
+	const DecodingHackState& state)
+{
+	ofs << key;
+	for (int i = 0; i < DecodingHackState::num_values; i++)
+		ofs << ' ' << state.values[i];
+	ofs << '\n';
+}
+
+bool read_hack_state(std::istream& iss, DecodingHackState& state)
+{
+	for (int i = 0; i < DecodingHackState::num_values; i++)
+		iss >> state.values[i];
+	return !iss.fail();
+}
+
+};
+
+// Format, one item per line:
+//   heerip-manifest 1
+//   settings <options>
+// then for each room:
+//   room <number> <offset> <size> <hash>
+//   before <hack state>
+//   after <hack state>
+// followed by its outputs, tab-indented:
+//   <hash> <size> <filename>
+// and its catalog records (with --catalog):
+//   catalog <record>
+// hashes are in hex; filenames run to the end of the line
+
+bool RipManifest::read(const std::string& filename)
+{
+	std::ifstream ifs(filename.c_str());
+	std::string line;
+	if (!std::getline(ifs, line) || line != manifest_magic)
+		return false;
+
+	rooms.clear();
+	ManifestRoom* room = 0;
+	while (std::getline(ifs, line))
+	{
+		std::istringstream iss(line);
+		if (line.size() && line[0] == '\t')
+		{
+			RipUtil::RecordingSink::Record record;
+			if (!room || !(iss >> std::hex >> record.hash >> std::dec >> record.size))
+				return false;
+			iss >> std::ws;
+			std::getline(iss, record.filename);
+			room->outputs.push_back(record);
+			continue;
+		}
+
+		std::string key;
+		iss >> key;
+		if (key == "settings")
+		{
+			iss.get();
+			std::getline(iss, settings);
+		}
+		else if (key == "room")
+		{
+			int rmnum;
+			ManifestRoom newroom;
+			if (!(iss >> rmnum >> newroom.offset >> newroom.size
+				>> std::hex >> newroom.hash))
+				return false;
+			room = &(rooms[rmnum] = newroom);
+		}
+		else if (key == "catalog")
+		{
+			std::string record;
+			iss.get();
+			std::getline(iss, record);
+			if (!room)
+				return false;
+			room->catalog += record + '\n';
+		}
+		else if (key == "before" || key == "after")
+		{
+			if (!room || !read_hack_state(iss,
+				key == "before" ? room->before : room->after))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void RipManifest::write(const std::string& filename) const
+{
+	std::ofstream ofs(filename.c_str(), std::ios_base::trunc);
+	char hash[17];
+
+	ofs << manifest_magic << '\n';
+	ofs << "settings " << settings << '\n';
+	for (std::map<int, ManifestRoom>::const_iterator it = rooms.begin();
+		it != rooms.end(); ++it)
+	{
+		const ManifestRoom& room = (*it).second;
+		std::sprintf(hash, "%016llx", room.hash);
+		ofs << "room " << (*it).first << ' ' << room.offset << ' '
+			<< room.size << ' ' << hash << '\n';
+		write_hack_state(ofs, "before", room.before);
+		write_hack_state(ofs, "after", room.after);
+		for (std::vector<RipUtil::RecordingSink::Record>::const_iterator out_it
+			= room.outputs.begin(); out_it != room.outputs.end(); ++out_it)
+		{
+			std::sprintf(hash, "%016llx", (*out_it).hash);
+			ofs << '\t' << hash << ' ' << (*out_it).size << ' '
+				<< (*out_it).filename << '\n';
+		}
+
+		std::istringstream records(room.catalog);
+		std::string record;
+		while (std::getline(records, record))
+			ofs << "catalog " << record << '\n';
+	}
+}
+
+bool RipManifest::room_unchanged(int rmnum, const ManifestRoom& room) const
+{
+	std::map<int, ManifestRoom>::const_iterator it = rooms.find(rmnum);
+	if (it == rooms.end())
+		return false;
+
+	const ManifestRoom& recorded = (*it).second;
+	if (recorded.offset != room.offset || recorded.size != room.size
+		|| recorded.hash != room.hash || recorded.before != room.before)
+		return false;
+
+	for (std::vector<RipUtil::RecordingSink::Record>::const_iterator out_it
+		= recorded.outputs.begin(); out_it != recorded.outputs.end(); ++out_it)
+	{
+		std::error_code ec;
+		std::uintmax_t size = std::filesystem::file_size((*out_it).filename, ec);
+		if (ec || (long long)size != (*out_it).size)
+			return false;
+	}
+
+	return true;
+}
+
+
+};	// end of namespace Humongous
@@ -0,0 +1,64 @@
+/* Record of what a rip produced from each room, so that a later rip with
+   the same settings can skip the rooms that haven't changed */
+
+#include "../utils/OutputSink.h"
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Humongous
+{
+
+
+// The state of the RLE and AKOS 2-color encoding detection hacks (see
+// humongous_rip.h). Decoding a room can change it, so a room can only be
+// skipped if the hacks are where they were when it was last ripped
+struct DecodingHackState
+{
+	DecodingHackState();
+
+	// copy from/to the hack variables of the calling thread
+	void capture();
+	void restore() const;
+
+	bool operator==(const DecodingHackState& other) const;
+	bool operator!=(const DecodingHackState& other) const
+		{ return !(*this == other); }
+
+	const static int num_values = 8;
+	int values[num_values];
+};
+
+struct ManifestRoom
+{
+	ManifestRoom()
+		: offset(0), size(0), hash(0) { };
+
+	int offset;				// LFLF position and size in the datafile
+	int size;
+	unsigned long long hash;	// XXH64 of the (decoded) LFLF
+	DecodingHackState before;
+	DecodingHackState after;
+	std::vector<RipUtil::RecordingSink::Record> outputs;
+	std::string catalog;	// the room's catalog records, one per line
+};
+
+struct RipManifest
+{
+	// returns false if the file doesn't exist or isn't a manifest
+	bool read(const std::string& filename);
+	void write(const std::string& filename) const;
+
+	// true if room matches the recorded room rmnum in position, size, hash
+	// and hack state, and every file recorded for it is still there at its
+	// recorded size
+	bool room_unchanged(int rmnum, const ManifestRoom& room) const;
+
+	std::string settings;	// options the outputs depend on
+	std::map<int, ManifestRoom> rooms;
+};
+
+
+};	// end of namespace Humongous
+
+#pragma once
\ No newline at end of file
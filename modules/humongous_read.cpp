@@ -2,7 +2,6 @@
 #include "humongous_read.h"
 
 #include "../utils/MembufStream.h"
-#include "../utils/BitStream.h"
 #include "../utils/BitmapData.h"
 #include "../utils/PCMData.h"
 #include "../utils/datmanip.h"
@@ -1654,6 +1653,7 @@ void read_char(RipUtil::MembufStream& stream, std::vector<CHARChunk>& chars)
 
 	int numentries = stream.read_int(2, DatManip::le);
 	std::vector<int> offentries;
+	std::vector<int> charnums;
 	for (int i = 0; i < numentries; i++)
 	{
 		stream.seekg(datastart + (i + 1) * 4);
@@ -1662,6 +1662,7 @@ void read_char(RipUtil::MembufStream& stream, std::vector<CHARChunk>& chars)
 		if (offset != 0)
 		{
 			offentries.push_back(offset);
+			charnums.push_back(i);
 		}
 	}
 
@@ -1673,6 +1674,7 @@ void read_char(RipUtil::MembufStream& stream, std::vector<CHARChunk>& chars)
 
 		CHAREntry entry;
 
+		entry.charnum = charnums[i];
 		entry.width = stream.read_int(1);
 		entry.height = stream.read_int(1);
 		entry.off1 = stream.read_int(1);
@@ -2,9 +2,10 @@
 #include "humongous_rip.h"
 
 #include "../utils/MembufStream.h"
-#include "../utils/BitStream.h"
+#include "../utils/BitReader.h"
 #include "../utils/BitmapData.h"
 #include "../utils/PCMData.h"
+#include "../utils/ThreadPool.h"
 #include "../utils/datmanip.h"
 #include "../utils/ErrorLog.h"
 #include "../utils/logger.h"
@@ -15,6 +16,12 @@
 #include <cstring>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace RipUtil;
 using namespace RipperFormats;
@@ -29,21 +36,319 @@ namespace Humongous
 // between 3DO and later games
 // in 3DO, this is an unlined data format; in later games, it is lined
 // we test the first n such images decoded and remember the results for later entries
-RLEEncodingMethodHackValue rle_encoding_method_hack = rle_hack_is_not_set;
-int rle_encoding_method_hack_images_to_test = 10;
-int rle_encoding_method_hack_lined_images = 0;
-int rle_encoding_method_hack_unlined_images = 0;
+thread_local RLEEncodingMethodHackValue rle_encoding_method_hack = rle_hack_is_not_set;
+thread_local int rle_encoding_method_hack_images_to_test = 10;
+thread_local int rle_encoding_method_hack_lined_images = 0;
+thread_local int rle_encoding_method_hack_unlined_images = 0;
 bool rle_encoding_method_hack_was_user_overriden = false;
 
 // similarly, for handling nominally 2-color AKOS
-AKOS2ColorDecodingHackValue akos_2color_decoding_hack = akos_2color_hack_is_not_set;
-int akos_2color_decoding_hack_images_to_test = 10;
-int akos_2color_decoding_hack_rle_images = 0;
-int akos_2color_decoding_hack_bitmap_images = 0;
+thread_local AKOS2ColorDecodingHackValue akos_2color_decoding_hack = akos_2color_hack_is_not_set;
+thread_local int akos_2color_decoding_hack_images_to_test = 10;
+thread_local int akos_2color_decoding_hack_rle_images = 0;
+thread_local int akos_2color_decoding_hack_bitmap_images = 0;
 bool akos_2color_decoding_hack_was_user_overriden = false;
 
+thread_local bool decoding_hacks_used = false;
+
+int smap_decoding_threads = 1;
+
+void reset_decoding_settings()
+{
+	rle_encoding_method_hack = rle_hack_is_not_set;
+	rle_encoding_method_hack_images_to_test = 10;
+	rle_encoding_method_hack_lined_images = 0;
+	rle_encoding_method_hack_unlined_images = 0;
+	rle_encoding_method_hack_was_user_overriden = false;
+
+	akos_2color_decoding_hack = akos_2color_hack_is_not_set;
+	akos_2color_decoding_hack_images_to_test = 10;
+	akos_2color_decoding_hack_rle_images = 0;
+	akos_2color_decoding_hack_bitmap_images = 0;
+	akos_2color_decoding_hack_was_user_overriden = false;
+
+	decoding_hacks_used = false;
+
+	smap_decoding_threads = 1;
+}
+
+bool decoding_hacks_settled()
+{
+	return (rle_encoding_method_hack_was_user_overriden
+			|| !rle_encoding_method_hack_images_to_test)
+		&& (akos_2color_decoding_hack_was_user_overriden
+			|| !akos_2color_decoding_hack_images_to_test);
+}
+
 // misc stuff
 
+// Pixel writers for the low-level decoders. Each one walks a box within
+// a bitmap in drawing order (rows for RowWriter, columns for ColWriter),
+// so drawing a pixel is a store and a counter update rather than a
+// draw_row_wrap/draw_col_wrap call with its bounds checks.
+// Anything drawn after the box is filled is discarded.
+
+class RowWriter
+{
+public:
+	RowWriter(RipUtil::BitmapData& bmap, int x, int y, int w, int h)
+		: line(bmap.get_pixels() + x + y * bmap.get_width()),
+		stride(bmap.get_width()), boxw(w), currx(0), linesleft(h)
+	{
+		if (x < 0 || y < 0 || w <= 0)
+			linesleft = 0;
+	}
+
+	bool done() const { return linesleft <= 0; }
+
+	void put(int color)
+	{
+		if (linesleft <= 0)
+			return;
+		line[currx] = color;
+		if (++currx == boxw)
+			next_line();
+	}
+
+	void put(int color, int count)
+	{
+		while (count > 0 && linesleft > 0)
+		{
+			int drawcount = std::min(count, boxw - currx);
+			fill_pixels(line + currx, color, drawcount);
+			currx += drawcount;
+			count -= drawcount;
+			if (currx == boxw)
+				next_line();
+		}
+	}
+
+	// draw count 8-bit pixels from src
+	template <bool translate>
+	void copy(const unsigned char* src, int count, const ColorLUT& lut)
+	{
+		while (count > 0 && linesleft > 0)
+		{
+			int drawcount = std::min(count, boxw - currx);
+			if (translate)
+				copy_pixels(line + currx, src, drawcount, lut.table);
+			else
+				copy_pixels(line + currx, src, drawcount);
+			src += drawcount;
+			currx += drawcount;
+			count -= drawcount;
+			if (currx == boxw)
+				next_line();
+		}
+	}
+
+private:
+	void next_line()
+	{
+		currx = 0;
+		line += stride;
+		--linesleft;
+	}
+
+	int* line;
+	int stride;
+	int boxw;
+	int currx;
+	int linesleft;
+};
+
+// ColWriter doesn't draw into the bitmap directly: writing down a column
+// touches a new row of the bitmap with every pixel. Instead it draws a band
+// of columns at a time into a column-major scratch tile, which is then
+// transposed into the bitmap in blocks. If preserve is set, each band of the
+// tile starts out as a copy of the bitmap, for decoders that skip() over
+// pixels. flush() must be called once drawing is finished
+class ColWriter
+{
+public:
+	ColWriter(RipUtil::BitmapData& bmap, int x, int y, int w, int h, bool preserve)
+		: bmap(bmap), tile(std::max(0, std::min(w, static_cast<int>(bandcols)) * h)),
+		boxx(x), boxy(y), boxw(w), boxh(h), preserve(preserve),
+		bandx(0), bandw(0), pos(0), bandend(0)
+	{
+		if (x < 0 || y < 0 || w <= 0 || h <= 0)
+			return;
+
+		start_band();
+	}
+
+	bool done() const { return bandend == 0; }
+
+	void put(int color)
+	{
+		if (pos >= bandend)
+			return;
+		tile[pos++] = color;
+		if (pos == bandend)
+			next_band();
+	}
+
+	void put(int color, int count)
+	{
+		// the common case: the run ends within the band
+		if (count < bandend - pos)
+		{
+			int* putpos = &tile[pos];
+			for (int i = 0; i < count; i++)
+				putpos[i] = color;
+			pos += count;
+			return;
+		}
+
+		while (count > 0 && pos < bandend)
+		{
+			int drawcount = std::min(count, bandend - pos);
+			std::fill(&tile[pos], &tile[pos] + drawcount, color);
+			pos += drawcount;
+			count -= drawcount;
+			if (pos == bandend)
+				next_band();
+		}
+	}
+
+	// advance the draw position without drawing anything
+	void skip(int count)
+	{
+		if (count < bandend - pos)
+		{
+			pos += count;
+			return;
+		}
+
+		while (count > 0 && pos < bandend)
+		{
+			int skipcount = std::min(count, bandend - pos);
+			pos += skipcount;
+			count -= skipcount;
+			if (pos == bandend)
+				next_band();
+		}
+	}
+
+	// copy whatever part of the current band has been drawn into the bitmap
+	void flush()
+	{
+		if (pos >= bandend)
+			return;
+
+		int cols = pos / boxh;
+		if (preserve)
+			cols = bandw;
+		else
+		{
+			int* putpos = bmap.get_pixels() + boxx + bandx + cols
+				+ boxy * bmap.get_width();
+			for (int i = 0; i < pos % boxh; i++)
+				putpos[i * bmap.get_width()] = tile[cols * boxh + i];
+		}
+		if (cols)
+			bmap.put_columns(&tile[0], boxx + bandx, boxy, cols, boxh);
+		bandend = 0;
+	}
+
+private:
+	const static int bandcols = 16;
+
+	void start_band()
+	{
+		bandw = std::min(boxw - bandx, static_cast<int>(bandcols));
+		bandend = bandw * boxh;
+		pos = 0;
+		if (preserve)
+			bmap.get_columns(&tile[0], boxx + bandx, boxy, bandw, boxh);
+	}
+
+	void next_band()
+	{
+		bmap.put_columns(&tile[0], boxx + bandx, boxy, bandw, boxh);
+		bandx += bandw;
+		if (bandx < boxw)
+			start_band();
+		else
+			bandend = 0;
+	}
+
+	RipUtil::BitmapData& bmap;
+	RipUtil::PixelBuffer tile;
+	int boxx;
+	int boxy;
+	int boxw;
+	int boxh;
+	bool preserve;
+	int bandx;
+	int bandw;
+	int pos;
+	int bandend;
+};
+
+ColorLUT::ColorLUT()
+	: identity(true)
+{
+	for (int i = 0; i < 256; i++)
+		table[i] = i;
+}
+
+ColorLUT::ColorLUT(const ColorMap& colormap, bool deindex, const ColorMap& colorremap,
+	bool remap, bool trans, int localtransind, int transind)
+	: identity(true)
+{
+	for (int i = 0; i < 256; i++)
+	{
+		int color = i;
+		if (deindex && color < (int)colormap.size())
+			color = colormap[color];
+		if (remap && color >= 0 && color < (int)colorremap.size())
+			color = colorremap[color];
+		if (trans && color == localtransind)
+			color = transind;
+		table[i] = color;
+		if (color != i)
+			identity = false;
+	}
+}
+
+AKOSColorLUTs::AKOSColorLUTs(const AKOSChunk& akosc, int localtransind, int transind,
+	const ColorMap& colormap, bool deindex, const ColorMap& colorremap, bool remap)
+{
+	if (akosc.numcolors == 2)
+	{
+		rle = ColorLUT(dummy_colormap, false, dummy_colormap, false,
+			true, akosc.akpl_chunk.alttrans, transind);
+		bitstream = ColorLUT(dummy_colormap, false, colorremap, remap,
+			true, akosc.akpl_chunk.alttrans, transind);
+	}
+	else
+	{
+		multicomp = ColorLUT(colormap, deindex, colorremap, remap,
+			false, localtransind, transind);
+	}
+}
+
+const ColorLUT identity_lut;
+
+// kernels are instantiated with translate = false for identity tables,
+// which skips the lookup altogether
+template <bool translate>
+inline int translate_color(int color, const ColorLUT& lut)
+{
+	return translate ? lut[color] : color;
+}
+
+// draw count 8-bit pixels from src at column x of a row
+template <bool translate>
+inline void copy_span(BitmapRow& row, int x, const unsigned char* src, int count,
+	const ColorLUT& lut)
+{
+	if (translate)
+		row.copy(x, src, count, lut.table);
+	else
+		row.copy(x, src, count);
+}
 
 
 
@@ -80,6 +385,61 @@ void decode_bmap(const SputmChunk& bmapc, RipUtil::BitmapData& bmap, int width,
 		0, 0, width, height, localtransind, transind);
 }
 
+// decodes strip i of an SMAP whose strip encodings have already been read
+struct SMAPStripDecoder
+{
+	SMAPStripDecoder(const SputmChunk& smapc, RipUtil::BitmapData& bmap, int height,
+		int localtransind, int transind, const std::vector<int>& offsets,
+		const std::vector<BitmapEncoding>& encodings, const std::vector<char>& valid)
+		: smapc(smapc), bmap(bmap), height(height), localtransind(localtransind),
+		transind(transind), offsets(offsets), encodings(encodings), valid(valid) { };
+
+	void operator()(int i) const
+	{
+		if (valid[i])
+			decode_encoded_bitmap(smapc.data + offsets[i] + 1, encodings[i],
+				smapc.datasize - offsets[i], bmap, i * 8, 0, 8, height,
+				localtransind, transind);
+	}
+
+	const SputmChunk& smapc;
+	RipUtil::BitmapData& bmap;
+	int height;
+	int localtransind;
+	int transind;
+	const std::vector<int>& offsets;
+	const std::vector<BitmapEncoding>& encodings;
+	const std::vector<char>& valid;
+};
+
+// the pools SMAP strips are decoded on, one per thread count asked for.
+// A pool is never replaced once made, so a rip that changes -smapthreads
+// gets a pool of the new size without pulling one out from under a room
+// that is still decoding on the old one
+class SMAPThreadPools
+{
+public:
+	~SMAPThreadPools()
+	{
+		for (std::map<int, ThreadPool*>::iterator it = pools.begin();
+			it != pools.end(); ++it)
+			delete it->second;
+	}
+
+	ThreadPool& get(int numthreads)
+	{
+		std::lock_guard<std::mutex> lock(poolmutex);
+		ThreadPool*& pool = pools[numthreads];
+		if (!pool)
+			pool = new ThreadPool(numthreads);
+		return *pool;
+	}
+
+private:
+	std::mutex poolmutex;
+	std::map<int, ThreadPool*> pools;
+};
+
 void decode_smap(const SputmChunk& smapc, RipUtil::BitmapData& bmap, int width, int height,
 	int localtransind, int transind)
 {
@@ -89,21 +449,48 @@ void decode_smap(const SputmChunk& smapc, RipUtil::BitmapData& bmap, int width,
 	bmap.clear(transind);
 	int strips = width/8;
 	char* offset = smapc.data + 8;
+	int numthreads = smap_decoding_threads;
+
+	if (numthreads <= 1)
+	{
+		for (int i = 0; i < strips; i++)
+		{
+			int offset_int = to_int(offset, 4, DatManip::le);
+			int encoding = to_int(smapc.data + offset_int, 1);
+			decode_encoded_bitmap(smapc.data + offset_int + 1, encoding,
+				smapc.datasize - offset_int, bmap, i * 8, 0, 8, height,
+				localtransind, transind);
+			offset += 4;
+		}
+		return;
+	}
 
+	// read every strip's encoding first, in order, so that errors are logged
+	// and the RLE hack is updated exactly as in the serial case; the strips
+	// themselves cover disjoint columns and can then be decoded in any order
+	std::vector<BitmapEncoding> encodings(strips);
+	std::vector<int> offsets(strips);
+	std::vector<char> valid(strips);
 	for (int i = 0; i < strips; i++)
 	{
-		int offset_int = to_int(offset, 4, DatManip::le);
-		int encoding = to_int(smapc.data + offset_int, 1);
-		decode_encoded_bitmap(smapc.data + offset_int + 1, encoding,
-			smapc.datasize - offset_int, bmap, i * 8, 0, 8, height,
-			localtransind, transind);
+		offsets[i] = to_int(offset, 4, DatManip::le);
+		int encoding = to_int(smapc.data + offsets[i], 1);
+		valid[i] = read_bitmap_encoding(smapc.data + offsets[i] + 1, encoding,
+			smapc.datasize - offsets[i], encodings[i]);
 		offset += 4;
 	}
+
+	SMAPStripDecoder decoder(smapc, bmap, height, localtransind, transind,
+		offsets, encodings, valid);
+	static SMAPThreadPools pools;
+	pools.get(numthreads).parallel_for(strips, decoder);
 }
 
 void decode_bomp(const SputmChunk& bompc, RipUtil::BitmapData& bmap, int localtransind, 
-	int transind, ColorMap colormap, bool deindex)
+	int transind, const ColorMap& colormap, bool deindex)
 {
+	ColorLUT lut(colormap, deindex, dummy_colormap, false, false, localtransind, transind);
+
 	char* data = bompc.data + 8;
 	int unknown = to_int(data++, 1);
 	int bomptrans = to_int(data++, 1);
@@ -119,7 +506,7 @@ void decode_bomp(const SputmChunk& bompc, RipUtil::BitmapData& bmap, int localtr
 	bmap.resize_pixels(width, height, 8);
 	bmap.clear(transind);
 
-	int currx = 0;
+	BitmapRow row(bmap, 0, 0, width, height);
 	int curry = 0;
 
 	int pos = 0;
@@ -130,6 +517,8 @@ void decode_bomp(const SputmChunk& bompc, RipUtil::BitmapData& bmap, int localtr
 		int bytecount = to_int(data + next_pos, 2, DatManip::le);
 		pos = next_pos + 2;
 		next_pos += bytecount + 2;
+		row.set_row(curry);
+		int currx = 0;
 		while (pos < datlen && pos < next_pos)
 		{
 			int code = to_int(data + pos, 1);
@@ -141,31 +530,25 @@ void decode_bomp(const SputmChunk& bompc, RipUtil::BitmapData& bmap, int localtr
 				int color = to_int(data + pos, 1);
 				++pos;
 				if (color != bomptrans)
-				{
-					if (deindex)
-						color = colormap[color];
-					bmap.draw_row(color, count, currx, curry, 0, 0, width, height);
-				}
+					row.fill(currx, lut[color], count);
 				currx += count;
 			}
 			else				// absolute run
-			{
+			{					// transparent pixels are left alone
 				int count = (code >> 1) + 1;
-				for (int i = 0; i < count; i++)
+				int drawcount = row.clip(currx, std::min(count, datlen - pos));
+				const unsigned char* getpos
+					= reinterpret_cast<const unsigned char*>(data + pos);
+				int* putpos = row.at(currx);
+				for (int i = 0; i < drawcount; i++)
 				{
-					int color = to_int(data + pos, 1);
-					if (color != bomptrans)
-					{
-						if (deindex)
-							color = colormap[color];
-						bmap.draw_row(color, 1, currx, curry, 0, 0, width, height);
-					}
-					++pos;
-					++currx;
+					if (getpos[i] != bomptrans)
+						putpos[i] = lut[getpos[i]];
 				}
+				pos += count;
+				currx += count;
 			}
 		}
-		currx = 0;
 		++curry;
 	}
 }
@@ -179,11 +562,12 @@ void decode_bomp(const SputmChunk& bompc, RipUtil::BitmapData& bmap, int localtr
 
 // decode AKOS (any palette, any colormap, deindexed or indexed
 void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
-	int entrynum, RipUtil::BitmapPalette palette, int localtransind, int transind,
-	ColorMap colormap, bool deindex, ColorMap colorremap, bool remap)
+	int entrynum, const RipUtil::BitmapPalette& palette, int transind,
+	const AKOSColorLUTs& luts)
 {
-	bmap.resize_pixels(akosc.akcd_entries[entrynum].width, 
-		akosc.akcd_entries[entrynum].height, 8);
+	const AKCDEntry& akcde = akosc.akcd_entries[entrynum];
+
+	bmap.resize_pixels(akcde.width, akcde.height, 8);
 	bmap.set_palettized(true);
 	bmap.set_palette(palette);
 	bmap.clear(transind);
@@ -195,11 +579,12 @@ void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
 
 	if (akosc.numcolors == 2)
 	{
+		decoding_hacks_used = true;
+
 		if (!akos_2color_decoding_hack_was_user_overriden
 			&& akos_2color_decoding_hack_images_to_test)
 		{
-			if (is_lined_rle(akosc.akcd_entries[entrynum].imgdat,
-				akosc.akcd_entries[entrynum].size))
+			if (is_lined_rle(akcde.imgdat, akcde.size))
 			{
 				++akos_2color_decoding_hack_rle_images;
 			}
@@ -236,17 +621,16 @@ void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
 		}
 		if (akos_2color_decoding_hack == akos_2color_hack_always_use_rle)
 		{
-			decode_lined_rle(akosc.akcd_entries[entrynum].imgdat, akosc.akcd_entries[entrynum].size,
-				bmap, 0, 0, akosc.akcd_entries[entrynum].width, akosc.akcd_entries[entrynum].height,
-				akosc.akpl_chunk.alttrans, transind, true, dummy_colormap, false);
+			decode_lined_rle(akcde.imgdat, akcde.size, bmap, 0, 0,
+				akcde.width, akcde.height, luts.rle);
 		}
 		else if (akos_2color_decoding_hack == akos_2color_hack_always_use_bitmap)
 		{
-			int encoding = akosc.akcd_entries[entrynum].imgdat[0];
+			int encoding = akcde.imgdat[0];
 
 			// check if data is actually lined RLE before accepting encoding
 			if ((encoding != 8 
-				|| (encoding == 8 && is_lined_rle(akosc.akcd_entries[entrynum].imgdat, akosc.akcd_entries[entrynum].size)))
+				|| (encoding == 8 && is_lined_rle(akcde.imgdat, akcde.size)))
 				&& !akos_2color_decoding_hack_was_user_overriden)
 			{
 				logger.warning("guessed bitmap encoding for 2-color AKOS, but specified "
@@ -254,20 +638,16 @@ void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
 					"Image data will be treated as lined RLE instead; if problems result, "
 					"try using --force_akos2c_bitmap");
 
-				decode_lined_rle(akosc.akcd_entries[entrynum].imgdat, akosc.akcd_entries[entrynum].size,
-					bmap, 0, 0, akosc.akcd_entries[entrynum].width, akosc.akcd_entries[entrynum].height,
-					akosc.akpl_chunk.alttrans, transind, true, dummy_colormap, false);
+				decode_lined_rle(akcde.imgdat, akcde.size, bmap, 0, 0,
+					akcde.width, akcde.height, luts.rle);
 			}
 			else if (encoding == 8 || akos_2color_decoding_hack_was_user_overriden)
 			{
 				// all games seem to use an encoding of 0x8 with the semantics
 				// of encoding 0x58 + transparent color 0, possibly combined with an REMP
 				encoding = 0x58;
-				decode_bitstream_img(akosc.akcd_entries[entrynum].imgdat + 1,
-					akosc.akcd_entries[entrynum].size - 1, bmap, 0, 0,
-					akosc.akcd_entries[entrynum].width, akosc.akcd_entries[entrynum].height,
-					8, 3, true, true, false,
-					akosc.akpl_chunk.alttrans, transind, colorremap, remap);
+				decode_bitstream_img(akcde.imgdat + 1, akcde.size - 1, bmap, 0, 0,
+					akcde.width, akcde.height, 8, 3, true, false, luts.bitstream);
 			}
 			else
 			{
@@ -278,22 +658,30 @@ void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
 	}
 	else
 	{
-		decode_multicomp_rle(akosc.akcd_entries[entrynum].imgdat, akosc.akcd_entries[entrynum].width,
-			akosc.akcd_entries[entrynum].height, bmap, palette, akosc.numcolors, localtransind, transind,
-			colormap, deindex, colorremap, remap);
+		decode_multicomp_rle(akcde.imgdat, akcde.width, akcde.height, bmap,
+			akosc.numcolors, luts.multicomp);
 	}
 }
 
 void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
-	int entrynum, RipUtil::BitmapPalette palette, int localtransind, int transind)
+	int entrynum, const RipUtil::BitmapPalette& palette, int localtransind, int transind,
+	const ColorMap& colormap, bool deindex, const ColorMap& colorremap, bool remap)
+{
+	decode_akos(akosc, bmap, entrynum, palette, transind,
+		AKOSColorLUTs(akosc, localtransind, transind,
+			colormap, deindex, colorremap, remap));
+}
+
+void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
+	int entrynum, const RipUtil::BitmapPalette& palette, int localtransind, int transind)
 {
 	decode_akos(akosc, bmap, entrynum, palette, localtransind, transind,
 		dummy_colormap, false, dummy_colormap, false);
 }
 
 void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
-	int entrynum, RipUtil::BitmapPalette palette, int localtransind, int transind,
-	ColorMap colormap, bool deindex)
+	int entrynum, const RipUtil::BitmapPalette& palette, int localtransind, int transind,
+	const ColorMap& colormap, bool deindex)
 {
 	decode_akos(akosc, bmap, entrynum, palette, localtransind, transind,
 		colormap, deindex, dummy_colormap, false);
@@ -990,11 +1378,12 @@ SequenceSizingInfo compute_sequence_enclosing_dimensions(
 
 
 void decode_awiz(const AWIZChunk& awizc, RipUtil::BitmapData& bmap, 
-	RipUtil::BitmapPalette palette, int localtransind, int transind,
-	ColorMap colormap, bool deindex)
+	const RipUtil::BitmapPalette& palette, int localtransind, int transind,
+	const ColorMap& colormap, bool deindex)
 {
+	// the uncompressed and 16bpp images cover every pixel, so only the RLE
+	// images need to be cleared first
 	bmap.resize_pixels(awizc.width, awizc.height, 8);
-	bmap.clear(transind);
 	bmap.set_palettized(true);
 	bmap.set_palette(palette);
 
@@ -1014,62 +1403,101 @@ void decode_awiz(const AWIZChunk& awizc, RipUtil::BitmapData& bmap,
 		bmap.set_palettized(false);
 		bmap.set_bpp(24);
 
-		int* putpos = bmap.get_pixels();
-		int numbytes = (awizc.wizd_chunk.size - 8);
-		
-		for (int i = 0; i < numbytes; i += 2) {
-			int full = to_int(awizc.wizd_chunk.data + 8 + i, 2, DatManip::be);
-			*putpos++ = decode_type2_awiz_pixel(full);
-		}
+		decode_type2_awiz_pixels(awizc.wizd_chunk.data + 8, bmap.get_pixels(),
+			(awizc.wizd_chunk.size - 8) / 2);
 	}
 	else
 	{
+		bmap.clear(transind);
 		decode_lined_rle(awizc.wizd_chunk.data + 8, awizc.wizd_chunk.datasize, bmap, 
-			0, 0, awizc.width, awizc.height, localtransind, transind, true, colormap, 
-			deindex);
+			0, 0, awizc.width, awizc.height,
+			ColorLUT(colormap, deindex, dummy_colormap, false, true, localtransind, transind));
 	}
 }
 
 void decode_awiz(const AWIZChunk& awizc, RipUtil::BitmapData& bmap, 
-	RipUtil::BitmapPalette palette, int localtransind, int transind)
+	const RipUtil::BitmapPalette& palette, int localtransind, int transind)
 {
 	decode_awiz(awizc, bmap, palette, localtransind, transind, dummy_colormap, false);
 }
 
 
 
+// the pixels packed into each possible byte of n bpp CHAR data,
+// most significant bits first
+class CHARUnpackTable
+{
+public:
+	CHARUnpackTable(int bpp)
+		: pixels_per_byte(8 / bpp)
+	{
+		for (int i = 0; i < 256; i++)
+			for (int j = 0; j < pixels_per_byte; j++)
+				pixels[i][j] = (i >> (8 - bpp * (j + 1))) & ((1 << bpp) - 1);
+	}
+
+	const unsigned char* operator[](int byte) const { return pixels[byte]; }
+
+	int pixels_per_byte;
+
+private:
+	unsigned char pixels[256][8];
+};
+
+const CHARUnpackTable& get_char_unpack_table(int bpp)
+{
+	static const CHARUnpackTable tables[3] = {
+		CHARUnpackTable(1), CHARUnpackTable(2), CHARUnpackTable(4)
+	};
+	return tables[bpp == 1 ? 0 : (bpp == 2 ? 1 : 2)];
+}
+
+// unpack numpix pixels of 1, 2 or 4 bpp data a byte at a time;
+// color 0 is transparent, as are any pixels past the end of the data
+void unpack_char_pixels(const char* data, int datalen, int* dest, int numpix,
+	int bpp, int transind)
+{
+	const CHARUnpackTable& table = get_char_unpack_table(bpp);
+	const unsigned char* src = reinterpret_cast<const unsigned char*>(data);
+	int ppb = table.pixels_per_byte;
+
+	int numbytes = std::min(datalen, (numpix + ppb - 1) / ppb);
+	for (int i = 0; i < numbytes; i++)
+	{
+		const unsigned char* pix = table[src[i]];
+		int count = std::min(ppb, numpix);
+		for (int j = 0; j < count; j++)
+			dest[j] = pix[j] ? pix[j] : transind;
+		dest += count;
+		numpix -= count;
+	}
+	fill_pixels(dest, transind, numpix);
+}
+
 void decode_char(RipUtil::BitmapData& bmap, const CHAREntry& chare,
 	int compr, const RipUtil::BitmapPalette& palette, int localtransind,
-	int transind, ColorMap colormap, bool deindex)
+	int transind, const ColorMap& colormap, bool deindex)
 {
-	LRBitStream bits(chare.data, chare.datalen);
-
 	bmap.resize_pixels(chare.width, chare.height, 8);
 	bmap.set_palettized(true);
 	bmap.set_palette(palette);
-	bmap.clear(transind);
 
 	if (compr == 1 || compr == 2 || compr == 4)		// uncompressed bitmap, n bpp
 	{
-		int* pix = bmap.get_pixels();
-		int numpix = chare.width * chare.height;
-		for (int i = 0; i < numpix; i++)
-		{
-			int color = bits.get_nbit_int(compr);
-			if (color != 0)
-				*pix++ = color;
-			else
-				*pix++;
-		}
+		// covers every pixel, so there's no need to clear first
+		unpack_char_pixels(chare.data, chare.datalen, bmap.get_pixels(),
+			chare.width * chare.height, compr, transind);
 	}
 	else if (compr == 0 || compr == 8)				// lined RLE
 	{
+		bmap.clear(transind);
 		decode_lined_rle(chare.data, chare.datalen, bmap,
 			0, 0, chare.width, chare.height, localtransind, transind, true);
 	}
 	else
 	{
 		logger.error("\tunrecognized CHAR encoding " + to_string(compr));
+		bmap.clear(transind);
 	}
 }
 
@@ -1081,18 +1509,64 @@ void decode_char(RipUtil::BitmapData& bmap, const CHAREntry& chare,
 		transind, dummy_colormap, false);
 }
 
+void decode_char_sheet(const CHARChunk& charc, RipUtil::BitmapData& sheet,
+	std::vector<CHARSheetEntry>& entries, int sheetwidth,
+	const RipUtil::BitmapPalette& palette, int localtransind, int transind)
+{
+	entries.clear();
+
+	// lay out the glyphs first to find the size of the sheet
+	int width = 1;
+	int x = 0;
+	int y = 0;
+	int rowheight = 0;
+	for (std::vector<CHAREntry>::size_type i = 0;
+		i < charc.char_entries.size(); i++)
+	{
+		const CHAREntry& chare = charc.char_entries[i];
+		if (x > 0 && x + chare.width > sheetwidth)
+		{
+			x = 0;
+			y += rowheight + 1;
+			rowheight = 0;
+		}
+
+		CHARSheetEntry entry = { chare.charnum, x, y, chare.width, chare.height,
+			chare.off1, chare.off2 };
+		entries.push_back(entry);
+
+		x += chare.width + 1;
+		width = std::max(width, x - 1);
+		rowheight = std::max(rowheight, chare.height);
+	}
+
+	sheet.resize_pixels(width, std::max(1, y + rowheight), 8);
+	sheet.set_palettized(true);
+	sheet.set_palette(palette);
+	sheet.clear(transind);
+
+	BitmapData glyph;
+	for (std::vector<CHAREntry>::size_type i = 0;
+		i < charc.char_entries.size(); i++)
+	{
+		decode_char(glyph, charc.char_entries[i], charc.compr, palette,
+			localtransind, transind);
+		sheet.blit_bitmapdata(glyph, entries[i].x, entries[i].y);
+	}
+}
+
 
 
-void decode_encoded_bitmap(char* data, int encoding, int datlen, RipUtil::BitmapData& bmap,
-	int x, int y, int width, int height, int localtransind, int transind)
+bool read_bitmap_encoding(const char* data, int encoding, int datlen,
+	BitmapEncoding& enc)
 {
 	bool rle = false;		// uses RLE encoding?
 	bool horiz = false;		// draws horizontal or vertical?
 	bool trans = false;		// has transparency?
 	bool exprange = false;	// expanded range for 3-bit relative palette set?
 							// ([-4, -1] and [1, 4] instead of [-4, 3])
-	int bpabsol;			// bits per absolute palette set
-	int bprel;				// bits per relative palette set
+	int bpabsol = 0;		// bits per absolute palette set
+	int bprel = 0;			// bits per relative palette set
 
 	if (encoding == 1 || encoding == 149)	// uncompressed: 1 byte per pixel
 	{
@@ -1178,7 +1652,7 @@ void decode_encoded_bitmap(char* data, int encoding, int datlen, RipUtil::Bitmap
 		else
 		{
 			logger.error("\tunrecognized bitmap encoding " + to_string(encoding));
-			return;
+			return false;
 		}
 
 		bpabsol = encoding % 10;
@@ -1189,18 +1663,18 @@ void decode_encoded_bitmap(char* data, int encoding, int datlen, RipUtil::Bitmap
 			bprel = 3;
 	}
 
-	if (encoding == 1 || encoding == 149)			// uncompressed
-	{
-		decode_uncompressed_img(data, datlen, bmap, x, y, width, height, true, false, 
-			localtransind, transind);
-	}
-	else if (encoding == 143 || encoding == 150)	// solid fill (probably)
-	{
-		int fillcolor = to_int(data, 1);
-		bmap.clear(fillcolor);
-	}
-	else if (rle)			// RLE
+	enc.encoding = encoding;
+	enc.horiz = horiz;
+	enc.trans = trans;
+	enc.exprange = exprange;
+	enc.bpabsol = bpabsol;
+	enc.bprel = bprel;
+	enc.rlemethod = rle_hack_is_not_set;
+
+	if (rle)
 	{
+		decoding_hacks_used = true;
+
 		// see hack explanation at start of file
 		if (!rle_encoding_method_hack_was_user_overriden
 			&& rle_encoding_method_hack_images_to_test)
@@ -1237,10 +1711,41 @@ void decode_encoded_bitmap(char* data, int encoding, int datlen, RipUtil::Bitmap
 			rle_encoding_method_hack = newval;
 		}
 
-		if (rle_encoding_method_hack == rle_hack_always_use_lined)
+		enc.rlemethod = rle_encoding_method_hack;
+	}
+
+	return true;
+}
+
+void decode_encoded_bitmap(char* data, const BitmapEncoding& enc, int datlen,
+	RipUtil::BitmapData& bmap, int x, int y, int width, int height,
+	int localtransind, int transind)
+{
+	int encoding = enc.encoding;
+
+	if (encoding == 1 || encoding == 149)			// uncompressed
+	{
+		decode_uncompressed_img(data, datlen, bmap, x, y, width, height, true, false, 
+			localtransind, transind);
+	}
+	else if (encoding == 143 || encoding == 150)	// solid fill (probably)
+	{
+		// fill only this image's box: an SMAP strip must not wipe out its neighbors
+		int fillcolor = to_int(data, 1);
+		BitmapRow row(bmap, x, y, width, height);
+		for (int i = 0; i < height; i++)
+		{
+			if (row.set_row(i))
+				row.fill(0, fillcolor, width);
+		}
+	}
+	else if (encoding == 8 || encoding == 9)		// RLE
+	{
+		bool trans = enc.trans;
+		if (enc.rlemethod == rle_hack_always_use_lined)
 			decode_lined_rle(data, datlen, bmap, x, y, width, height,
 				localtransind, transind, trans);
-		else if (rle_encoding_method_hack == rle_hack_always_use_unlined)
+		else if (enc.rlemethod == rle_hack_always_use_unlined)
 			decode_unlined_rle(data, datlen, bmap, x, y, width, height, 
 				localtransind, transind, trans); 
 
@@ -1255,10 +1760,20 @@ void decode_encoded_bitmap(char* data, int encoding, int datlen, RipUtil::Bitmap
 	else					// bitstream
 	{
 		decode_bitstream_img(data, datlen, bmap, x, y, width, height,
-			bpabsol, bprel, horiz, trans, exprange, localtransind, transind);
+			enc.bpabsol, enc.bprel, enc.horiz, enc.trans, enc.exprange,
+			localtransind, transind);
 	}
 }
 
+void decode_encoded_bitmap(char* data, int encoding, int datlen, RipUtil::BitmapData& bmap,
+	int x, int y, int width, int height, int localtransind, int transind)
+{
+	BitmapEncoding enc;
+	if (read_bitmap_encoding(data, encoding, datlen, enc))
+		decode_encoded_bitmap(data, enc, datlen, bmap, x, y, width, height,
+			localtransind, transind);
+}
+
 void decode_unlined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 	int x, int y, int width, int height, int localtransind, int transind, bool trans)
 {
@@ -1266,123 +1781,128 @@ void decode_unlined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 		localtransind, transind, trans, dummy_colormap, false);
 }
 
-void decode_unlined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
-	int x, int y, int width, int height, int localtransind, int transind, bool trans,
-	ColorMap colormap, bool deindex)
+template <bool translate>
+void decode_unlined_rle_kernel(const char* data, RowWriter& out, const ColorLUT& lut)
 {
-	RipUtil::DrawPos pos = { 0, 0 };
-
-	const char* gpos = data;
-	while (pos.y < height)
+	const unsigned char* gpos = reinterpret_cast<const unsigned char*>(data);
+	while (!out.done())
 	{
-		unsigned char code = *gpos++;
-		unsigned int runlen = (code >> 1) + 1;
+		int code = *gpos++;
+		int runlen = (code >> 1) + 1;
 
 		if (code & 1)		// encoded run
 		{
-			unsigned int color = *gpos++;
-			if (deindex)
-				color = colormap[color];
-			if (trans && color == localtransind)
-				color = transind;
-			draw_and_update_pos(bmap, pos, color, runlen, x, y, width, height, true, false);
+			out.put(translate_color<translate>(*gpos++, lut), runlen);
 		}
 		else				// absolute run
 		{
-			for (unsigned int i = 0; i < runlen; i++)
-			{
-				unsigned int color = *gpos++;
-				if (deindex)
-					color = colormap[color];
-				if (trans && color == localtransind)
-					color = transind;
-				draw_and_update_pos(bmap, pos, color, 1, x, y, width, height, true, false);
-			}
+			out.copy<translate>(gpos, runlen, lut);
+			gpos += runlen;
 		}
 	}
 }
 
-void decode_multicomp_rle(const char* data, int width, int height, RipUtil::BitmapData& bmap,
-	RipUtil::BitmapPalette palette, int clrcmp, int localtransind, int transind, 
-	const ColorMap& colormap, bool deindex, const ColorMap& colorremap, bool remap)
+void decode_unlined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
+	int x, int y, int width, int height, int localtransind, int transind, bool trans,
+	const ColorMap& colormap, bool deindex)
+{
+	RowWriter out(bmap, x, y, width, height);
+	ColorLUT lut(colormap, deindex, dummy_colormap, false, trans, localtransind, transind);
+
+	if (lut.identity)
+		decode_unlined_rle_kernel<false>(data, out, lut);
+	else
+		decode_unlined_rle_kernel<true>(data, out, lut);
+}
+
+// 16/32/64-color AKOS: each byte holds a color in the top bits and a run length
+// in the bottom clrshift bits (0 = length in the next byte), drawn in columns
+template <int clrshift, bool translate>
+void decode_multicomp_rle_kernel(const char* data, int width, int height,
+	RipUtil::BitmapData& bmap, const ColorLUT& lut)
 {
-	if (clrcmp == 16 || clrcmp == 32 || clrcmp == 64)
+	const int runmask = (1 << clrshift) - 1;
+	const unsigned char* gpos = reinterpret_cast<const unsigned char*>(data);
+
+	// color 0 is transparent and skipped over
+	ColWriter out(bmap, 0, 0, width, height, true);
+	int totalpix = width * height;
+	int drawn = 0;
+	while (drawn < totalpix)
 	{
-		int clrmask;
-		int runmask;
-		int clrshift;
-		switch(clrcmp)
+		int code = *gpos++;
+		int color = code >> clrshift;
+		int runlen = code & runmask;
+		if (runlen == 0)
 		{
-		case 16:
-			clrmask = 0xF0;
-			runmask = 0xF;
-			clrshift = 4;
-			break;
-		case 32:
-			clrmask = 0xF8;
-			runmask = 0x7;
-			clrshift = 3;
-			break;
-		case 64:
-			clrmask = 0xFC;
-			runmask = 0x3;
-			clrshift = 2;
-			break;
+			runlen = *gpos++;
 		}
-		
-		int totalpix = width * height;
-		int drawn = 0;
-		int x = 0;
-		int y = 0;
-		while (drawn < totalpix)
+		if (color != 0)
 		{
-			int code = to_int(data++, 1);
-			int color = (code & clrmask) >> clrshift;
-			int runlen = code & runmask;
-			if (runlen == 0)
-			{
-				runlen = to_int(data++, 1);
-			}
-			if (color != 0)
-			{
-				// some games index into a reduced palette instead of the full
-				// 256 color range given in the palette index chunk
-				if (deindex)
-					color = colormap[color];
-				// some games additionally remap the deindexed colors into
-				// another index into the room palette
-				if (remap)
-					color = colorremap[color];
-				RipUtil::DrawPos result = bmap.draw_col_wrap(color, runlen, x, y);
-				x = result.x;
-				y = result.y;
-			}
-			else
-			{
-				y += runlen;
-				if (y >= height)
-				{
-					x += y/height;
-					y = y % height;
-				}
-			}
-			drawn += runlen;
-		} 
+			// some games index into a reduced palette instead of the full
+			// 256 color range given in the palette index chunk, and some
+			// additionally remap the deindexed colors into another index
+			// into the room palette
+			out.put(translate_color<translate>(color, lut), runlen);
+		}
+		else
+		{
+			out.skip(runlen);
+		}
+		drawn += runlen;
+	}
+	out.flush();
+}
+
+template <int clrshift>
+void dispatch_multicomp_rle(const char* data, int width, int height,
+	RipUtil::BitmapData& bmap, const ColorLUT& lut)
+{
+	if (lut.identity)
+		decode_multicomp_rle_kernel<clrshift, false>(data, width, height, bmap, lut);
+	else
+		decode_multicomp_rle_kernel<clrshift, true>(data, width, height, bmap, lut);
+}
+
+void decode_multicomp_rle(const char* data, int width, int height, RipUtil::BitmapData& bmap,
+	const RipUtil::BitmapPalette& palette, int clrcmp, int localtransind, int transind,
+	const ColorMap& colormap, bool deindex, const ColorMap& colorremap, bool remap)
+{
+	decode_multicomp_rle(data, width, height, bmap, clrcmp,
+		ColorLUT(colormap, deindex, colorremap, remap, false, localtransind, transind));
+}
+
+void decode_multicomp_rle(const char* data, int width, int height, RipUtil::BitmapData& bmap,
+	int clrcmp, const ColorLUT& lut)
+{
+	if (clrcmp == 16)
+	{
+		dispatch_multicomp_rle<4>(data, width, height, bmap, lut);
+	}
+	else if (clrcmp == 32)
+	{
+		dispatch_multicomp_rle<3>(data, width, height, bmap, lut);
+	}
+	else if (clrcmp == 64)
+	{
+		dispatch_multicomp_rle<2>(data, width, height, bmap, lut);
 	}
 	else if (clrcmp == 256)
 	{
-		int x = 0;
+		BitmapRow row(bmap, 0, 0, bmap.get_width(), bmap.get_height());
 		int y = 0;
 
-		const char* nextstart = data;
+		const unsigned char* nextstart = reinterpret_cast<const unsigned char*>(data);
 		while (y < height)
 		{
-			int bytecount = to_int(nextstart, 2, DatManip::le);
-			data = nextstart + 2;
+			int bytecount = nextstart[0] | (nextstart[1] << 8);
+			const unsigned char* gpos = nextstart + 2;
 			nextstart += bytecount + 2;
-			while (data < nextstart)
+			row.set_row(y);
+			int x = 0;
+			while (gpos < nextstart)
 			{
-				int code = to_int(data++, 1);
+				int code = *gpos++;
 				if (code & 1)		// skip count
 				{
 					x += (code >> 1);
@@ -1390,21 +1910,17 @@ void decode_multicomp_rle(const char* data, int width, int height, RipUtil::Bitm
 				else if (code & 2)	// encoded run
 				{
 					int count = (code >> 2) + 1;
-					int color = to_int(data++, 1);
-					bmap.draw_row(color, count, x, y);
+					row.fill(x, *gpos++, count);
 					x += count;
 				}
 				else				// absolute run
 				{
 					int count = (code >> 2) + 1;
-					for (int i = 0; i < count; i++)
-					{
-						bmap.draw_row(to_int(data++, 1), 1, x, y);
-						++x;
-					}
+					row.copy(x, gpos, count);
+					gpos += count;
+					x += count;
 				}
 			}
-			x = 0;
 			++y;
 		}
 	}
@@ -1417,21 +1933,18 @@ void decode_multicomp_rle(const char* data, int width, int height, RipUtil::Bitm
 void decode_uncompressed_img(char* data, int datlen, RipUtil::BitmapData& bmap, int x, int y,
 	int width, int height, bool horiz, bool trans, int localtransind, int transind)
 {
-	int remaining = width * height;
-	RipUtil::DrawPos pos = { 0, 0 };
-	while (remaining > 0)
-	{
-		int color = to_int(data++, 1);
-		draw_and_update_pos(bmap, pos, color, 1, x, y, width, height, true, false);
-		--remaining;
-	}
+	const unsigned char* gpos = reinterpret_cast<const unsigned char*>(data);
+	RowWriter out(bmap, x, y, width, height);
+	while (!out.done())
+		out.put(*gpos++);
 }
 
-void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
-	int x, int y, int width, int height, int localtransind, int transind, bool trans,
-	ColorMap colormap, bool deindex)
+template <bool translate>
+void decode_lined_rle_kernel(const char* data, int datlen, RipUtil::BitmapData& bmap,
+	int x, int y, int width, int height, const ColorLUT& lut)
 {
-	int currx = 0;
+	const unsigned char* udata = reinterpret_cast<const unsigned char*>(data);
+	BitmapRow row(bmap, x, y, width, height);
 	int curry = 0;
 
 	int pos = 0;
@@ -1441,9 +1954,11 @@ void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 		int bytecount = to_int(data + next_pos, 2, DatManip::le);
 		pos = next_pos + 2;
 		next_pos += bytecount + 2;
+		row.set_row(curry);
+		int currx = 0;
 		while (pos < datlen && pos < next_pos)
 		{
-			int code = to_int(data + pos, 1);
+			int code = udata[pos];
 			++pos;
 
 			if (code & 1)		// skip count
@@ -1453,47 +1968,51 @@ void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 			else if (code & 2)	// encoded run
 			{
 				int count = (code >> 2) + 1;
-				int color = to_int(data + pos, 1);
+				row.fill(currx, translate_color<translate>(udata[pos], lut), count);
 				++pos;
-				if (deindex)
-					color = colormap[color];
-				if (trans && color == localtransind)
-					color = transind;
-				bmap.draw_row(color, count, currx, curry, x, y, width, height);
 				currx += count;
 			}
 			else				// absolute run
 			{
 				int count = (code >> 2) + 1;
-				for (int i = 0; i < count; i++)
-				{
-					int color = to_int(data + pos, 1);
-					if (deindex)
-						color = colormap[color];
-					if (trans && color == localtransind)
-						color = transind;
-					bmap.draw_row(color, 1, currx, curry, x, y, width, height);
-					++pos;
-					++currx;
-				}
+				copy_span<translate>(row, currx, udata + pos,
+					std::min(count, datlen - pos), lut);
+				pos += count;
+				currx += count;
 			}
 		}
-		currx = 0;
 		++curry;
 	}
 }
 
+void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
+	int x, int y, int width, int height, int localtransind, int transind, bool trans,
+	const ColorMap& colormap, bool deindex)
+{
+	decode_lined_rle(data, datlen, bmap, x, y, width, height,
+		ColorLUT(colormap, deindex, dummy_colormap, false, trans, localtransind, transind));
+}
+
+void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
+	int x, int y, int width, int height, const ColorLUT& lut)
+{
+	if (lut.identity)
+		decode_lined_rle_kernel<false>(data, datlen, bmap, x, y, width, height, lut);
+	else
+		decode_lined_rle_kernel<true>(data, datlen, bmap, x, y, width, height, lut);
+}
+
 void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 	int x, int y, int width, int height, int localtransind, int transind, bool trans)
 {
-	decode_lined_rle(data, datlen, bmap, x, y, width, height, 
-		localtransind, transind, trans, dummy_colormap, false);
+	decode_lined_rle(data, datlen, bmap, x, y, width, height,
+		ColorLUT(dummy_colormap, false, dummy_colormap, false, trans, localtransind, transind));
 }
 
 void decode_type2_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 	int x, int y, int width, int height, int localtransind, int transind)
 {
-	int currx = 0;
+	BitmapRow row(bmap, x, y, width, height);
 	int curry = 0;
 
 	int pos = 0;
@@ -1503,6 +2022,8 @@ void decode_type2_lined_rle(const char* data, int datlen, RipUtil::BitmapData& b
 		int bytecount = to_int(data + next_pos, 2, DatManip::le);
 		pos = next_pos + 2;
 		next_pos += bytecount + 2;
+		row.set_row(curry);
+		int currx = 0;
 		while (pos < datlen && pos < next_pos)
 		{
 			int code = to_int(data + pos, 1);
@@ -1517,134 +2038,249 @@ void decode_type2_lined_rle(const char* data, int datlen, RipUtil::BitmapData& b
 				int count = (code >> 2) + 1;
 				int color = to_int(data + pos, 1);
 				++pos;
-				bmap.draw_row(color, count, currx, curry, x, y, width, height);
+				row.fill(currx, color, count);
 				currx += count;
 			}
 			else				// skip count
 			{					// we draw the transparent color on top of whatever's already there
 				int count = (code >> 2) + 1;
-				bmap.draw_row(transind, count, currx, curry, x, y, width, height);
+				row.fill(currx, transind, count);
 				currx += count;
 			}
 		}
-		currx = 0;
 		++curry;
 	}
 }
 
-void decode_bitstream_img(char* data, int datlen, RipUtil::BitmapData& bmap, int x, int y,
-	int width, int height, int bpabsol, int bprel, bool horiz, bool trans, bool exprange,
-	int localtransind, int transind, const ColorMap& colorremap, bool remap)
+// how the relative color set code (11) of a bitstream image is interpreted
+enum BitstreamRelMode
+{
+	bitstream_rel_toggle,	// 1 bit: step the color up or down by 1, bit toggles direction
+	bitstream_rel_runlen,	// n bits: shift in [-2^(n-1), 2^(n-1) - 1], shift 0 = 8-bit run
+	bitstream_rel_exprange	// n bits: shift in [-2^(n-1), -1] and [1, 2^(n-1)]
+};
+
+// a bitstream image is a series of codes: 0 (repeat the current color),
+// 10 (absolute set) and 11 (relative set). The kernel looks codes up an
+// 8-bit window at a time, getting the run of 0s at the start of the window
+// and the code that ends it, including the shift bits of a relative set
+// if they fit in the window
+enum BitstreamCodeType
+{
+	bitstream_code_none,			// no code ends the run in this window
+	bitstream_code_absolute,		// 10: absolute color bits follow
+	bitstream_code_relative,		// 11: shift bits are in value
+	bitstream_code_relative_long	// 11: shift bits follow
+};
+
+struct BitstreamCode
+{
+	unsigned char zeros;	// number of 0 codes before this one
+	unsigned char type;
+	unsigned char bits;		// total bits taken up by the 0s and the code
+	unsigned char value;
+};
+
+const int bitstream_window_bits = 8;
+const int bitstream_max_bprel = 8;
+
+class BitstreamCodeTable
+{
+public:
+	BitstreamCodeTable(int bprel)
+	{
+		for (int i = 0; i < (1 << bitstream_window_bits); i++)
+		{
+			BitstreamCode& code = codes[i];
+			int zeros = 0;
+			while (zeros < bitstream_window_bits && !((i >> zeros) & 1))
+				++zeros;
+
+			code.zeros = zeros;
+			code.value = 0;
+			if (zeros + 2 > bitstream_window_bits)		// code is cut off
+			{
+				code.type = bitstream_code_none;
+				code.bits = zeros;
+			}
+			else if (!((i >> (zeros + 1)) & 1))			// 10
+			{
+				code.type = bitstream_code_absolute;
+				code.bits = zeros + 2;
+			}
+			else if (zeros + 2 + bprel <= bitstream_window_bits)	// 11 + shift
+			{
+				code.type = bitstream_code_relative;
+				code.bits = zeros + 2 + bprel;
+				code.value = (i >> (zeros + 2)) & ((1 << bprel) - 1);
+			}
+			else if (zeros)		// leave the relative set for the next window
+			{
+				code.type = bitstream_code_none;
+				code.bits = zeros;
+			}
+			else
+			{
+				code.type = bitstream_code_relative_long;
+				code.bits = 2;
+			}
+		}
+	}
+
+	const BitstreamCode& operator[](int window) const { return codes[window]; }
+
+private:
+	BitstreamCode codes[1 << bitstream_window_bits];
+};
+
+// one table per relative set size, built on first use
+const BitstreamCodeTable& get_bitstream_code_table(int bprel)
 {
-	int remaining = width * height;
-	RipUtil::DrawPos pos = { 0, 0 };
+	static const BitstreamCodeTable tables[bitstream_max_bprel] = {
+		BitstreamCodeTable(1), BitstreamCodeTable(2), BitstreamCodeTable(3),
+		BitstreamCodeTable(4), BitstreamCodeTable(5), BitstreamCodeTable(6),
+		BitstreamCodeTable(7), BitstreamCodeTable(8)
+	};
+	return tables[bprel - 1];
+}
+
+// The kernel draws into a linear scratch buffer in drawing order rather than
+// through a writer: the 0s of a lookup are drawn by always storing a full
+// window's worth of pixels and then advancing by the number of 0s, and the
+// pixel of a color set is stored even when the lookup has none, to be drawn
+// over by the next one. The buffer needs bitstream_scratch_slack pixels past
+// the end of the image for this
+const int bitstream_scratch_slack = bitstream_window_bits + 1;
+
+template <bool translate, BitstreamRelMode relmode>
+void decode_bitstream_kernel(const char* data, int datlen, int* out, int count,
+	int bpabsol, int bprel, const ColorLUT& lut)
+{
+	const BitstreamCodeTable& table = get_bitstream_code_table(bprel);
 
 	int color = to_int(data, 1);
-	int firstdrawcolor = color;
-	if (remap)
-		firstdrawcolor = colorremap[color];
-	if (trans && firstdrawcolor == localtransind)
-		firstdrawcolor = transind;
-	draw_and_update_pos(bmap, pos, firstdrawcolor, 1, x, y, width, height, horiz, trans);
-	--remaining;
-	RLBitStream bstr(data + 1, datlen - 1);
+	int drawcolor = translate_color<translate>(color, lut);
+	out[0] = drawcolor;
+	int pos = 1;
+	RLBitReader bits(data + 1, datlen - 1);
 	bool shiftisdown = true;
-	while (remaining > 0)
+	while (pos < count)
 	{
+		// a lookup and the bits of its code never take more than 24 bits
+		bits.refill();
+		const BitstreamCode& code = table[bits.peek(bitstream_window_bits)];
+		bits.consume(code.bits);
+
 		// for each 0, draw 1 pixel of the current color
-		while (remaining > 0 && bstr.get_bit() == 0)
+		for (int i = 0; i < bitstream_window_bits; i++)
+			out[pos + i] = drawcolor;
+		pos += code.zeros;
+
+		if (code.type == bitstream_code_none)
+			continue;
+
+		// work out the color both ways and pick one, rather than branching on
+		// the code type, which is about as predictable as the image
+		bool absolute = (code.type == bitstream_code_absolute);
+		int abscolor = bits.peek(bpabsol);
+		bits.consume(absolute ? bpabsol : 0);
+
+		int shiftbits = code.value;
+		if (code.type == bitstream_code_relative_long)
 		{
-			int drawcolor = color;
-			if (remap)
-				drawcolor = colorremap[color];
-			if (trans && drawcolor == localtransind)
-				drawcolor = transind;
-			draw_and_update_pos(bmap, pos, drawcolor, 1, x, y, width, height, horiz, trans);
-			--remaining;
+			shiftbits = bits.peek(bprel);
+			bits.consume(bprel);
 		}
-		if (remaining > 0)				// we hit a 1
+
+		int shift;
+		if (relmode == bitstream_rel_toggle)
 		{
-			if (bstr.get_bit() == 0)	// 01: absolute set
-			{
-				int newcol = 0;
-				for (int i = 0; i < bpabsol; i++)
-				{
-					int bit = bstr.get_bit();
-					newcol |= (bit << i);
-				}
-				color = newcol;
+			// toggle direction of 0 shift; an absolute set resets it
+			shiftisdown = absolute || (shiftisdown != (shiftbits == 1));
+			shift = shiftisdown ? -1 : 1;
+		}
+		else
+		{
+			shift = shiftbits - (1 << (bprel - 1));
 
-				int drawcolor = color;
-				if (remap)
-					drawcolor = colorremap[color];
-				if (trans && drawcolor == localtransind)
-					drawcolor = transind;
+			if (relmode == bitstream_rel_exprange)
+				shift += (shift >= 0);
+			else if (shift == 0 && !absolute)	// 0 shift = 8-bit run length
+			{
+				int length = bits.peek(8);
+				bits.consume(8);
+				fill_pixels(out + pos, drawcolor, std::min(length, count - pos));
+				pos += length;
+				continue;
+			}
+		}
 
-				// draw 1 pixel of the new color
-				draw_and_update_pos(bmap, pos, drawcolor, 1, x, y, width, height, horiz, trans);
-				--remaining;
+		color = absolute ? abscolor : color + shift;
+		drawcolor = translate_color<translate>(color, lut);
 
-				// reset direction of 1-bit draw shift
-				if (bprel == 1)
-					shiftisdown = true;
-			}
-			else						// 11: relative set
-			{
-				int shift = 0;
-				int length = 1;
-				for (int i = 0; i < bprel; i++)
-				{
-					shift |= (bstr.get_bit() << i);
-				}
+		// draw 1 pixel of the new color
+		out[pos++] = drawcolor;
+	}
+}
 
-				if (bprel != 1)
-				{
-					shift -= (1 << (bprel - 1));
+template <bool translate>
+void dispatch_bitstream_relmode(const char* data, int datlen, int* out, int count,
+	int bpabsol, int bprel, bool exprange, const ColorLUT& lut)
+{
+	if (bprel == 1)
+		decode_bitstream_kernel<translate, bitstream_rel_toggle>(data, datlen,
+			out, count, bpabsol, bprel, lut);
+	else if (exprange)
+		decode_bitstream_kernel<translate, bitstream_rel_exprange>(data, datlen,
+			out, count, bpabsol, bprel, lut);
+	else
+		decode_bitstream_kernel<translate, bitstream_rel_runlen>(data, datlen,
+			out, count, bpabsol, bprel, lut);
+}
 
-					if (exprange)
-					{
-						if (shift >= 0)
-							shift += 1;
-					}
-					else if (!exprange)	// 0 shift = run length
-					{
-						if (shift == 0)	// get 8-bit count
-						{
-							int newlen = 0;
-							for (int i = 0; i < 8; i++)
-							{
-								newlen |= (bstr.get_bit() << i);
-							}
-							length = newlen;
-						}
-					}
+void decode_bitstream_img(char* data, int datlen, RipUtil::BitmapData& bmap, int x, int y,
+	int width, int height, int bpabsol, int bprel, bool horiz, bool exprange,
+	const ColorLUT& lut)
+{
+	if (bprel < 1 || bprel > bitstream_max_bprel)
+	{
+		logger.error("\tunsupported bitstream relative set size " + to_string(bprel));
+		return;
+	}
 
-				}
-				else if (bprel == 1)	// 1-bit mode: get/set shift direction
-				{
-					if (shift == 1)		// toggle direction of 0 shift
-					{
-						shiftisdown ? shiftisdown = false
-							: shiftisdown = true;
-					}
-					shiftisdown ? shift = -1
-						: shift = 1;
-				}
+	if (x < 0 || y < 0 || width <= 0 || height <= 0)
+		return;
 
-				color += shift;
+	// pick the kernel for this image's flags once, rather than per pixel
+	int count = width * height;
+	std::vector<int> scratch(count + bitstream_scratch_slack);
+	if (lut.identity)
+		dispatch_bitstream_relmode<false>(data, datlen, &scratch[0], count,
+			bpabsol, bprel, exprange, lut);
+	else
+		dispatch_bitstream_relmode<true>(data, datlen, &scratch[0], count,
+			bpabsol, bprel, exprange, lut);
 
-				int drawcolor = color;
-				if (remap)
-					drawcolor = colorremap[color];
-				if (trans && drawcolor == localtransind)
-					drawcolor = transind;
+	if (horiz)
+		bmap.put_rows(&scratch[0], x, y, width, height);
+	else
+		bmap.put_columns(&scratch[0], x, y, width, height);
+}
 
-				// draw pixel(s) of the new color
-				draw_and_update_pos(bmap, pos, drawcolor, length, x, y, width, height, horiz, trans);
-				remaining -= length;
-			}
-		}
+void decode_bitstream_img(char* data, int datlen, RipUtil::BitmapData& bmap, int x, int y,
+	int width, int height, int bpabsol, int bprel, bool horiz, bool trans, bool exprange,
+	int localtransind, int transind, const ColorMap& colorremap, bool remap)
+{
+	if (!trans && !remap)
+	{
+		decode_bitstream_img(data, datlen, bmap, x, y, width, height,
+			bpabsol, bprel, horiz, exprange, identity_lut);
+		return;
 	}
+
+	decode_bitstream_img(data, datlen, bmap, x, y, width, height, bpabsol, bprel,
+		horiz, exprange, ColorLUT(dummy_colormap, false, colorremap, remap,
+		trans, localtransind, transind));
 }
 
 void decode_bitstream_img(char* data, int datlen, RipUtil::BitmapData& bmap, int x, int y,
@@ -1680,13 +2316,33 @@ int decode_type2_awiz_pixel(int full) {
 	return (b << 16) | (g << 8) | (r);
 }
 
-void draw_and_update_pos(RipUtil::BitmapData& bmap, DrawPos& pos, int color, int count,
-	int xoff, int yoff, int width, int height, bool horiz, bool trans)
+void decode_type2_awiz_pixels(const char* data, int* dest, int count)
 {
-	if (horiz)
-		pos = bmap.draw_row_wrap(color, count, pos.x, pos.y, xoff, yoff, width, height);
-	else
-		pos = bmap.draw_col_wrap(color, count, pos.x, pos.y, xoff, yoff, width, height);
+	const unsigned char* getpos = reinterpret_cast<const unsigned char*>(data);
+	int i = 0;
+#if defined(__SSE2__)
+	// 8 pixels at a time: the same masks and shifts as decode_type2_awiz_pixel,
+	// with red and green packed into the low 16 bits of each result and blue
+	// into the high 16
+	const __m128i rmask = _mm_set1_epi16(0x7C00);
+	const __m128i gmask = _mm_set1_epi16(0x03E0);
+	const __m128i bmask = _mm_set1_epi16(0x001F);
+	for ( ; i + 8 <= count; i += 8)
+	{
+		__m128i full = _mm_loadu_si128(reinterpret_cast<const __m128i*>(getpos + i * 2));
+		full = _mm_or_si128(_mm_slli_epi16(full, 8), _mm_srli_epi16(full, 8));	// big endian
+
+		__m128i r = _mm_srli_epi16(_mm_and_si128(full, rmask), 7);
+		__m128i g = _mm_slli_epi16(_mm_and_si128(full, gmask), 6);
+		__m128i b = _mm_slli_epi16(_mm_and_si128(full, bmask), 3);
+		__m128i rg = _mm_or_si128(r, g);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_unpacklo_epi16(rg, b));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 4), _mm_unpackhi_epi16(rg, b));
+	}
+#endif
+	for ( ; i < count; i++)
+		dest[i] = decode_type2_awiz_pixel((getpos[i * 2] << 8) | getpos[i * 2 + 1]);
 }
 
 
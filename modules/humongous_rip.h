@@ -21,10 +21,13 @@ enum RLEEncodingMethodHackValue
 	rle_hack_always_use_lined,
 	rle_hack_always_use_unlined 
 };
-extern RLEEncodingMethodHackValue rle_encoding_method_hack;
-extern int rle_encoding_method_hack_images_to_test;
-extern int rle_encoding_method_hack_lined_images;
-extern int rle_encoding_method_hack_unlined_images;
+// The hacks are kept per thread, so that rooms ripped in parallel can each
+// start from the state they would be in if ripped in turn (see
+// HERip::rip_rooms_parallel). The overrides are only set before a rip
+extern thread_local RLEEncodingMethodHackValue rle_encoding_method_hack;
+extern thread_local int rle_encoding_method_hack_images_to_test;
+extern thread_local int rle_encoding_method_hack_lined_images;
+extern thread_local int rle_encoding_method_hack_unlined_images;
 extern bool rle_encoding_method_hack_was_user_overriden;
 
 enum AKOS2ColorDecodingHackValue
@@ -34,12 +37,57 @@ enum AKOS2ColorDecodingHackValue
 	akos_2color_hack_always_use_bitmap
 };
 
-extern AKOS2ColorDecodingHackValue akos_2color_decoding_hack;
-extern int akos_2color_decoding_hack_images_to_test;
-extern int akos_2color_decoding_hack_rle_images;
-extern int akos_2color_decoding_hack_bitmap_images;
+extern thread_local AKOS2ColorDecodingHackValue akos_2color_decoding_hack;
+extern thread_local int akos_2color_decoding_hack_images_to_test;
+extern thread_local int akos_2color_decoding_hack_rle_images;
+extern thread_local int akos_2color_decoding_hack_bitmap_images;
 extern bool akos_2color_decoding_hack_was_user_overriden;
 
+// set whenever an image is decoded in a way that depends on (and may
+// change) the hacks on this thread; never cleared by the decoders
+extern thread_local bool decoding_hacks_used;
+
+// true once the hacks on this thread can't change any more: each has been
+// overridden, or has tested all the images it's going to
+bool decoding_hacks_settled();
+
+// number of threads to decode the strips of an SMAP with (1 = no threading)
+extern int smap_decoding_threads;
+
+// put the hacks (on the calling thread) and thread count back as they are
+// at startup, for a program doing more than one rip
+void reset_decoding_settings();
+
+
+// Color translation for a single image, composing (in order) deindexing
+// through a reduced colormap, remapping through a REMP/RMAP colormap, and
+// substitution of transind for localtransind into one 256-entry table.
+// Colormap entries that don't exist leave the color unchanged
+struct ColorLUT
+{
+	// identity translation
+	ColorLUT();
+	ColorLUT(const ColorMap& colormap, bool deindex, const ColorMap& colorremap,
+		bool remap, bool trans, int localtransind, int transind);
+
+	int operator[](int color) const { return table[color & 0xFF]; }
+
+	int table[256];
+	bool identity;
+};
+
+// the translations used by the different AKOS encodings, built once per AKOS
+// and shared by all of its images
+struct AKOSColorLUTs
+{
+	AKOSColorLUTs(const AKOSChunk& akosc, int localtransind, int transind,
+		const ColorMap& colormap, bool deindex, const ColorMap& colorremap, bool remap);
+
+	ColorLUT rle;			// 2-color lined RLE: alternate transparency only
+	ColorLUT bitstream;		// 2-color bitstream: remap, alternate transparency
+	ColorLUT multicomp;		// multi-color RLE: deindex, remap
+};
+
 
 // RMIM and OBIM decoding
 
@@ -53,7 +101,7 @@ void decode_smap(const SputmChunk& smapc, RipUtil::BitmapData& bmap, int width,
 	int localtransind, int transind);
 
 void decode_bomp(const SputmChunk& bompc, RipUtil::BitmapData& bmap, int localtransind, 
-	int transind, ColorMap colormap, bool deindex);
+	int transind, const ColorMap& colormap, bool deindex);
 
 void decode_bomp(const SputmChunk& bompc, RipUtil::BitmapData& bmap, int localtransind,
 	int transind);
@@ -61,15 +109,19 @@ void decode_bomp(const SputmChunk& bompc, RipUtil::BitmapData& bmap, int localtr
 // AKOS decoding
 
 void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
-	int entrynum, RipUtil::BitmapPalette palette, int localtransind, int transind);
+	int entrynum, const RipUtil::BitmapPalette& palette, int localtransind, int transind);
+
+void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
+	int entrynum, const RipUtil::BitmapPalette& palette, int localtransind, int transind,
+	const ColorMap& colormap, bool deindex);
 
 void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
-	int entrynum, RipUtil::BitmapPalette palette, int localtransind, int transind,
-	ColorMap colormap, bool deindex);
+	int entrynum, const RipUtil::BitmapPalette& palette, int localtransind, int transind,
+	const ColorMap& colormap, bool deindex, const ColorMap& colorremap, bool remap);
 
 void decode_akos(const AKOSChunk& akosc, RipUtil::BitmapData& bmap,
-	int entrynum, RipUtil::BitmapPalette palette, int localtransind, int transind,
-	ColorMap colormap, bool deindex, ColorMap colorremap, bool remap);
+	int entrynum, const RipUtil::BitmapPalette& palette, int transind,
+	const AKOSColorLUTs& luts);
 
 void decode_auxd(const AUXDChunk& auxdc, RipUtil::BitmapData& bmap,
 	int localtransind, int transind);
@@ -104,33 +156,79 @@ SequenceSizingInfo compute_sequence_enclosing_dimensions(
 // AWIZ decoding
 
 void decode_awiz(const AWIZChunk& awizc, RipUtil::BitmapData& bmap, 
-	RipUtil::BitmapPalette palette, int localtransind, int transind,
-	ColorMap colormap, bool deindex);
+	const RipUtil::BitmapPalette& palette, int localtransind, int transind,
+	const ColorMap& colormap, bool deindex);
 
 void decode_awiz(const AWIZChunk& awizc, RipUtil::BitmapData& bmap, 
-	RipUtil::BitmapPalette palette, int localtransind, int transind);
+	const RipUtil::BitmapPalette& palette, int localtransind, int transind);
 
 // CHAR decoding
 
 void decode_char(RipUtil::BitmapData& bmap, const CHAREntry& chare,
 	int compr, const RipUtil::BitmapPalette& palette, int localtransind,
-	int transind, ColorMap colormap, bool deindex);
+	int transind, const ColorMap& colormap, bool deindex);
 
 void decode_char(RipUtil::BitmapData& bmap, const CHAREntry& chare,
 	int compr, const RipUtil::BitmapPalette& palette, int localtransind,
 	int transind);
 
+// where a glyph was placed on a CHAR sheet, and its metrics
+struct CHARSheetEntry
+{
+	int charnum;
+	int x;			// position on the sheet
+	int y;
+	int width;
+	int height;
+	int off1;		// offsets from the CHAREntry
+	int off2;
+};
+
+// decode all glyphs of a CHAR onto one sheet, packed left to right in rows
+// of at most sheetwidth pixels (wider if a glyph needs it) with a 1-pixel
+// gap between glyphs; entries receives one CHARSheetEntry per glyph
+void decode_char_sheet(const CHARChunk& charc, RipUtil::BitmapData& sheet,
+	std::vector<CHARSheetEntry>& entries, int sheetwidth,
+	const RipUtil::BitmapPalette& palette, int localtransind, int transind);
+
 // Low-level format decoders
 
+// the drawing parameters of a standard variable-encoded image
+struct BitmapEncoding
+{
+	int encoding;
+	bool horiz;			// draws horizontal or vertical?
+	bool trans;			// has transparency?
+	bool exprange;		// expanded range for 3-bit relative palette set?
+	int bpabsol;		// bits per absolute palette set
+	int bprel;			// bits per relative palette set
+	RLEEncodingMethodHackValue rlemethod;	// lined or unlined, for RLE
+};
+
+// work out how to draw an image with the given encoding, updating the RLE
+// encoding method hack as it goes; data starts after the encoding byte
+// returns false (after logging an error) if the encoding isn't recognized
+bool read_bitmap_encoding(const char* data, int encoding, int datlen,
+	BitmapEncoding& enc);
+
 // decode a standard variable-encoded image, starting after the encoding byte
 // draws until the space delineated by x, y, width, and height is filled
+// this doesn't touch any global state, so separate parts of a bitmap can be
+// decoded concurrently
+void decode_encoded_bitmap(char* data, const BitmapEncoding& enc, int datlen,
+	RipUtil::BitmapData& bmap, int x, int y, int width, int height,
+	int localtransind, int transind);
+
 void decode_encoded_bitmap(char* data, int encoding, int datlen, RipUtil::BitmapData& bmap,
 	int x, int y, int width, int height, int localtransind, int transind);
 
 void decode_multicomp_rle(const char* data, int width, int height, RipUtil::BitmapData& bmap,
-	RipUtil::BitmapPalette palette, int clrcmp, int localtransind, int transind, 
+	const RipUtil::BitmapPalette& palette, int clrcmp, int localtransind, int transind, 
 	const ColorMap& colormap, bool deindex, const ColorMap& colorremap, bool remap);
 
+void decode_multicomp_rle(const char* data, int width, int height, RipUtil::BitmapData& bmap,
+	int clrcmp, const ColorLUT& lut);
+
 void decode_uncompressed_img(char* data, int datlen, RipUtil::BitmapData& bmap, int x, int y,
 	int width, int height, bool horiz, bool trans, int localtransind, int transind);
 
@@ -139,7 +237,10 @@ void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 
 void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 	int x, int y, int width, int height, int localtransind, int transind, bool trans,
-	ColorMap colormap, bool deindex);
+	const ColorMap& colormap, bool deindex);
+
+void decode_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
+	int x, int y, int width, int height, const ColorLUT& lut);
 
 void decode_type2_lined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap, 
 	int x, int y, int width, int height, int localtransind, int transind);
@@ -149,7 +250,7 @@ void decode_unlined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 
 void decode_unlined_rle(const char* data, int datlen, RipUtil::BitmapData& bmap,
 	int x, int y, int width, int height, int localtransind, int transind, bool trans,
-	ColorMap colormap, bool deindex);
+	const ColorMap& colormap, bool deindex);
 
 void decode_bitstream_img(char* data, int datlen, RipUtil::BitmapData& bmap, int x, int y,
 	int width, int height, int bpabsol, int bprel, bool horiz, bool trans, bool exprange,
@@ -159,11 +260,15 @@ void decode_bitstream_img(char* data, int datlen, RipUtil::BitmapData& bmap, int
 	int width, int height, int bpabsol, int bprel, bool horiz, bool trans, bool exprange,
 	int localtransind, int transind);
 
+void decode_bitstream_img(char* data, int datlen, RipUtil::BitmapData& bmap, int x, int y,
+	int width, int height, int bpabsol, int bprel, bool horiz, bool exprange,
+	const ColorLUT& lut);
+
 int decode_type2_awiz_pixel(int full);
 
-// draw according to parameters and update given DrawPos
-void draw_and_update_pos(RipUtil::BitmapData& bmap, RipUtil::DrawPos& pos, int color, int count,
-	int xoff, int yoff, int width, int height, bool horiz, bool trans);
+// convert count big-endian 16bpp AWIZ pixels to 24-bit color,
+// with the same results as decode_type2_awiz_pixel
+void decode_type2_awiz_pixels(const char* data, int* dest, int count);
 
 
 };	// end of namespace Humongous
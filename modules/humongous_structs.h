@@ -737,12 +737,13 @@ struct AKOSChunk : public SputmChunk
 struct CHAREntry
 {
 	CHAREntry() 
-		: data(0), datalen(0), width(0), height(0), off1(0), off2(0) { };
+		: data(0), datalen(0), charnum(0), width(0), height(0), off1(0), off2(0) { };
 	CHAREntry(const CHAREntry& c)
 	{
 		data = new char[c.datalen];
 		std::memcpy(data, c.data, c.datalen);
 		datalen = c.datalen;
+		charnum = c.charnum;
 		width = c.width;
 		height = c.height;
 		off1 = c.off1;
@@ -753,10 +754,12 @@ struct CHAREntry
 		data = new char[c.datalen];
 		std::memcpy(data, c.data, c.datalen);
 		datalen = c.datalen;
+		charnum = c.charnum;
 		width = c.width;
 		height = c.height;
 		off1 = c.off1;
 		off2 = c.off2;
+		return *this;
 	}
 	~CHAREntry()
 	{
@@ -773,6 +776,7 @@ struct CHAREntry
 	char* data;
 	int datalen;
 
+	int charnum;	// character code the glyph is drawn for
 	int width;
 	int height;
 	int off1;
@@ -801,7 +805,7 @@ struct CYCLChunk : public SputmChunk
 struct TRNSChunk : public SputmChunk
 {
 	TRNSChunk()
-		: SputmChunk() { };
+		: SputmChunk(), trns_val(0) { };
 
 	int trns_val;
 };
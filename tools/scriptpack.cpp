@@ -0,0 +1,72 @@
+/* scriptpack: lists or unpacks a script container written by HEErip with
+   --packscripts (see utils/ScriptPack.h for the format) */
+
+#include "../utils/ScriptPack.h"
+#include "../utils/datmanip.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cctype>
+
+using std::cout;
+using namespace RipUtil;
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		cout << "Usage: scriptpack <container> [-x outprefix]" << '\n'
+			<< '\t' << "Lists the scripts in a container, or with -x writes each to" << '\n'
+			<< '\t' << "outprefix-room-n-kind-m, as HEErip does without --packscripts" << '\n';
+		return 1;
+	}
+
+	std::ifstream ifs(argv[1], std::ios_base::binary);
+	if (!ifs)
+	{
+		cout << "Could not open " << argv[1] << '\n';
+		return 1;
+	}
+	std::vector<char> data((std::istreambuf_iterator<char>(ifs)),
+		std::istreambuf_iterator<char>());
+
+	ScriptPackReader pack;
+	if (data.empty() || !pack.open(&data[0], data.size()))
+	{
+		cout << argv[1] << " is not a script container" << '\n';
+		return 1;
+	}
+
+	std::string outprefix;
+	if (argc >= 4 && std::string(argv[2]) == "-x")
+		outprefix = argv[3];
+
+	for (int i = 0; i < pack.size(); i++)
+	{
+		const ScriptPackEntry& entry = pack.entry(i);
+
+		if (outprefix.empty())
+		{
+			cout << entry.room << '\t' << entry.kind << '\t' << entry.number
+				<< '\t' << entry.offset << '\t' << entry.length << '\n';
+			continue;
+		}
+
+		std::string kind;
+		for (std::string::size_type j = 0; j < entry.kind.size(); j++)
+			kind += std::tolower((unsigned char)entry.kind[j]);
+		std::string filename = outprefix + "-room-" + to_string(entry.room)
+			+ "-" + kind + "-" + to_string(entry.number);
+
+		std::ofstream ofs(filename.c_str(), std::ios_base::binary);
+		ofs.write(pack.payload(i), entry.length);
+		if (!ofs)
+		{
+			cout << "Could not write " << filename << '\n';
+			return 1;
+		}
+	}
+
+	return 0;
+}
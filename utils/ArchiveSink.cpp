@@ -0,0 +1,267 @@
+#include "ArchiveSink.h"
+
+#include "Deflate.h"
+#include "datmanip.h"
+#include <cstdio>
+#include <cstring>
+
+namespace RipUtil
+{
+
+
+namespace
+{
+
+// little-endian fields, for zip
+void put_le(std::vector<char>& out, unsigned long long val, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		out.push_back(static_cast<char>(val >> (i * 8)));
+}
+
+// zero-terminated octal field, for tar
+void put_octal(char* field, int len, unsigned long long val)
+{
+	std::memset(field, '0', len - 1);
+	field[len - 1] = 0;
+	for (int i = len - 2; i >= 0 && val; i--)
+	{
+		field[i] = '0' + (val & 7);
+		val >>= 3;
+	}
+}
+
+const int tar_block_size = 512;
+
+const unsigned int zip_local_sig = 0x04034B50;
+const unsigned int zip_central_sig = 0x02014B50;
+const unsigned int zip_end_sig = 0x06054B50;
+const unsigned int zip64_end_sig = 0x06064B50;
+const unsigned int zip64_locator_sig = 0x07064B50;
+const int zip_version = 20;
+const int zip64_version = 45;
+const int zip_dos_date = (0 << 9) | (1 << 5) | 1;		// 1980-01-01, for reproducible output
+
+};
+
+ArchiveSink::ArchiveSink(const std::string& archivefile, const std::string& base)
+	: ofs(archivefile.c_str(), std::ios_base::binary | std::ios_base::trunc),
+	pos(0), basedir(base),
+	archivename(strip_extension(strip_path(archivefile)))
+{
+
+}
+
+std::string ArchiveSink::entry_name(const std::string& filename) const
+{
+	if (basedir.size() && filename.compare(0, basedir.size(), basedir) == 0)
+		return filename.substr(basedir.size());
+	return filename;
+}
+
+void ArchiveSink::put(const std::string& filename, std::vector<char>& data)
+{
+	write_entry(entry_name(filename), data);
+}
+
+void ArchiveSink::append(const std::string& filename, std::vector<char>& data)
+{
+	std::vector<char>& file = appended[entry_name(filename)];
+	file.insert(file.end(), data.begin(), data.end());
+}
+
+void ArchiveSink::finish()
+{
+	for (std::map<std::string, std::vector<char> >::const_iterator it
+		= appended.begin(); it != appended.end(); ++it)
+		write_entry((*it).first, (*it).second);
+	appended.clear();
+
+	write_trailer();
+	ofs.close();
+}
+
+
+void TarSink::write_header(const std::string& name, int size, char type)
+{
+	char header[tar_block_size];
+	std::memset(header, 0, tar_block_size);
+
+	// names that don't fit go in a GNU long name entry first
+	if (name.size() > 99 && type != 'L')
+	{
+		write_header("././@LongLink", name.size() + 1, 'L');
+		std::vector<char> longname(name.begin(), name.end());
+		longname.resize(((name.size() + 1 + tar_block_size - 1)
+			/ tar_block_size) * tar_block_size, 0);
+		ofs.write(&longname[0], longname.size());
+		pos += longname.size();
+	}
+
+	std::strncpy(header, name.c_str(), 99);
+	put_octal(header + 100, 8, 0644);		// mode
+	put_octal(header + 108, 8, 0);			// uid
+	put_octal(header + 116, 8, 0);			// gid
+	put_octal(header + 124, 12, size);
+	put_octal(header + 136, 12, 0);			// mtime, fixed for reproducible output
+	header[156] = type;
+	std::memcpy(header + 257, "ustar", 6);
+	std::memcpy(header + 263, "00", 2);
+
+	// checksum is taken with its own field as spaces
+	std::memset(header + 148, ' ', 8);
+	unsigned int checksum = 0;
+	for (int i = 0; i < tar_block_size; i++)
+		checksum += static_cast<unsigned char>(header[i]);
+	put_octal(header + 148, 7, checksum);
+
+	ofs.write(header, tar_block_size);
+	pos += tar_block_size;
+}
+
+void TarSink::write_entry(const std::string& name, const std::vector<char>& data)
+{
+	write_header(name, data.size(), '0');
+
+	std::string line = name + '\t' + to_string(pos) + '\t'
+		+ to_string(data.size()) + '\n';
+	index.insert(index.end(), line.begin(), line.end());
+
+	if (data.size())
+		ofs.write(&data[0], data.size());
+	pos += data.size();
+
+	// pad to a whole block
+	int padding = (tar_block_size - data.size() % tar_block_size) % tar_block_size;
+	char zeroes[tar_block_size] = { 0 };
+	ofs.write(zeroes, padding);
+	pos += padding;
+}
+
+void TarSink::write_trailer()
+{
+	std::vector<char> indexfile;
+	indexfile.swap(index);
+	write_entry(archivename + "-index.txt", indexfile);
+
+	// two empty blocks end the archive
+	char zeroes[tar_block_size * 2] = { 0 };
+	ofs.write(zeroes, tar_block_size * 2);
+	pos += tar_block_size * 2;
+}
+
+
+void ZipSink::write_entry(const std::string& name, const std::vector<char>& data)
+{
+	CentralEntry entry;
+	entry.name = name;
+	entry.crc = crc32(data.size() ? &data[0] : 0, data.size());
+	entry.size = data.size();
+	entry.offset = pos;
+
+	std::vector<char> header;
+	put_le(header, zip_local_sig, 4);
+	put_le(header, zip_version, 2);
+	put_le(header, 0, 2);				// flags
+	put_le(header, 0, 2);				// method: stored
+	put_le(header, 0, 2);				// time
+	put_le(header, zip_dos_date, 2);
+	put_le(header, entry.crc, 4);
+	put_le(header, entry.size, 4);		// compressed size
+	put_le(header, entry.size, 4);		// uncompressed size
+	put_le(header, name.size(), 2);
+	put_le(header, 0, 2);				// extra field length
+	header.insert(header.end(), name.begin(), name.end());
+
+	ofs.write(&header[0], header.size());
+	if (data.size())
+		ofs.write(&data[0], data.size());
+	pos += header.size() + data.size();
+
+	central.push_back(entry);
+}
+
+void ZipSink::write_trailer()
+{
+	long long cdstart = pos;
+
+	std::vector<char> record;
+	for (std::vector<CentralEntry>::const_iterator it = central.begin();
+		it != central.end(); ++it)
+	{
+		const CentralEntry& entry = *it;
+		bool zip64 = entry.offset >= 0xFFFFFFFFLL;
+
+		record.clear();
+		put_le(record, zip_central_sig, 4);
+		put_le(record, zip64 ? zip64_version : zip_version, 2);		// made by
+		put_le(record, zip64 ? zip64_version : zip_version, 2);		// needed
+		put_le(record, 0, 2);				// flags
+		put_le(record, 0, 2);				// method: stored
+		put_le(record, 0, 2);				// time
+		put_le(record, zip_dos_date, 2);
+		put_le(record, entry.crc, 4);
+		put_le(record, entry.size, 4);
+		put_le(record, entry.size, 4);
+		put_le(record, entry.name.size(), 2);
+		put_le(record, zip64 ? 12 : 0, 2);	// extra field length
+		put_le(record, 0, 2);				// comment length
+		put_le(record, 0, 2);				// disk number
+		put_le(record, 0, 2);				// internal attributes
+		put_le(record, 0, 4);				// external attributes
+		put_le(record, zip64 ? 0xFFFFFFFFLL : entry.offset, 4);
+		record.insert(record.end(), entry.name.begin(), entry.name.end());
+		if (zip64)
+		{
+			// zip64 extra field holding the real offset
+			put_le(record, 0x0001, 2);
+			put_le(record, 8, 2);
+			put_le(record, entry.offset, 8);
+		}
+
+		ofs.write(&record[0], record.size());
+		pos += record.size();
+	}
+
+	long long cdsize = pos - cdstart;
+	long long count = central.size();
+	bool zip64 = count >= 0xFFFF || cdstart >= 0xFFFFFFFFLL
+		|| cdsize >= 0xFFFFFFFFLL;
+
+	record.clear();
+	if (zip64)
+	{
+		long long zip64end = pos;
+		put_le(record, zip64_end_sig, 4);
+		put_le(record, 44, 8);				// size of the rest of the record
+		put_le(record, zip64_version, 2);
+		put_le(record, zip64_version, 2);
+		put_le(record, 0, 4);				// this disk
+		put_le(record, 0, 4);				// disk with central directory
+		put_le(record, count, 8);
+		put_le(record, count, 8);
+		put_le(record, cdsize, 8);
+		put_le(record, cdstart, 8);
+
+		put_le(record, zip64_locator_sig, 4);
+		put_le(record, 0, 4);
+		put_le(record, zip64end, 8);
+		put_le(record, 1, 4);				// number of disks
+	}
+
+	put_le(record, zip_end_sig, 4);
+	put_le(record, 0, 2);
+	put_le(record, 0, 2);
+	put_le(record, zip64 ? 0xFFFF : count, 2);
+	put_le(record, zip64 ? 0xFFFF : count, 2);
+	put_le(record, zip64 ? 0xFFFFFFFFLL : cdsize, 4);
+	put_le(record, zip64 ? 0xFFFFFFFFLL : cdstart, 4);
+	put_le(record, 0, 2);					// comment length
+
+	ofs.write(&record[0], record.size());
+	pos += record.size();
+	central.clear();
+}
+
+
+};	// end namespace RipUtil
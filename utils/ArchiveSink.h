@@ -0,0 +1,93 @@
+/* Output sinks that stream every file of a rip into a single archive
+   instead of creating one file per asset */
+
+#include "OutputSink.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+namespace RipUtil
+{
+
+
+// Entries are written as files arrive, in that order, and named relative to
+// basedir (which is stripped from the start of each filename). Appended
+// files are kept in memory and written by finish(), in name order, followed
+// by whatever index the format uses. Nothing else is held back, and no
+// temporary files are used
+class ArchiveSink : public OutputSink
+{
+public:
+	ArchiveSink(const std::string& archivefile, const std::string& base);
+	virtual ~ArchiveSink() { };
+
+	// false if the archive couldn't be created
+	bool is_open() const { return ofs.is_open(); }
+
+	void put(const std::string& filename, std::vector<char>& data);
+	void append(const std::string& filename, std::vector<char>& data);
+	void finish();
+
+protected:
+	// write one entry at the current position
+	virtual void write_entry(const std::string& name, const std::vector<char>& data) = 0;
+	// write the index and end of the archive
+	virtual void write_trailer() = 0;
+
+	std::string entry_name(const std::string& filename) const;
+
+	std::ofstream ofs;
+	long long pos;			// bytes written so far
+	std::string basedir;
+	std::string archivename;	// archive filename without directory or extension
+
+	std::map<std::string, std::vector<char> > appended;
+};
+
+// POSIX ustar archive. Since tar has no index of its own, the last entry is
+// archivename-index.txt, giving the name, data offset and size of every
+// other entry, tab-separated
+class TarSink : public ArchiveSink
+{
+public:
+	TarSink(const std::string& archivefile, const std::string& base)
+		: ArchiveSink(archivefile, base) { };
+
+protected:
+	void write_entry(const std::string& name, const std::vector<char>& data);
+	void write_trailer();
+
+	void write_header(const std::string& name, int size, char type);
+
+	std::vector<char> index;
+};
+
+// zip archive with every entry stored (uncompressed), using the zip64
+// extensions once there are too many entries or too much data for the
+// original format
+class ZipSink : public ArchiveSink
+{
+public:
+	ZipSink(const std::string& archivefile, const std::string& base)
+		: ArchiveSink(archivefile, base) { };
+
+protected:
+	void write_entry(const std::string& name, const std::vector<char>& data);
+	void write_trailer();
+
+	struct CentralEntry
+	{
+		std::string name;
+		unsigned int crc;
+		unsigned int size;
+		long long offset;		// of the local header
+	};
+
+	std::vector<CentralEntry> central;
+};
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
@@ -0,0 +1,42 @@
+/* Receiver for the assets of a rip, for programs that want the decoded
+   data itself rather than files */
+
+#include "BitmapData.h"
+#include "PCMData.h"
+#include <string>
+#include <vector>
+
+namespace RipUtil
+{
+
+
+// A ripper given a visitor hands it each asset in place of writing a file.
+// Names are what the files would have been called, without the extension
+// for images (whose format is up to the visitor). The assets are only valid
+// for the duration of the call
+class AssetVisitor
+{
+public:
+	virtual ~AssetVisitor() { };
+
+	// if palettized, the pixels are color indices into the image's
+	// palette; transind is the index of the background color
+	virtual void visit_image(const std::string& name, BitmapData& image,
+		int transind) =0;
+
+	// samples as described by the PCMData; the trimming set by
+	// -ignorestart and -ignoreend isn't applied
+	virtual void visit_sound(const std::string& name, PCMData& sound) =0;
+
+	// text files built up over the whole rip (TLKE, metadata, ...) arrive
+	// in several pieces in order, each with the same name
+	virtual void visit_text(const std::string& name, const std::string& text) =0;
+
+	// anything else, already in its file format (copied audio, MIDI, ...)
+	virtual void visit_file(const std::string& name, const std::vector<char>& data) =0;
+};
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
@@ -0,0 +1,93 @@
+/* Reader that attaches to an existing char array and provides
+   access to its contents a few bits at a time */
+
+namespace RipUtil
+{
+
+
+// Bits are buffered in a 64-bit register. refill() tops it up with one 8-byte
+// load while there are at least 8 bytes of data left, and a byte at a time near
+// the end, so up to 32 bits can be examined with peek() and then dropped with
+// consume() without touching the data again. Reads past the end of the data
+// give zero bits
+
+// least significant to most significant bit reader
+class RLBitReader
+{
+public:
+
+	RLBitReader(const char* d, int len)
+		: data(reinterpret_cast<const unsigned char*>(d)), datalen(len), datapos(0),
+		buffer(0), bitcount(0)
+	{
+		refill();
+	}
+
+	// top the buffer up to at least 57 bits
+	void refill()
+	{
+		if (bitcount > 56)
+			return;
+
+		if (datapos + 8 <= datalen)
+		{
+			// fast path: load 8 bytes and keep as many as fit
+			unsigned long long word = 0;
+			for (int i = 0; i < 8; i++)
+				word |= (unsigned long long)data[datapos + i] << (i * 8);
+			buffer |= word << bitcount;
+			datapos += (63 - bitcount) >> 3;
+			bitcount |= 56;
+		}
+		else
+		{
+			while (bitcount <= 56)
+			{
+				if (datapos < datalen)
+					buffer |= (unsigned long long)data[datapos] << bitcount;
+				++datapos;
+				bitcount += 8;
+			}
+		}
+	}
+
+	// next nbits (<= 32) bits, first bit in the least significant position
+	// the caller must make sure they are buffered
+	int peek(int nbits) const
+	{
+		return (int)(buffer & ((1ULL << nbits) - 1));
+	}
+
+	void consume(int nbits)
+	{
+		buffer >>= nbits;
+		bitcount -= nbits;
+	}
+
+	int get(int nbits)
+	{
+		if (bitcount < nbits)
+			refill();
+		int value = peek(nbits);
+		consume(nbits);
+		return value;
+	}
+
+	int get_bit()
+	{
+		return get(1);
+	}
+
+private:
+
+	const unsigned char* data;
+	int datalen;
+	int datapos;
+	unsigned long long buffer;
+	int bitcount;
+};
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
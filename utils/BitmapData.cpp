@@ -4,22 +4,120 @@
 #include "DefaultException.h"
 #include <cstring>
 #include <fstream>
+#include <algorithm>
 #include <cmath>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace RipUtil
 {
 
 
+namespace
+{
+
+// transpose a 4x4 block of ints
+inline void transpose_4x4(const int* src, int srcstride, int* dest, int deststride)
+{
+#if defined(__SSE2__)
+	__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + srcstride));
+	__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + srcstride * 2));
+	__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + srcstride * 3));
+
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_unpacklo_epi64(t0, t1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + deststride),
+		_mm_unpackhi_epi64(t0, t1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + deststride * 2),
+		_mm_unpacklo_epi64(t2, t3));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + deststride * 3),
+		_mm_unpackhi_epi64(t2, t3));
+#else
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			dest[j * deststride + i] = src[i * srcstride + j];
+#endif
+}
+
+// copy count pixels from src to dest, except those of transcolor
+void blit_row_masked(int* dest, const int* src, int count, int transcolor)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	// compare and blend 16 pixels per iteration
+	const __m128i trans = _mm_set1_epi32(transcolor);
+	for ( ; i + 16 <= count; i += 16)
+	{
+		for (int j = 0; j < 16; j += 4)
+		{
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + j));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<__m128i*>(dest + i + j));
+			__m128i keep = _mm_cmpeq_epi32(s, trans);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + j),
+				_mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s)));
+		}
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		if (src[i] != transcolor)
+			dest[i] = src[i];
+	}
+}
+
+// transpose rows x cols ints at src into cols x rows ints at dest,
+// a cache-sized block at a time
+void transpose(const int* src, int srcstride, int* dest, int deststride,
+	int rows, int cols)
+{
+	const int blocksize = 32;
+	int rows4 = rows & ~3;
+	int cols4 = cols & ~3;
+
+	for (int bi = 0; bi < rows4; bi += blocksize)
+	{
+		int iend = std::min(bi + blocksize, rows4);
+		for (int bj = 0; bj < cols4; bj += blocksize)
+		{
+			int jend = std::min(bj + blocksize, cols4);
+			for (int i = bi; i < iend; i += 4)
+				for (int j = bj; j < jend; j += 4)
+					transpose_4x4(src + i * srcstride + j, srcstride,
+						dest + j * deststride + i, deststride);
+		}
+	}
+
+	// leftover rows and columns
+	for (int i = 0; i < rows; i++)
+		for (int j = (i < rows4) ? cols4 : 0; j < cols; j++)
+			dest[j * deststride + i] = src[i * srcstride + j];
+}
+
+};
+
+
+
 BitmapData& BitmapData::operator=(const BitmapData& bmap)
 {
-	delete[] pixels;
-	pixels = new int[bmap.allocation_size];
-	for (int i = 0; i < bmap.allocation_size; i++)
-		pixels[i] = bmap.pixels[i];
-	width = bmap.width;
-	height = bmap.height;
-	bpp = bmap.bpp;
-	allocation_size = bmap.allocation_size;
+	if (this == &bmap)
+		return *this;
+
+	resize_pixels(bmap.width, bmap.height, bmap.bpp);
+	if (allocation_size != bmap.allocation_size)
+	{
+		// sizes can disagree after set_width()/set_height()
+		PixelPool::release(pixels, buffer_size);
+		pixels = PixelPool::acquire(bmap.allocation_size, buffer_size);
+		allocation_size = bmap.allocation_size;
+	}
+	std::memcpy(pixels, bmap.pixels, allocation_size * sizeof(int));
 	palettized = bmap.palettized;
 	palette = bmap.palette;
 
@@ -36,23 +134,22 @@ const void BitmapData::copy_rect(BitmapData& copy, int x, int y, int w, int h)
 	}
 	else
 		copy.set_palettized(false);
-	int* getpos = pixels;
 	int* putpos = copy.get_pixels();
 	for (int i = y; i < y + h; i++)
 	{
-		getpos = pixels + (i * width) + x;
-		for (int j = x; j < x + w; j++)
-		{
-			*putpos++ = *getpos++;
-		}
+		std::memcpy(putpos, pixels + (i * width) + x, w * sizeof(int));
+		putpos += w;
 	}
 }
 
 void BitmapData::resize_pixels(int w, int h, int bits)
 {
-	delete[] pixels;
 	allocation_size = w * h;
-	pixels = new int[allocation_size];
+	if (!pixels || buffer_size < allocation_size)
+	{
+		PixelPool::release(pixels, buffer_size);
+		pixels = PixelPool::acquire(allocation_size, buffer_size);
+	}
 	width = w;
 	height = h;
 	bpp = bits;
@@ -72,14 +169,12 @@ void BitmapData::set_palette_8bit_grayscale()
 
 void BitmapData::clear()
 {
-	for (int i = 0; i < allocation_size; i++)
-		pixels[i] = 0;
+	std::memset(pixels, 0, allocation_size * sizeof(int));
 }
 
 void BitmapData::clear(int color)
 {
-	for (int i = 0; i < allocation_size; i++)
-		pixels[i] = color;
+	fill_pixels(pixels, color, allocation_size);
 }
 
 int BitmapData::draw_row(int color, int count, int x, int y)
@@ -112,7 +207,7 @@ int BitmapData::draw_row(int color, int count, int x, int y,
 		return count;
 
 	// bound drawing at the end of the row
-	int drawcount = count - std::max(0, x + count - (boxx + boxw));
+	int drawcount = count - std::max(0, x + count - boxw);
 	int startpos = boxx + x + (y + boxy) * width;
 	for (int i = 0; i < drawcount; i++)
 		pixels[startpos + i] = color;
@@ -160,7 +255,7 @@ int BitmapData::draw_col(int color, int count, int x, int y,
 		|| count < 0)
 		return count;
 
-	int drawcount = count - std::max(0, y + count - (boxy + boxh));
+	int drawcount = count - std::max(0, y + count - boxh);
 	int startpos = boxx + x + (y + boxy) * width;
 	for (int i = 0; i < drawcount; i++)
 		pixels[startpos + width * i] = color;
@@ -198,6 +293,28 @@ DrawPos BitmapData::draw_col_wrap(int color, int count, int x, int y,
 	return d;
 }
 
+void BitmapData::put_rows(const int* src, int x, int y, int w, int h)
+{
+	int* putpos = pixels + x + y * width;
+	for (int i = 0; i < h; i++)
+	{
+		std::memcpy(putpos, src, w * sizeof(int));
+		src += w;
+		putpos += width;
+	}
+}
+
+void BitmapData::put_columns(const int* src, int x, int y, int w, int h)
+{
+	// each column of the block is a row of the transpose
+	transpose(src, h, pixels + x + y * width, width, w, h);
+}
+
+void BitmapData::get_columns(int* dest, int x, int y, int w, int h) const
+{
+	transpose(pixels + x + y * width, width, dest, h, h, w);
+}
+
 void BitmapData::blit_bitmapdata(BitmapData& bmpdat, int xpos, int ypos)
 {
 	// if no overlap, do nothing
@@ -231,10 +348,7 @@ void BitmapData::blit_bitmapdata(BitmapData& bmpdat, int xpos, int ypos)
 	dest += thisx + width * thisy;
 	for (int i = 0; i < bheight; i++)
 	{
-		for (int j = 0; j < bwidth; j++)
-		{
-			*(dest + j) = *(source + j);
-		}
+		std::memcpy(dest, source, bwidth * sizeof(int));
 		source += bmpdat.get_width();
 		dest += width;
 	}
@@ -274,42 +388,187 @@ void BitmapData::blit_bitmapdata(BitmapData& bmpdat, int xpos, int ypos,
 	dest += thisx + width * thisy;
 	for (int i = 0; i < bheight; i++)
 	{
-		for (int j = 0; j < bwidth; j++)
-		{
-			if (*(source + j) != transcolor)
-			{
-				*(dest + j) = *(source + j);
-			}
-		}
+		blit_row_masked(dest, source, bwidth, transcolor);
 		source += bmpdat.get_width();
 		dest += width;
 	}
 }
 
-void write_bmp_header(std::ofstream& ofs, const BMPHeader& bmphd)
+DrawRect BitmapData::find_bounds(int bgcolor, const DrawRect& area) const
+{
+	DrawRect bounds = { 0, 0, 0, 0 };
+
+	int left = std::max(0, area.x);
+	int top = std::max(0, area.y);
+	int right = std::min(width, area.x + area.width);
+	int bottom = std::min(height, area.y + area.height);
+	if (left >= right || top >= bottom)
+		return bounds;
+
+	// cut blank rows off the top and bottom first, so that the columns
+	// only need checking over the rows in between
+	for ( ; top < bottom; top++)
+	{
+		const int* row = pixels + top * width;
+		int i = left;
+		while (i < right && row[i] == bgcolor)
+			++i;
+		if (i < right)
+			break;
+	}
+	if (top == bottom)
+		return bounds;
+	for ( ; bottom > top + 1; bottom--)
+	{
+		const int* row = pixels + (bottom - 1) * width;
+		int i = left;
+		while (i < right && row[i] == bgcolor)
+			++i;
+		if (i < right)
+			break;
+	}
+
+	// each row only needs to be checked up to the edges found so far
+	int minx = right;
+	int maxx = left;
+	for (int j = top; j < bottom; j++)
+	{
+		const int* row = pixels + j * width;
+		int i = left;
+		while (i < minx && row[i] == bgcolor)
+			++i;
+		minx = i;
+		i = right;
+		while (i > maxx && row[i - 1] == bgcolor)
+			--i;
+		maxx = i;
+	}
+
+	bounds.x = minx;
+	bounds.y = top;
+	bounds.width = maxx - minx;
+	bounds.height = bottom - top;
+	return bounds;
+}
+
+DrawRect enclose_rects(const DrawRect& a, const DrawRect& b)
+{
+	if (a.width <= 0 || a.height <= 0)
+		return b;
+	if (b.width <= 0 || b.height <= 0)
+		return a;
+
+	DrawRect r;
+	r.x = std::min(a.x, b.x);
+	r.y = std::min(a.y, b.y);
+	r.width = std::max(a.x + a.width, b.x + b.width) - r.x;
+	r.height = std::max(a.y + a.height, b.y + b.height) - r.y;
+	return r;
+}
+
+namespace
+{
+
+const int bmp_header_size = 54;
+
+inline void put_field(char*& pos, const char* field, int n)
+{
+	std::memcpy(pos, field, n);
+	pos += n;
+}
+
+// lay out a BMP header at dest as it appears in the file
+void put_bmp_header(char* dest, const BMPHeader& bmphd)
 {
 	// file header
-	ofs.write(bmphd.bmp_filehd_type, 2);
-	ofs.write(bmphd.bmp_filehd_size, 4);
-	ofs.write(bmphd.bmp_filehd_reserved1, 2);
-	ofs.write(bmphd.bmp_filehd_reserved2, 2);
-	ofs.write(bmphd.bmp_filehd_offbits, 4);
+	put_field(dest, bmphd.bmp_filehd_type, 2);
+	put_field(dest, bmphd.bmp_filehd_size, 4);
+	put_field(dest, bmphd.bmp_filehd_reserved1, 2);
+	put_field(dest, bmphd.bmp_filehd_reserved2, 2);
+	put_field(dest, bmphd.bmp_filehd_offbits, 4);
 
 	// info header
-	ofs.write(bmphd.bmp_infohd_size, 4);
-	ofs.write(bmphd.bmp_infohd_width, 4);
-	ofs.write(bmphd.bmp_infohd_height, 4);
-	ofs.write(bmphd.bmp_infohd_planes, 2);
-	ofs.write(bmphd.bmp_infohd_bitcount, 2);
-	ofs.write(bmphd.bmp_infohd_compression, 4);
-	ofs.write(bmphd.bmp_infohd_sizeimage, 4);
-	ofs.write(bmphd.bmp_infohd_xpelsm, 4);
-	ofs.write(bmphd.bmp_infohd_ypelsm, 4);
-	ofs.write(bmphd.bmp_infohd_clrused, 4);
-	ofs.write(bmphd.bmp_infohd_clrimp, 4);
+	put_field(dest, bmphd.bmp_infohd_size, 4);
+	put_field(dest, bmphd.bmp_infohd_width, 4);
+	put_field(dest, bmphd.bmp_infohd_height, 4);
+	put_field(dest, bmphd.bmp_infohd_planes, 2);
+	put_field(dest, bmphd.bmp_infohd_bitcount, 2);
+	put_field(dest, bmphd.bmp_infohd_compression, 4);
+	put_field(dest, bmphd.bmp_infohd_sizeimage, 4);
+	put_field(dest, bmphd.bmp_infohd_xpelsm, 4);
+	put_field(dest, bmphd.bmp_infohd_ypelsm, 4);
+	put_field(dest, bmphd.bmp_infohd_clrused, 4);
+	put_field(dest, bmphd.bmp_infohd_clrimp, 4);
 }
 
-void write_bitmapdata_bmp(BitmapData& bmpdat, const std::string& filename)
+// palette color of index, or black if the palette doesn't define it
+inline int palette_color(const BitmapPalette& palette, int index)
+{
+	BitmapPalette::const_iterator it = palette.find(index);
+	return (it != palette.end()) ? it->second : 0;
+}
+
+// store a color as 3 bytes, most significant first (blue, green, red)
+inline void put_bmp_color(char* dest, int color)
+{
+	dest[0] = (color >> 16) & 0xFF;
+	dest[1] = (color >> 8) & 0xFF;
+	dest[2] = color & 0xFF;
+}
+
+};
+
+BitmapRGBConverter::BitmapRGBConverter(BitmapData& bmpdat)
+	: palette(bmpdat.get_palette()), palettized(bmpdat.get_palettized()),
+	bpp(bmpdat.get_bpp())
+{
+	if (palettized)
+	{
+		for (int i = 0; i < 256; i++)
+			colortable[i] = palette_color(palette, i);
+	}
+}
+
+int BitmapRGBConverter::convert(int pixel) const
+{
+	if (palettized)
+		return palette_color(palette, pixel);
+
+	unsigned int color = pixel;
+	int r, g, b;
+	switch(bpp)
+	{
+	case 8:
+		r = color & 3;
+		g = color & (3 << 2);
+		b = color & (3 << 4);
+		break;
+	case 16:
+		r = (color & 0xF);
+		g = (color & 0xF0) >> 4;
+		b = (color & 0xF00) >> 8;
+		break;
+	case 24: case 32:
+		r = (color & 0xFF);
+		g = (color & 0xFF00) >> 8;
+		b = (color & 0xFF0000) >> 16;
+		break;
+	default:
+		throw(DefaultException("tried to save image with invalid bpp"));
+	}
+	return r | (g << 8) | (b << 16);
+}
+
+void write_bmp_header(std::ofstream& ofs, const BMPHeader& bmphd)
+{
+	char header[bmp_header_size];
+	put_bmp_header(header, bmphd);
+	ofs.write(header, bmp_header_size);
+}
+
+// Both writers build the whole file in memory and write it with one call
+
+void encode_bitmapdata_bmp(BitmapData& bmpdat, std::vector<char>& file)
 {
 	BMPHeader bmphd;
 	
@@ -331,75 +590,41 @@ void write_bitmapdata_bmp(BitmapData& bmpdat, const std::string& filename)
 	to_bytes(xpels, bmphd.bmp_infohd_xpelsm, 4, DatManip::le);
 	to_bytes(ypels, bmphd.bmp_infohd_ypelsm, 4, DatManip::le);
 
-	// file header
-	std::ofstream ofs(filename.c_str(), std::ios_base::binary);
-	write_bmp_header(ofs, bmphd);
+	int width = bmpdat.get_width();
+	int height = bmpdat.get_height();
+	int rowsize = width * 3 + width % 4;	// padded to a 4-byte boundary
+
+	file.assign(offbits + rowsize * height, 0);
+	put_bmp_header(&file[0], bmphd);
 
-	// pixel data
-	for (int i = bmpdat.get_height() - 1; i >= 0; i--)
+	// pixel data, bottom row first
+	BitmapRGBConverter rgb(bmpdat);
+	char* putpos = &file[offbits];
+	for (int i = height - 1; i >= 0; i--)
 	{
-		int* rowstart = bmpdat.get_pixels() + i * bmpdat.get_width();
-		for (int j = 0; j < bmpdat.get_width(); j++)
-		{
-			int r = 0;
-			int g = 0;
-			int b = 0;
-			int output = 0;
-			if (bmpdat.get_palettized())
-			{
-				unsigned int palettecolor = *(rowstart + j);
-				unsigned int color = bmpdat.get_palette()[palettecolor];
-				r = (color & 0xFF);
-				g = (color & 0xFF00) >> 8;
-				b = (color & 0xFF0000) >> 16;
-			}
-			else
-			{
-				unsigned int color = *(rowstart + j);
-				switch(bmpdat.get_bpp())
-				{
-				case 8:
-					r = color & 3;
-					g = color & (3 << 2);
-					b = color & (3 << 4);
-					break;
-				case 16:
-					r = (color & 0xF);
-					g = (color & 0xF0) >> 4;
-					b = (color & 0xF00) >> 8;
-					break;
-				case 24: case 32:
-					r = (color & 0xFF);
-					g = (color & 0xFF00) >> 8;
-					b = (color & 0xFF0000) >> 16;
-					break;
-				default:
-					throw(DefaultException("tried to save image with invalid bpp"));
-				}
-			}
-			output |= r;
-			output |= (g << 8);
-			output |= (b << 16);
-			char outbytes[3];
-			to_bytes(output, outbytes, 3);
-			ofs.write(outbytes, 3);
-		}
-		// pad line to 4-byte boundary
-		int padbytes = bmpdat.get_width() % 4;
-		for (int j = 0; j < padbytes; j++)
-		{
-			ofs.put(0);
-		}
+		const int* rowstart = bmpdat.get_pixels() + i * width;
+		for (int j = 0; j < width; j++)
+			put_bmp_color(putpos + j * 3, rgb(rowstart[j]));
+		putpos += rowsize;
 	}
 }
 
-void write_bitmapdata_8bitpalettized_bmp(BitmapData& bmpdat, const std::string& filename)
+void write_bitmapdata_bmp(BitmapData& bmpdat, const std::string& filename)
+{
+	std::vector<char> file;
+	encode_bitmapdata_bmp(bmpdat, file);
+
+	std::ofstream ofs(filename.c_str(), std::ios_base::binary);
+	ofs.write(&file[0], file.size());
+}
+
+void encode_bitmapdata_8bitpalettized_bmp(BitmapData& bmpdat, std::vector<char>& file)
 {
 	BMPHeader bmphd;
-	char colortable[1024];
 	
 	int infohd_size = 40;
-	int offbits = 14 + infohd_size + 1024;
+	int colortable_size = BMPWriterConsts::max_8bit_colors * 4;
+	int offbits = 14 + infohd_size + colortable_size;
 	int bitcount = 8;
 	int sizeimage = bmpdat.get_width() * bmpdat.get_height();
 	int fsize = offbits + sizeimage;
@@ -408,16 +633,6 @@ void write_bitmapdata_8bitpalettized_bmp(BitmapData& bmpdat, const std::string&
 	int clrused = BMPWriterConsts::max_8bit_colors;
 	int clrimp = BMPWriterConsts::max_8bit_colors;
 
-	// fill colortable with colors from palette
-	for (int i = 0; i < 1024; i += 4)
-	{
-		colortable[i + 3] = 0;
-		int color = bmpdat.get_palette()[i/4];
-		colortable[i + 2] = color & 0xFF;
-		colortable[i + 1] = (color & 0xFF00) >> 8;
-		colortable[i] = (color & 0xFF0000) >> 16;
-	}
-
 	to_bytes(bmpdat.get_width(), bmphd.bmp_infohd_width, 4, DatManip::le);
 	to_bytes(bmpdat.get_height(), bmphd.bmp_infohd_height, 4, DatManip::le);
 	to_bytes(fsize, bmphd.bmp_filehd_size, 4, DatManip::le);
@@ -430,29 +645,43 @@ void write_bitmapdata_8bitpalettized_bmp(BitmapData& bmpdat, const std::string&
 	to_bytes(clrused, bmphd.bmp_infohd_clrused, 4, DatManip::le);
 	to_bytes(clrimp, bmphd.bmp_infohd_clrimp, 4, DatManip::le);
 
-	std::ofstream ofs(filename.c_str(), std::ios_base::binary);
+	int width = bmpdat.get_width();
+	int height = bmpdat.get_height();
+	int rowsize = (width + 3) & ~3;		// padded to a 4-byte boundary
 
-	write_bmp_header(ofs, bmphd);
-	ofs.write(colortable, BMPWriterConsts::max_8bit_colors * 4);
+	file.assign(offbits + rowsize * height, 0);
+	put_bmp_header(&file[0], bmphd);
 
-	// pixel data
-	for (int i = bmpdat.get_height() - 1; i >= 0; i--)
+	// fill colortable with colors from palette
+	char* colortable = &file[bmp_header_size];
+	for (int i = 0; i < colortable_size; i += 4)
 	{
-		int* rowstart = bmpdat.get_pixels() + i * bmpdat.get_width();
-		for (int j = 0; j < bmpdat.get_width(); j++)
-		{
-			
-			char color = *(rowstart + j);
-			ofs.put(color);
-		}
-		// pad line to 4-byte boundary
-		int padbytes = bmpdat.get_width() % 4;
-		if (padbytes != 0)
-			for (int j = 0; j < 4 - padbytes; j++)
-				ofs.put(0);
+		int color = palette_color(bmpdat.get_palette(), i/4);
+		colortable[i + 2] = color & 0xFF;
+		colortable[i + 1] = (color & 0xFF00) >> 8;
+		colortable[i] = (color & 0xFF0000) >> 16;
+	}
+
+	// pixel data, bottom row first
+	char* putpos = &file[offbits];
+	for (int i = height - 1; i >= 0; i--)
+	{
+		const int* rowstart = bmpdat.get_pixels() + i * width;
+		for (int j = 0; j < width; j++)
+			putpos[j] = static_cast<char>(rowstart[j]);
+		putpos += rowsize;
 	}
 }
 
+void write_bitmapdata_8bitpalettized_bmp(BitmapData& bmpdat, const std::string& filename)
+{
+	std::vector<char> file;
+	encode_bitmapdata_8bitpalettized_bmp(bmpdat, file);
+
+	std::ofstream ofs(filename.c_str(), std::ios_base::binary);
+	ofs.write(&file[0], file.size());
+}
+
 void BitmapData::write(const std::string& filename) {
 	if (palettized && bpp == 8) {
 		write_bitmapdata_8bitpalettized_bmp(*this, filename);
@@ -462,5 +691,14 @@ void BitmapData::write(const std::string& filename) {
 	}
 }
 
+void BitmapData::encode(std::vector<char>& file) {
+	if (palettized && bpp == 8) {
+		encode_bitmapdata_8bitpalettized_bmp(*this, file);
+	}
+	else {
+		encode_bitmapdata_bmp(*this, file);
+	}
+}
+
 
 };	// end namespace RipUtil
@@ -2,7 +2,13 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <cstring>
+#include <algorithm>
+#include "PixelPool.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace RipUtil
 {
@@ -18,26 +24,43 @@ struct DrawPos
 	int y;
 };
 
+// a rectangle of pixels; empty if it has no width or height
+struct DrawRect
+{
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+// the smallest rectangle holding both a and b, leaving out empty ones
+DrawRect enclose_rects(const DrawRect& a, const DrawRect& b);
+
+// Pixel buffers come from the PixelPool and are kept across resizes as long
+// as they're big enough, so a BitmapData that is reused, or one that replaces
+// another of similar size, doesn't go back to the allocator
 class BitmapData
 {
 public:
 	BitmapData()
 		: pixels(0), width(0), height(0), bpp(0),
-		allocation_size(0), palettized(0) { };
+		allocation_size(0), buffer_size(0), palettized(0) { };
 	BitmapData(int w, int h, int bits, bool pal = false)
-		: pixels(0), width(w), height(h), palettized(pal)
+		: pixels(0), width(w), height(h), buffer_size(0), palettized(pal)
 	{
 		resize_pixels(width, height, bits);
 	}
 	BitmapData(const BitmapData& b)
-		: pixels(new int[b.allocation_size]), width(b.width), height(b.height),
-		bpp(b.bpp), allocation_size(b.allocation_size), palettized(b.palettized)
+		: pixels(0), width(b.width), height(b.height), bpp(b.bpp),
+		allocation_size(b.allocation_size), buffer_size(0),
+		palettized(b.palettized), palette(b.palette)
 	{
+		pixels = PixelPool::acquire(allocation_size, buffer_size);
 		std::memcpy(pixels, b.pixels, allocation_size * sizeof(int));
 	}
 	~BitmapData()
 	{
-		delete[] pixels;
+		PixelPool::release(pixels, buffer_size);
 	}
 	BitmapData& operator=(const BitmapData& bmap);
 	int* get_pixels() { return pixels; }
@@ -56,7 +79,8 @@ public:
 
 	// copy the specified portion of the image into an existing BitmapData object
 	const void copy_rect(BitmapData& copy, int x, int y, int w, int h);
-	// destroy existing pixel data and resize to given width/height/bpp
+	// resize to given width/height/bpp; existing pixel data is lost, and
+	// the new pixels are undefined until drawn over or cleared
 	void resize_pixels(int w, int h, int bits);
 	// set palette to 8-bit linear grayscale
 	void set_palette_8bit_grayscale();
@@ -82,6 +106,12 @@ public:
 		int boxx, int boxy, int boxw, int boxh);
 	DrawPos draw_col_wrap(int color, int count, int x, int y,
 		int boxx, int boxy, int boxw, int boxh);
+	// copy a w x h block of row-major or column-major pixel data into the
+	// image at x, y, or out of the image at x, y; the block must lie within
+	// the image
+	void put_rows(const int* src, int x, int y, int w, int h);
+	void put_columns(const int* src, int x, int y, int w, int h);
+	void get_columns(int* dest, int x, int y, int w, int h) const;
 	// blit pixel data of a BitmapData object onto this one,
 	// clipping as necessary
 	void blit_bitmapdata(BitmapData& bmpdat, int xpos, int ypos);
@@ -90,19 +120,168 @@ public:
 	// transparent color
 	void blit_bitmapdata(BitmapData& bmpdat, int xpos, int ypos,
 		int transcolor);
+	// the smallest rectangle holding every pixel within area that isn't
+	// bgcolor, or an empty one if there are none. Only the pixels within
+	// area (clipped to the image) are looked at
+	DrawRect find_bounds(int bgcolor, const DrawRect& area) const;
 	
 	void write(const std::string& filename);
 
+	// the file write() would produce, in memory
+	void encode(std::vector<char>& file);
+
 private:
 	int* pixels;
 	int width;
 	int height;
 	int bpp;
 	int allocation_size;
+	int buffer_size;
 	bool palettized;
 	BitmapPalette palette;
 };
 
+// converts the pixels of an image to 24-bit little endian RGB, through
+// its palette if it's palettized (undefined palette entries are black).
+// Throws DefaultException for non-palettized images of an unsupported bpp
+class BitmapRGBConverter
+{
+public:
+	explicit BitmapRGBConverter(BitmapData& bmpdat);
+
+	int operator()(int pixel) const
+	{
+		if (palettized && static_cast<unsigned int>(pixel) < 256)
+			return colortable[pixel];
+		return convert(pixel);
+	}
+
+private:
+	int convert(int pixel) const;
+
+	const BitmapPalette& palette;
+	bool palettized;
+	int bpp;
+	int colortable[256];
+};
+
+// span primitives: draw count pixels of one color, or count pixels from an
+// array of 8-bit color indices (optionally through a 256-entry table)
+
+inline void fill_pixels(int* dest, int color, int count)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i c = _mm_set1_epi32(color);
+	for ( ; i + 4 <= count; i += 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), c);
+#endif
+	for ( ; i < count; i++)
+		dest[i] = color;
+}
+
+inline void copy_pixels(int* dest, const unsigned char* src, int count)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for ( ; i + 16 <= count; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+		__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+			_mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 4),
+			_mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8),
+			_mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 12),
+			_mm_unpackhi_epi16(hi, zero));
+	}
+#endif
+	for ( ; i < count; i++)
+		dest[i] = src[i];
+}
+
+inline void copy_pixels(int* dest, const unsigned char* src, int count, const int* table)
+{
+	for (int i = 0; i < count; i++)
+		dest[i] = table[src[i]];
+}
+
+// Clipped access to the rows of a box within a bitmap, for decoders that
+// draw a row at a time. The clipping against the box and the image is worked
+// out once when a row is selected; the span functions after that only have
+// to cut runs off at the end of the row
+class BitmapRow
+{
+public:
+	BitmapRow(BitmapData& bmap, int boxx, int boxy, int boxw, int boxh)
+		: bmap(bmap), boxx(boxx), boxy(boxy), boxh(boxh), line(0), limit(0)
+	{
+		// columns of the box that lie within the image
+		if (boxx >= 0 && boxy >= 0)
+			rowlimit = std::max(0, std::min(boxw, bmap.get_width() - boxx));
+		else
+			rowlimit = 0;
+	}
+
+	// select row y of the box, returning false if it isn't drawable
+	bool set_row(int y)
+	{
+		if (y < 0 || y >= boxh || y + boxy >= bmap.get_height() || !rowlimit)
+		{
+			limit = 0;
+			return false;
+		}
+		line = bmap.get_pixels() + boxx + (y + boxy) * bmap.get_width();
+		limit = rowlimit;
+		return true;
+	}
+
+	// number of pixels of a count-pixel run starting at column x that
+	// fall within the row
+	int clip(int x, int count) const
+	{
+		if (x < 0 || x >= limit)
+			return 0;
+		return std::min(count, limit - x);
+	}
+
+	int* at(int x) { return line + x; }
+
+	void fill(int x, int color, int count)
+	{
+		int n = clip(x, count);
+		if (n > 0)
+			fill_pixels(line + x, color, n);
+	}
+
+	void copy(int x, const unsigned char* src, int count)
+	{
+		int n = clip(x, count);
+		if (n > 0)
+			copy_pixels(line + x, src, n);
+	}
+
+	void copy(int x, const unsigned char* src, int count, const int* table)
+	{
+		int n = clip(x, count);
+		if (n > 0)
+			copy_pixels(line + x, src, n, table);
+	}
+
+private:
+	BitmapData& bmap;
+	int boxx;
+	int boxy;
+	int boxh;
+	int rowlimit;
+	int* line;
+	int limit;
+};
+
 namespace BMPWriterConsts
 {
 	const static char bmp_hd_id[2]
@@ -181,6 +360,11 @@ struct BMPHeader
 
 void write_bmp_header(std::ofstream& ofs, const BMPHeader& bmphd);
 
+// build a complete BMP file in file, replacing its contents
+void encode_bitmapdata_bmp(BitmapData& bmpdat, std::vector<char>& file);
+
+void encode_bitmapdata_8bitpalettized_bmp(BitmapData& bmpdat, std::vector<char>& file);
+
 void write_bitmapdata_bmp(BitmapData& bmpdat, const std::string& filename);
 
 void write_bitmapdata_8bitpalettized_bmp(BitmapData& bmpdat, const std::string& filename);
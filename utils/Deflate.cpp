@@ -0,0 +1,621 @@
+#include "Deflate.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace RipUtil
+{
+
+
+namespace
+{
+
+const int window_size = 32768;
+const int min_match = 3;
+const int max_match = 258;
+const int hash_bits = 15;
+const int block_symbols = 16384;	// LZ77 symbols per block
+
+const int num_litlen = 286;
+const int num_dist = 30;
+const int num_codelen = 19;
+const int end_of_block = 256;
+
+const int length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577 };
+const int dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const int codelen_order[num_codelen] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// length (3-258) and distance (1-32768) to deflate code
+class DeflateCodeTables
+{
+public:
+	DeflateCodeTables()
+	{
+		for (int i = 0; i < 29; i++)
+		{
+			int end = (i < 28) ? length_base[i + 1] : max_match + 1;
+			for (int j = length_base[i]; j < end; j++)
+				length_code[j] = i;
+		}
+		for (int i = 0; i < 30; i++)
+		{
+			int end = (i < 29) ? dist_base[i + 1] : window_size + 1;
+			for (int j = dist_base[i]; j < end; j++)
+				dist_code[j] = i;
+		}
+	}
+
+	unsigned char length_code[max_match + 1];
+	unsigned char dist_code[window_size + 1];
+};
+
+const DeflateCodeTables& get_code_tables()
+{
+	static const DeflateCodeTables tables;
+	return tables;
+}
+
+// a literal (dist == 0) or a match
+struct LZSymbol
+{
+	unsigned short litlen;
+	unsigned short dist;
+};
+
+class DeflateBitWriter
+{
+public:
+	DeflateBitWriter(std::vector<char>& o)
+		: out(o), buffer(0), bitcount(0) { };
+
+	// bits go out least significant first
+	void put(unsigned int bits, int nbits)
+	{
+		buffer |= static_cast<unsigned long long>(bits) << bitcount;
+		bitcount += nbits;
+		while (bitcount >= 8)
+		{
+			out.push_back(static_cast<char>(buffer & 0xFF));
+			buffer >>= 8;
+			bitcount -= 8;
+		}
+	}
+
+	void align()
+	{
+		if (bitcount > 0)
+			put(0, 8 - bitcount);
+	}
+
+private:
+	std::vector<char>& out;
+	unsigned long long buffer;
+	int bitcount;
+};
+
+// Huffman code lengths for the given symbol frequencies, no longer than
+// maxbits. Frequencies are halved until the tree fits, which costs little
+// compared to an optimal length-limited code. At least two symbols always
+// get codes, so that every code is complete
+void build_code_lengths(std::vector<int> freqs, int maxbits, std::vector<int>& lengths)
+{
+	int numsyms = freqs.size();
+	lengths.assign(numsyms, 0);
+
+	int used = 0;
+	for (int i = 0; i < numsyms; i++)
+		if (freqs[i])
+			++used;
+	if (used < 2)
+	{
+		for (int i = 0; i < numsyms && used < 2; i++)
+		{
+			if (!freqs[i])
+			{
+				freqs[i] = 1;
+				++used;
+			}
+		}
+	}
+
+	while (true)
+	{
+		typedef std::pair<long long, int> Node;
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node> > queue;
+		std::vector<int> parent(numsyms * 2, -1);
+		for (int i = 0; i < numsyms; i++)
+			if (freqs[i])
+				queue.push(Node(freqs[i], i));
+
+		int next = numsyms;
+		while (queue.size() > 1)
+		{
+			Node a = queue.top();
+			queue.pop();
+			Node b = queue.top();
+			queue.pop();
+			parent[a.second] = next;
+			parent[b.second] = next;
+			queue.push(Node(a.first + b.first, next));
+			++next;
+		}
+
+		// internal nodes are created after their children, so each one's
+		// depth is known before its children are looked at
+		std::vector<int> depth(next, 0);
+		for (int i = next - 2; i >= numsyms; i--)
+			depth[i] = depth[parent[i]] + 1;
+		int longest = 0;
+		for (int i = 0; i < numsyms; i++)
+		{
+			if (freqs[i])
+			{
+				lengths[i] = depth[parent[i]] + 1;
+				longest = std::max(longest, lengths[i]);
+			}
+		}
+
+		if (longest <= maxbits)
+			return;
+		for (int i = 0; i < numsyms; i++)
+			if (freqs[i])
+				freqs[i] = std::max(1, freqs[i] >> 1);
+	}
+}
+
+// canonical codes for a set of code lengths, bit-reversed for output
+void build_codes(const std::vector<int>& lengths, std::vector<unsigned int>& codes)
+{
+	int count[16] = { 0 };
+	for (std::vector<int>::size_type i = 0; i < lengths.size(); i++)
+		++count[lengths[i]];
+	count[0] = 0;
+
+	unsigned int nextcode[16] = { 0 };
+	unsigned int code = 0;
+	for (int bits = 1; bits < 16; bits++)
+	{
+		code = (code + count[bits - 1]) << 1;
+		nextcode[bits] = code;
+	}
+
+	codes.assign(lengths.size(), 0);
+	for (std::vector<int>::size_type i = 0; i < lengths.size(); i++)
+	{
+		int len = lengths[i];
+		if (!len)
+			continue;
+		unsigned int c = nextcode[len]++;
+		unsigned int reversed = 0;
+		for (int j = 0; j < len; j++)
+			reversed |= ((c >> j) & 1) << (len - 1 - j);
+		codes[i] = reversed;
+	}
+}
+
+void fixed_code_lengths(std::vector<int>& litlen, std::vector<int>& dist)
+{
+	litlen.assign(288, 8);
+	for (int i = 144; i < 256; i++)
+		litlen[i] = 9;
+	for (int i = 256; i < 280; i++)
+		litlen[i] = 7;
+	dist.assign(30, 5);
+}
+
+// run-length code the combined code lengths with symbols 16-18;
+// each entry is symbol | (extra bits value << 8)
+void encode_code_lengths(const std::vector<int>& lens, std::vector<int>& syms)
+{
+	syms.clear();
+	int n = lens.size();
+	int i = 0;
+	while (i < n)
+	{
+		int len = lens[i];
+		int run = 1;
+		while (i + run < n && lens[i + run] == len)
+			++run;
+
+		if (len == 0 && run >= 3)
+		{
+			run = std::min(run, 138);
+			if (run >= 11)
+				syms.push_back(18 | ((run - 11) << 8));
+			else
+				syms.push_back(17 | ((run - 3) << 8));
+			i += run;
+		}
+		else if (len != 0 && run >= 4)
+		{
+			// the length itself, then repeats of it
+			syms.push_back(len);
+			int repeats = std::min(run - 1, 6);
+			syms.push_back(16 | ((repeats - 3) << 8));
+			i += repeats + 1;
+		}
+		else
+		{
+			syms.push_back(len);
+			++i;
+		}
+	}
+}
+
+class DeflateEncoder
+{
+public:
+	DeflateEncoder(const unsigned char* d, int n, std::vector<char>& out,
+		DeflateLevel level)
+		: data(d), len(n), bits(out), tables(get_code_tables()),
+		hashbits(8), windowmask(255), nextinsert(0),
+		lazy(level == deflate_strong),
+		maxchain(level == deflate_strong ? 256 : 16),
+		nicelength(level == deflate_strong ? max_match : 32)
+	{
+		// small inputs get small tables, since many of the images are tiny
+		while (hashbits < hash_bits && (1 << hashbits) < len)
+			++hashbits;
+		while (windowmask < window_size - 1 && windowmask < len)
+			windowmask = (windowmask << 1) | 1;
+		head.assign(1 << hashbits, -1);
+		prev.assign(windowmask + 1, -1);
+		symbols.reserve(std::min(block_symbols, len + 1));
+	}
+
+	void compress()
+	{
+		int blockstart = 0;
+		int pos = 0;
+		while (pos < len)
+		{
+			int matchdist = 0;
+			int matchlen = find_match(pos, matchdist);
+			if (matchlen >= min_match && lazy && matchlen < nicelength)
+			{
+				// defer to a longer match starting at the next byte
+				int nextdist = 0;
+				if (find_match(pos + 1, nextdist) > matchlen)
+					matchlen = 0;
+			}
+
+			LZSymbol sym;
+			if (matchlen >= min_match)
+			{
+				sym.litlen = matchlen;
+				sym.dist = matchdist;
+				pos += matchlen;
+			}
+			else
+			{
+				sym.litlen = data[pos];
+				sym.dist = 0;
+				++pos;
+			}
+			symbols.push_back(sym);
+
+			if (static_cast<int>(symbols.size()) >= block_symbols)
+			{
+				flush_block(blockstart, pos, pos == len);
+				blockstart = pos;
+			}
+		}
+
+		if (!symbols.empty() || blockstart == 0)
+			flush_block(blockstart, pos, true);
+		bits.align();
+	}
+
+private:
+	int hash(int pos) const
+	{
+		return ((data[pos] << 10) ^ (data[pos + 1] << 5) ^ data[pos + 2])
+			& ((1 << hashbits) - 1);
+	}
+
+	// add every position before pos to the hash chains
+	void insert_before(int pos)
+	{
+		int end = std::min(pos, len - min_match + 1);
+		for ( ; nextinsert < end; nextinsert++)
+		{
+			int h = hash(nextinsert);
+			prev[nextinsert & windowmask] = head[h];
+			head[h] = nextinsert;
+		}
+	}
+
+	// longest earlier match for the data at pos, or 0 if there isn't one
+	// of at least min_match bytes
+	int find_match(int pos, int& matchdist)
+	{
+		if (pos + min_match > len)
+			return 0;
+		insert_before(pos);
+
+		int maxlen = std::min(max_match, len - pos);
+		const unsigned char* cur = data + pos;
+		int bestlen = min_match - 1;
+		int candidate = head[hash(pos)];
+		for (int chain = 0; candidate >= 0 && chain < maxchain; chain++)
+		{
+			int dist = pos - candidate;
+			if (dist > window_size)
+				break;
+
+			const unsigned char* match = data + candidate;
+			if (match[bestlen] == cur[bestlen] && match[0] == cur[0])
+			{
+				int l = 0;
+				while (l < maxlen && match[l] == cur[l])
+					++l;
+				if (l > bestlen)
+				{
+					bestlen = l;
+					matchdist = dist;
+					if (l >= nicelength || l == maxlen)
+						break;
+				}
+			}
+			candidate = prev[candidate & windowmask];
+		}
+		return (bestlen >= min_match) ? bestlen : 0;
+	}
+
+	void flush_block(int start, int end, bool final)
+	{
+		std::vector<int> litfreqs(num_litlen, 0);
+		std::vector<int> distfreqs(num_dist, 0);
+		for (std::vector<LZSymbol>::size_type i = 0; i < symbols.size(); i++)
+		{
+			const LZSymbol& sym = symbols[i];
+			if (sym.dist)
+			{
+				++litfreqs[257 + tables.length_code[sym.litlen]];
+				++distfreqs[tables.dist_code[sym.dist]];
+			}
+			else
+				++litfreqs[sym.litlen];
+		}
+		litfreqs[end_of_block] = 1;
+
+		// dynamic codes and their header
+		std::vector<int> dynlit, dyndist;
+		build_code_lengths(litfreqs, 15, dynlit);
+		build_code_lengths(distfreqs, 15, dyndist);
+		int hlit = num_litlen;
+		while (hlit > 257 && !dynlit[hlit - 1])
+			--hlit;
+		int hdist = num_dist;
+		while (hdist > 1 && !dyndist[hdist - 1])
+			--hdist;
+		std::vector<int> combined(dynlit.begin(), dynlit.begin() + hlit);
+		combined.insert(combined.end(), dyndist.begin(), dyndist.begin() + hdist);
+		std::vector<int> clsyms;
+		encode_code_lengths(combined, clsyms);
+		std::vector<int> clfreqs(num_codelen, 0);
+		for (std::vector<int>::size_type i = 0; i < clsyms.size(); i++)
+			++clfreqs[clsyms[i] & 0xFF];
+		std::vector<int> cllens;
+		build_code_lengths(clfreqs, 7, cllens);
+		int hclen = num_codelen;
+		while (hclen > 4 && !cllens[codelen_order[hclen - 1]])
+			--hclen;
+
+		long long dyncost = 5 + 5 + 4 + hclen * 3;
+		for (std::vector<int>::size_type i = 0; i < clsyms.size(); i++)
+		{
+			int sym = clsyms[i] & 0xFF;
+			dyncost += cllens[sym] + (sym == 16 ? 2 : (sym == 17 ? 3 : (sym == 18 ? 7 : 0)));
+		}
+		dyncost += symbols_cost(litfreqs, distfreqs, dynlit, dyndist);
+
+		std::vector<int> fixlit, fixdist;
+		fixed_code_lengths(fixlit, fixdist);
+		long long fixcost = symbols_cost(litfreqs, distfreqs, fixlit, fixdist);
+
+		// stored blocks cost their alignment plus 4 bytes of header each
+		int rawlen = end - start;
+		long long storedcost = (rawlen + 4 * std::max(1, (rawlen + 65534) / 65535)) * 8LL + 7;
+
+		if (storedcost < dyncost && storedcost < fixcost)
+			write_stored(start, end, final);
+		else if (fixcost <= dyncost)
+		{
+			bits.put(final ? 1 : 0, 1);
+			bits.put(1, 2);
+			write_symbols(fixlit, fixdist);
+		}
+		else
+		{
+			bits.put(final ? 1 : 0, 1);
+			bits.put(2, 2);
+			bits.put(hlit - 257, 5);
+			bits.put(hdist - 1, 5);
+			bits.put(hclen - 4, 4);
+			for (int i = 0; i < hclen; i++)
+				bits.put(cllens[codelen_order[i]], 3);
+
+			std::vector<unsigned int> clcodes;
+			build_codes(cllens, clcodes);
+			for (std::vector<int>::size_type i = 0; i < clsyms.size(); i++)
+			{
+				int sym = clsyms[i] & 0xFF;
+				int extra = clsyms[i] >> 8;
+				bits.put(clcodes[sym], cllens[sym]);
+				if (sym == 16)
+					bits.put(extra, 2);
+				else if (sym == 17)
+					bits.put(extra, 3);
+				else if (sym == 18)
+					bits.put(extra, 7);
+			}
+			write_symbols(dynlit, dyndist);
+		}
+
+		symbols.clear();
+	}
+
+	long long symbols_cost(const std::vector<int>& litfreqs, const std::vector<int>& distfreqs,
+		const std::vector<int>& litlens, const std::vector<int>& distlens) const
+	{
+		long long cost = 0;
+		for (int i = 0; i < num_litlen; i++)
+		{
+			if (!litfreqs[i])
+				continue;
+			cost += static_cast<long long>(litfreqs[i])
+				* (litlens[i] + (i > end_of_block ? length_extra[i - 257] : 0));
+		}
+		for (int i = 0; i < num_dist; i++)
+			cost += static_cast<long long>(distfreqs[i]) * (distlens[i] + dist_extra[i]);
+		return cost;
+	}
+
+	void write_symbols(const std::vector<int>& litlens, const std::vector<int>& distlens)
+	{
+		std::vector<unsigned int> litcodes, distcodes;
+		build_codes(litlens, litcodes);
+		build_codes(distlens, distcodes);
+
+		for (std::vector<LZSymbol>::size_type i = 0; i < symbols.size(); i++)
+		{
+			const LZSymbol& sym = symbols[i];
+			if (!sym.dist)
+			{
+				bits.put(litcodes[sym.litlen], litlens[sym.litlen]);
+				continue;
+			}
+
+			int lcode = tables.length_code[sym.litlen];
+			bits.put(litcodes[257 + lcode], litlens[257 + lcode]);
+			if (length_extra[lcode])
+				bits.put(sym.litlen - length_base[lcode], length_extra[lcode]);
+
+			int dcode = tables.dist_code[sym.dist];
+			bits.put(distcodes[dcode], distlens[dcode]);
+			if (dist_extra[dcode])
+				bits.put(sym.dist - dist_base[dcode], dist_extra[dcode]);
+		}
+		bits.put(litcodes[end_of_block], litlens[end_of_block]);
+	}
+
+	void write_stored(int start, int end, bool final)
+	{
+		do
+		{
+			int n = std::min(end - start, 65535);
+			bool last = final && start + n == end;
+			bits.put(last ? 1 : 0, 1);
+			bits.put(0, 2);
+			bits.align();
+			bits.put(n & 0xFFFF, 16);
+			bits.put(~n & 0xFFFF, 16);
+			for (int i = 0; i < n; i++)
+				bits.put(data[start + i], 8);
+			start += n;
+		} while (start < end);
+	}
+
+	const unsigned char* data;
+	int len;
+	DeflateBitWriter bits;
+	const DeflateCodeTables& tables;
+	int hashbits;
+	int windowmask;
+	std::vector<int> head;
+	std::vector<int> prev;
+	int nextinsert;
+	std::vector<LZSymbol> symbols;
+	bool lazy;
+	int maxchain;
+	int nicelength;
+};
+
+};
+
+unsigned int adler32(const unsigned char* data, int len, unsigned int adler)
+{
+	unsigned int a = adler & 0xFFFF;
+	unsigned int b = adler >> 16;
+	while (len > 0)
+	{
+		// largest run that can't overflow before the modulo
+		int n = std::min(len, 5552);
+		for (int i = 0; i < n; i++)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += n;
+		len -= n;
+	}
+	return (b << 16) | a;
+}
+
+namespace
+{
+
+class CRCTable
+{
+public:
+	CRCTable()
+	{
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			unsigned int c = i;
+			for (int j = 0; j < 8; j++)
+				c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+			table[i] = c;
+		}
+	}
+
+	unsigned int table[256];
+};
+
+};
+
+unsigned int crc32(const char* data, int len, unsigned int crc)
+{
+	static const CRCTable crctable;
+	crc = ~crc;
+	for (int i = 0; i < len; i++)
+		crc = crctable.table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+void zlib_compress(const unsigned char* data, int len, std::vector<char>& out,
+	DeflateLevel level)
+{
+	// 32K window, deflate; the level hint is informational only
+	out.push_back(0x78);
+	out.push_back(level == deflate_strong ? static_cast<char>(0xDA) : 0x01);
+
+	DeflateEncoder encoder(data, len, out, level);
+	encoder.compress();
+
+	unsigned int adler = adler32(data, len);
+	out.push_back(static_cast<char>(adler >> 24));
+	out.push_back(static_cast<char>(adler >> 16));
+	out.push_back(static_cast<char>(adler >> 8));
+	out.push_back(static_cast<char>(adler));
+}
+
+
+};	// end namespace RipUtil
@@ -0,0 +1,30 @@
+/* Compressor for the deflate format (RFC 1951) in a zlib wrapper
+   (RFC 1950), as used by PNG, and the checksums that go with it */
+
+#include <vector>
+
+namespace RipUtil
+{
+
+
+enum DeflateLevel
+{
+	deflate_fast,		// short hash chains, greedy matching
+	deflate_strong		// long hash chains, lazy matching
+};
+
+// compress len bytes of data into a zlib stream, appended to out.
+// Each block is emitted with dynamic or fixed Huffman codes, or stored,
+// whichever comes out smallest
+void zlib_compress(const unsigned char* data, int len, std::vector<char>& out,
+	DeflateLevel level);
+
+unsigned int adler32(const unsigned char* data, int len, unsigned int adler = 1);
+
+// the CRC-32 used by PNG, zip and gzip
+unsigned int crc32(const char* data, int len, unsigned int crc = 0);
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
@@ -3,11 +3,33 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 
 namespace ErrLog
 {
 
 
+	// Messages logged by a thread while it has a capture set (see
+	// ErrorLog::set_capture) are kept here instead of being written, to be
+	// replayed later; work done on several threads at once can then be
+	// logged as if it had been done in turn
+	struct LogCapture
+	{
+		enum Kind
+		{
+			print_msg, qprint_msg, printnb_msg, qprintnb_msg,
+			error_msg, qerror_msg, warning_msg, qwarning_msg
+		};
+
+		struct Entry
+		{
+			Kind kind;
+			std::string text;
+		};
+
+		std::vector<Entry> entries;
+	};
+
 	class ErrorLog
 	{
 	public:
@@ -48,8 +70,36 @@ namespace ErrLog
 		void close() { ofs.close(); };
 		std::string gettarget() { return target; }
 
+		// keep the calling thread's messages in capture until this is
+		// called again with 0; applies to every ErrorLog
+		static void set_capture(LogCapture* capture) { thread_capture() = capture; }
+
+		// log the messages kept in capture, in order, and forget them
+		void replay(LogCapture& capture)
+		{
+			for (std::vector<LogCapture::Entry>::size_type i = 0;
+				i < capture.entries.size(); i++)
+			{
+				const std::string& e = capture.entries[i].text;
+				switch (capture.entries[i].kind)
+				{
+				case LogCapture::print_msg: print(e); break;
+				case LogCapture::qprint_msg: qprint(e); break;
+				case LogCapture::printnb_msg: printnb(e); break;
+				case LogCapture::qprintnb_msg: qprintnb(e); break;
+				case LogCapture::error_msg: error(e); break;
+				case LogCapture::qerror_msg: qerror(e); break;
+				case LogCapture::warning_msg: warning(e); break;
+				case LogCapture::qwarning_msg: qwarning(e); break;
+				}
+			}
+			capture.entries.clear();
+		}
+
 		void print(std::string e)
 		{
+			if (captured(LogCapture::print_msg, e))
+				return;
 			if (!disabled)
 			{
 				std::cout << e << '\n';
@@ -61,6 +111,8 @@ namespace ErrLog
 
 		void qprint(std::string e)
 		{
+			if (captured(LogCapture::qprint_msg, e))
+				return;
 			if (!disabled)
 			{
 				if (!ofs.is_open()) 
@@ -71,6 +123,8 @@ namespace ErrLog
 
 		void printnb(std::string e)
 		{
+			if (captured(LogCapture::printnb_msg, e))
+				return;
 			if (!disabled)
 			{
 				std::cout << e << '\n';
@@ -82,6 +136,8 @@ namespace ErrLog
 
 		void qprintnb(std::string e)
 		{
+			if (captured(LogCapture::qprintnb_msg, e))
+				return;
 			if (!disabled)
 			{
 				if (!ofs.is_open()) 
@@ -92,6 +148,8 @@ namespace ErrLog
 
 		void error(std::string e)
 		{
+			if (captured(LogCapture::error_msg, e))
+				return;
 			if (!disabled)
 			{
 				errflag = true;
@@ -105,6 +163,8 @@ namespace ErrLog
 
 		void qerror(std::string e)
 		{
+			if (captured(LogCapture::qerror_msg, e))
+				return;
 			if (!disabled)
 			{
 				errflag = true;
@@ -117,6 +177,8 @@ namespace ErrLog
 
 		void warning(std::string w)
 		{
+			if (captured(LogCapture::warning_msg, w))
+				return;
 			if (!disabled)
 			{
 				warnflag = true;
@@ -130,6 +192,8 @@ namespace ErrLog
 
 		void qwarning(std::string w)
 		{
+			if (captured(LogCapture::qwarning_msg, w))
+				return;
 			if (!disabled)
 			{
 				warnflag = true;
@@ -141,6 +205,24 @@ namespace ErrLog
 		}
 
 	private:
+		static LogCapture*& thread_capture()
+		{
+			static thread_local LogCapture* capture = 0;
+			return capture;
+		}
+
+		bool captured(LogCapture::Kind kind, const std::string& e)
+		{
+			LogCapture* capture = thread_capture();
+			if (!capture)
+				return false;
+			LogCapture::Entry entry;
+			entry.kind = kind;
+			entry.text = e;
+			capture->entries.push_back(entry);
+			return true;
+		}
+
 		std::ofstream ofs;
 		std::string target;
 		bool disabled;
@@ -10,7 +10,8 @@ namespace RipUtil
 
 
 MembufStream::MembufStream(const std::string& fname, Fmode mode, char decoder, int buffersize)
-	: filename(fname), buf(0), bufsize(0), eof_flag(false), decoding_byte(decoder)
+	: filename(fname), buf(0), bufsize(0), eof_flag(false), decoding_byte(decoder),
+	memdata(0)
 {
 	// open stream to file
 	switch(mode) 
@@ -44,6 +45,41 @@ MembufStream::MembufStream(const std::string& fname, Fmode mode, char decoder, i
 	}
 }
 
+MembufStream::MembufStream(const char* data, int size, const std::string& fname,
+	char decoder, int buffersize)
+	: buf(0), filename(fname), bufsize(0), fsize(size), fmode(rb),
+	eof_flag(false), decoding_byte(decoder), memdata(data)
+{
+	if (buffersize == -1 || buffersize > fsize) 
+		maxbufsize = fsize;
+	else 
+		maxbufsize = buffersize;
+	fill_buffer(0);
+	gpos = 0;
+	buf_gpos = 0;
+}
+
+MembufStream::MembufStream(const MembufStream& other, int pos, int buffersize)
+	: buf(0), filename(other.filename), bufsize(0), fsize(other.fsize),
+	fmode(other.fmode), eof_flag(false), decoding_byte(other.decoding_byte),
+	memdata(other.memdata)
+{
+	if (!memdata)
+	{
+		stream.open(filename.c_str(), std::ios_base::binary);
+		if (!stream.good()) throw(FileOpenException(filename));
+	}
+	if (buffersize == -1 || buffersize > fsize) 
+		maxbufsize = fsize;
+	else 
+		maxbufsize = buffersize;
+	// start where the reading will, rather than seeking there
+	fill_buffer(pos);
+	gpos = pos;
+	buf_gpos = 0;
+	eof_flag = (gpos >= fsize);
+}
+
 MembufStream::~MembufStream() 
 {
 	delete[] buf;
@@ -51,6 +87,20 @@ MembufStream::~MembufStream()
 
 char* MembufStream::fill_buffer(int pos) 
 {
+	if (memdata)
+	{
+		int newsize = std::min(maxbufsize, fsize - pos);
+		delete[] buf;
+		buf = 0;
+		bufsize = std::max(newsize, 0);
+		if (bufsize)
+		{
+			buf = new char[bufsize];
+			std::memcpy(buf, memdata + pos, bufsize);
+		}
+		return buf;
+	}
+
 	// calculate size of new buffer
 	int nextbufpos = pos + maxbufsize;
 	if (nextbufpos <= fsize) 
@@ -197,6 +247,16 @@ int MembufStream::read_int(int n, DatManip::End e)
 
 int MembufStream::reset()
 {
+	if (memdata)
+	{
+		eof_flag = false;
+		decoding_byte = 0;
+		fill_buffer(0);
+		gpos = 0;
+		buf_gpos = 0;
+		return gpos;
+	}
+
 	stream.close();
 	if (eof()) eof_clear();
 	decoding_byte = 0;
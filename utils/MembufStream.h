@@ -33,6 +33,14 @@ public:
 
 	MembufStream(const std::string& fname, Fmode mode, char decoder = 0,
 		int buffersize = def_bufsize);
+	// read from size bytes of memory instead of a file, which must outlive
+	// the stream; fname is only used as the name
+	MembufStream(const char* data, int size, const std::string& fname,
+		char decoder = 0, int buffersize = def_bufsize);
+	// another stream over the same file or memory as other, with the same
+	// decoding byte but its own buffer, filled from pos, and position, so
+	// that the two can be read on different threads
+	MembufStream(const MembufStream& other, int pos, int buffersize);
 	~MembufStream();
 	
 	std::string get_fname() { return filename; }
@@ -96,6 +104,7 @@ private:
 	std::ifstream stream;	// ifstream for file access
 	bool eof_flag;			// true if EOF reached
 	char decoding_byte;		// optional XOR decoding byte
+	const char* memdata;	// data being read, if not reading from a file
 
 	// starting from pos, refill buffer and update buf pointer
 	// return pointer to the new buffer
@@ -0,0 +1,327 @@
+#include "OutputSink.h"
+#include "XXHash.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace RipUtil
+{
+
+
+void FileSink::put(const std::string& filename, std::vector<char>& data)
+{
+	std::ofstream ofs(filename.c_str(), std::ios_base::binary);
+	if (data.size())
+		ofs.write(&data[0], data.size());
+}
+
+FileSink::~FileSink()
+{
+	finish();
+}
+
+void FileSink::append(const std::string& filename, std::vector<char>& data)
+{
+	std::ofstream*& ofs = appended[filename];
+	if (!ofs)
+		ofs = new std::ofstream(filename.c_str(),
+			std::ios_base::binary | std::ios_base::trunc);
+	if (data.size())
+		ofs->write(&data[0], data.size());
+}
+
+void FileSink::finish()
+{
+	for (std::map<std::string, std::ofstream*>::iterator it = appended.begin();
+		it != appended.end(); ++it)
+		delete (*it).second;
+	appended.clear();
+}
+
+void NullSink::put(const std::string& filename, std::vector<char>& data)
+{
+	++files;
+	add(filename, data);
+}
+
+void NullSink::append(const std::string& filename, std::vector<char>& data)
+{
+	add(filename, data);
+}
+
+void NullSink::add(const std::string& filename, const std::vector<char>& data)
+{
+	bytes += data.size();
+	if (!hashing)
+		return;
+
+	// chain each file onto the digest, name first
+	digest = xxh64(filename.c_str(), filename.size(), digest);
+	digest = xxh64(data.size() ? &data[0] : 0, data.size(), digest);
+}
+
+DedupSink::DedupSink(OutputSink& nextsink, Mode dedupmode,
+	const std::string& duplicatesfile, const std::string& hashstorefile)
+	: next(nextsink), mode(dedupmode),
+	duplicates_file(duplicatesfile), hashstore_file(hashstorefile),
+	duplicates(0), bytes_saved(0)
+{
+	if (hashstore_file.empty())
+		return;
+
+	// one file per line: hash, size, name
+	std::ifstream ifs(hashstore_file.c_str());
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		std::istringstream iss(line);
+		ContentKey key;
+		std::string name;
+		if (!(iss >> std::hex >> key.first >> std::dec >> key.second))
+			continue;
+		iss >> std::ws;
+		std::getline(iss, name);
+		if (name.size())
+			stored[key] = name;
+	}
+}
+
+bool DedupSink::stored_file_matches(const std::string& stored,
+	const std::vector<char>& data) const
+{
+	std::ifstream ifs(stored.c_str(), std::ios_base::binary);
+	if (!ifs)
+		return false;
+
+	std::vector<char> contents(data.size() + 1);
+	ifs.read(contents.size() ? &contents[0] : 0, contents.size());
+	return ifs.gcount() == (std::streamsize)data.size()
+		&& (data.empty() || std::memcmp(&contents[0], &data[0], data.size()) == 0);
+}
+
+void DedupSink::put(const std::string& filename, std::vector<char>& data)
+{
+	ContentKey key(xxh64(data.size() ? &data[0] : 0, data.size()), data.size());
+
+	// find an earlier copy of the same contents
+	std::string original;
+	ContentMap::const_iterator seen_it = seen.find(key);
+	if (seen_it != seen.end())
+		original = (*seen_it).second;
+	else
+	{
+		ContentMap::const_iterator stored_it = stored.find(key);
+		if (stored_it != stored.end() && (*stored_it).second != filename
+			&& stored_file_matches((*stored_it).second, data))
+			original = (*stored_it).second;
+	}
+
+	if (original.size() && original != filename)
+	{
+		bool linked = false;
+		if (mode == dedup_link)
+		{
+			std::error_code ec;
+			std::filesystem::remove(filename, ec);
+			std::filesystem::create_hard_link(original, filename, ec);
+			linked = !ec;
+		}
+
+		if (mode == dedup_reference || linked)
+		{
+			std::string entry = filename + '\t' + original + '\n';
+			duplicates_list.insert(duplicates_list.end(), entry.begin(), entry.end());
+			++duplicates;
+			bytes_saved += data.size();
+			return;
+		}
+	}
+
+	// a file left over from an earlier run may be linked to others, so
+	// unlink it instead of writing through it
+	if (mode == dedup_link)
+		std::remove(filename.c_str());
+
+	if (seen_it == seen.end())
+		seen[key] = filename;
+	next.put(filename, data);
+}
+
+void DedupSink::append(const std::string& filename, std::vector<char>& data)
+{
+	next.append(filename, data);
+}
+
+void DedupSink::finish()
+{
+	if (duplicates_list.size())
+		next.put(duplicates_file, duplicates_list);
+
+	if (hashstore_file.size())
+	{
+		// this run's files take precedence over stored ones
+		for (ContentMap::const_iterator it = seen.begin(); it != seen.end(); ++it)
+			stored[(*it).first] = (*it).second;
+
+		std::ofstream ofs(hashstore_file.c_str(), std::ios_base::trunc);
+		char hash[17];
+		for (ContentMap::const_iterator it = stored.begin(); it != stored.end(); ++it)
+		{
+			std::sprintf(hash, "%016llx", (*it).first.first);
+			ofs << hash << ' ' << (*it).first.second << ' ' << (*it).second << '\n';
+		}
+	}
+
+	next.finish();
+}
+
+void RecordingSink::put(const std::string& filename, std::vector<char>& data)
+{
+	Record record;
+	record.filename = filename;
+	record.size = data.size();
+	record.hash = xxh64(data.size() ? &data[0] : 0, data.size());
+	records.push_back(record);
+
+	next.put(filename, data);
+}
+
+void RecordingSink::append(const std::string& filename, std::vector<char>& data)
+{
+	next.append(filename, data);
+}
+
+void RecordingSink::finish()
+{
+	next.finish();
+}
+
+void RecordingSink::take_records(std::vector<Record>& out)
+{
+	out.clear();
+	out.swap(records);
+}
+
+void BufferSink::put(const std::string& filename, std::vector<char>& data)
+{
+	add(filename, data, false);
+}
+
+void BufferSink::append(const std::string& filename, std::vector<char>& data)
+{
+	add(filename, data, true);
+}
+
+void BufferSink::add(const std::string& filename, std::vector<char>& data, bool append)
+{
+	jobs.push_back(Job());
+	Job& job = jobs.back();
+	job.filename = filename;
+	job.data.swap(data);
+	job.append = append;
+}
+
+void BufferSink::replay(OutputSink& sink)
+{
+	for (std::vector<Job>::size_type i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].append)
+			sink.append(jobs[i].filename, jobs[i].data);
+		else
+			sink.put(jobs[i].filename, jobs[i].data);
+	}
+	jobs.clear();
+}
+
+AsyncSink::AsyncSink(OutputSink& nextsink, long long maxqueued)
+	: next(nextsink), max_queued(maxqueued), queued(0), stopping(false),
+	writer(&AsyncSink::writer_loop, this)
+{
+
+}
+
+AsyncSink::~AsyncSink()
+{
+	stop();
+}
+
+void AsyncSink::enqueue(const std::string& filename, std::vector<char>& data,
+	bool append)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	// a file bigger than the whole queue still goes through on its own
+	while (queued > 0 && queued + (long long)data.size() > max_queued)
+		jobs_taken.wait(lock);
+
+	jobs.push_back(Job());
+	Job& job = jobs.back();
+	job.filename = filename;
+	job.data.swap(data);
+	job.append = append;
+	queued += job.data.size();
+	jobs_added.notify_one();
+}
+
+void AsyncSink::put(const std::string& filename, std::vector<char>& data)
+{
+	enqueue(filename, data, false);
+}
+
+void AsyncSink::append(const std::string& filename, std::vector<char>& data)
+{
+	enqueue(filename, data, true);
+}
+
+void AsyncSink::writer_loop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		while (jobs.empty() && !stopping)
+			jobs_added.wait(lock);
+		if (jobs.empty())
+			return;
+
+		// write without holding the lock, so more files can be queued;
+		// the job stays counted against the queue until it's written
+		Job job;
+		job.filename.swap(jobs.front().filename);
+		job.data.swap(jobs.front().data);
+		job.append = jobs.front().append;
+		jobs.pop_front();
+		long long size = job.data.size();
+		lock.unlock();
+
+		if (job.append)
+			next.append(job.filename, job.data);
+		else
+			next.put(job.filename, job.data);
+
+		lock.lock();
+		queued -= size;
+		jobs_taken.notify_all();
+	}
+}
+
+void AsyncSink::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		jobs_added.notify_one();
+	}
+	if (writer.joinable())
+		writer.join();
+}
+
+void AsyncSink::finish()
+{
+	stop();
+	next.finish();
+}
+
+
+};	// end namespace RipUtil
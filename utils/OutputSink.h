@@ -0,0 +1,221 @@
+/* Destinations for the files produced by a rip. Rippers hand each finished
+   file to a sink, which decides how (and whether) it ends up on disk */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+
+namespace RipUtil
+{
+
+
+class OutputSink
+{
+public:
+	virtual ~OutputSink() { };
+
+	// store a complete file; the sink may take over the contents of data
+	virtual void put(const std::string& filename, std::vector<char>& data) = 0;
+
+	// add data to the end of a file built up over the rip; the first
+	// append to a file replaces anything left from an earlier rip
+	virtual void append(const std::string& filename, std::vector<char>& data) = 0;
+
+	// called once when no more files are coming
+	virtual void finish() { };
+};
+
+// Writes each file to disk as it arrives. Files built up by append() are
+// kept open (and buffered) until finish()
+class FileSink : public OutputSink
+{
+public:
+	~FileSink();
+
+	void put(const std::string& filename, std::vector<char>& data);
+	void append(const std::string& filename, std::vector<char>& data);
+	void finish();
+
+protected:
+	std::map<std::string, std::ofstream*> appended;
+};
+
+// Throws files away, counting them and their bytes. If hashing, also
+// keeps a digest of every file's name and contents in the order they
+// arrive (appends included), to check that two rips produce the same output
+class NullSink : public OutputSink
+{
+public:
+	explicit NullSink(bool hashfiles)
+		: hashing(hashfiles), files(0), bytes(0), digest(0) { };
+
+	void put(const std::string& filename, std::vector<char>& data);
+	void append(const std::string& filename, std::vector<char>& data);
+
+	int get_files() const { return files; }
+	long long get_bytes() const { return bytes; }
+	unsigned long long get_digest() const { return digest; }
+
+protected:
+	void add(const std::string& filename, const std::vector<char>& data);
+
+	bool hashing;
+	int files;
+	long long bytes;
+	unsigned long long digest;
+};
+
+// Passes files on to another sink, except for files whose contents (by XXH64
+// and size) have been seen before. In link mode, a repeat becomes a hard link
+// to the first copy, which must be on disk already (so the next sink should
+// write files directly); if that fails it's written normally. In reference
+// mode it's left out, and listed with the file it repeats in a tab-separated
+// duplicates file put to the next sink by finish(). Appends are passed on
+// unchanged.
+// A hash store file, if given, is read at construction and rewritten by
+// finish(), so repeats of files from earlier runs are recognized too;
+// those are only used if the file is still on disk with the same contents
+class DedupSink : public OutputSink
+{
+public:
+	enum Mode
+	{
+		dedup_link,
+		dedup_reference
+	};
+
+	DedupSink(OutputSink& nextsink, Mode dedupmode,
+		const std::string& duplicatesfile, const std::string& hashstorefile);
+
+	void put(const std::string& filename, std::vector<char>& data);
+	void append(const std::string& filename, std::vector<char>& data);
+	void finish();
+
+	int get_duplicates() const { return duplicates; }
+	long long get_bytes_saved() const { return bytes_saved; }
+
+protected:
+	typedef std::pair<unsigned long long, unsigned long long> ContentKey;
+
+	// first file seen with each content, this run and from the hash store
+	typedef std::map<ContentKey, std::string> ContentMap;
+
+	// stored, if it's still a copy of data
+	bool stored_file_matches(const std::string& stored,
+		const std::vector<char>& data) const;
+
+	OutputSink& next;
+	Mode mode;
+	std::string duplicates_file;
+	std::string hashstore_file;
+
+	ContentMap seen;
+	ContentMap stored;
+	std::vector<char> duplicates_list;
+
+	int duplicates;
+	long long bytes_saved;
+};
+
+// Passes files on to another sink, keeping the name, size and XXH64 of
+// each one put (appends aren't recorded) until they're taken
+class RecordingSink : public OutputSink
+{
+public:
+	struct Record
+	{
+		std::string filename;
+		long long size;
+		unsigned long long hash;
+	};
+
+	explicit RecordingSink(OutputSink& nextsink)
+		: next(nextsink) { };
+
+	void put(const std::string& filename, std::vector<char>& data);
+	void append(const std::string& filename, std::vector<char>& data);
+	void finish();
+
+	// move the records made since the last call into out
+	void take_records(std::vector<Record>& out);
+
+protected:
+	OutputSink& next;
+	std::vector<Record> records;
+};
+
+// Keeps the files put and appended to it, in the order they came in, until
+// they're replayed into another sink. Lets output made on one thread be
+// passed on by another, in a chosen order
+class BufferSink : public OutputSink
+{
+public:
+	void put(const std::string& filename, std::vector<char>& data);
+	void append(const std::string& filename, std::vector<char>& data);
+
+	// hand everything kept to sink, in order, and forget it
+	void replay(OutputSink& sink);
+
+protected:
+	struct Job
+	{
+		std::string filename;
+		std::vector<char> data;
+		bool append;
+	};
+
+	void add(const std::string& filename, std::vector<char>& data, bool append);
+
+	std::vector<Job> jobs;
+};
+
+// Hands files to another sink on a writer thread, so that the ripper can
+// go on decoding while earlier files are written. Files are taken over
+// (data is left empty) and passed on in the order they came in. Once more
+// than maxqueued bytes are waiting, put() and append() wait for the writer
+// to catch up. The next sink is only called from the writer thread until
+// finish(), which waits for the queue to empty and then finishes the next
+// sink on the calling thread
+class AsyncSink : public OutputSink
+{
+public:
+	AsyncSink(OutputSink& nextsink, long long maxqueued);
+	~AsyncSink();
+
+	void put(const std::string& filename, std::vector<char>& data);
+	void append(const std::string& filename, std::vector<char>& data);
+	void finish();
+
+protected:
+	struct Job
+	{
+		std::string filename;
+		std::vector<char> data;
+		bool append;
+	};
+
+	void enqueue(const std::string& filename, std::vector<char>& data, bool append);
+	void writer_loop();
+	void stop();
+
+	OutputSink& next;
+	long long max_queued;
+
+	std::deque<Job> jobs;
+	long long queued;		// bytes waiting in jobs
+	bool stopping;
+	std::mutex mutex;
+	std::condition_variable jobs_added;
+	std::condition_variable jobs_taken;
+	std::thread writer;
+};
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
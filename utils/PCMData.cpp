@@ -302,7 +302,17 @@ void PCMData::normalize()
 	delete[] bytes;
 }
 
-void write_pcmdata_wave(PCMData& dat, const std::string& outfile,
+namespace
+{
+
+void append_bytes(std::vector<char>& file, const char* bytes, int len)
+{
+	file.insert(file.end(), bytes, bytes + len);
+}
+
+};
+
+void encode_pcmdata_wave(PCMData& dat, std::vector<char>& file,
 	int ignorebytes, int ignoreend)
 {
 	// disallow negative ignore values
@@ -311,8 +321,6 @@ void write_pcmdata_wave(PCMData& dat, const std::string& outfile,
 
 	int size = std::max(0, dat.get_wavesize() - ignorebytes - ignoreend);
 
-	std::ofstream ofs(outfile.c_str(), std::ios_base::binary);
-	if (!ofs) throw(DefaultException("error writing to file"));
 	// RIFF header
 	// chunk id: "RIFF"
 	char chunksize[4];
@@ -349,32 +357,45 @@ void write_pcmdata_wave(PCMData& dat, const std::string& outfile,
 	swap_end(bitspersample, 2);
 	swap_end(subchunk2size, 4);
 
-	// write data
-	ofs.write(WaveWriterConsts::riff_chunk_id, 4);
-	ofs.write(chunksize, 4);
-	ofs.write(WaveWriterConsts::riff_format_id, 4);
-	ofs.write(WaveWriterConsts::riff_schunk1_id, 4);
-	ofs.write(subchunk1size, 4);
-	ofs.write(audioformat, 2);
-	ofs.write(numchannels, 2);
-	ofs.write(samplerate, 4);
-	ofs.write(byterate, 4);
-	ofs.write(blockalign, 2);
-	ofs.write(bitspersample, 2);
-	ofs.write(WaveWriterConsts::riff_schunk2_id, 4);
-	ofs.write(subchunk2size, 4);
+	// build file
+	file.clear();
+	file.reserve(44 + size);
+	append_bytes(file, WaveWriterConsts::riff_chunk_id, 4);
+	append_bytes(file, chunksize, 4);
+	append_bytes(file, WaveWriterConsts::riff_format_id, 4);
+	append_bytes(file, WaveWriterConsts::riff_schunk1_id, 4);
+	append_bytes(file, subchunk1size, 4);
+	append_bytes(file, audioformat, 2);
+	append_bytes(file, numchannels, 2);
+	append_bytes(file, samplerate, 4);
+	append_bytes(file, byterate, 4);
+	append_bytes(file, blockalign, 2);
+	append_bytes(file, bitspersample, 2);
+	append_bytes(file, WaveWriterConsts::riff_schunk2_id, 4);
+	append_bytes(file, subchunk2size, 4);
 
 	if (dat.get_end() == DatManip::be)
 	{
 		dat.convert_endianess(DatManip::le);
-		ofs.write(dat.get_waveform() + ignorebytes, 
+		append_bytes(file, dat.get_waveform() + ignorebytes, 
 			size);
 		dat.convert_endianess(DatManip::be);
 	}
 	else
-		ofs.write(dat.get_waveform() + ignorebytes,
+		append_bytes(file, dat.get_waveform() + ignorebytes,
 			size);
 }
 
+void write_pcmdata_wave(PCMData& dat, const std::string& outfile,
+	int ignorebytes, int ignoreend)
+{
+	std::ofstream ofs(outfile.c_str(), std::ios_base::binary);
+	if (!ofs) throw(DefaultException("error writing to file"));
+
+	std::vector<char> file;
+	encode_pcmdata_wave(dat, file, ignorebytes, ignoreend);
+	ofs.write(&file[0], file.size());
+}
+
 
 };	// end namespace RipUtil
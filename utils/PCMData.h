@@ -4,6 +4,7 @@
 #include <cstring>
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include "datmanip.h"
 
@@ -145,6 +146,10 @@ private:
 	int loopend;
 };
 
+// build a RIFF WAVE file from PCMData in file, replacing its contents
+void encode_pcmdata_wave(PCMData& dat, std::vector<char>& file,
+	int ignorebytes = 0, int ignoreend = 0);
+
 // write out PCMData as a RIFF WAVE file
 void write_pcmdata_wave(PCMData& dat, const std::string& outfile,
 	int ignorebytes = 0, int ignoreend = 0);
@@ -0,0 +1,226 @@
+#include "PNGWriter.h"
+
+#include "datmanip.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+namespace RipUtil
+{
+
+
+namespace
+{
+
+const unsigned char png_signature[8]
+	= { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+const int png_color_indexed = 3;
+const int png_color_truecolor = 2;
+
+void put_int_be(std::vector<char>& out, unsigned int val)
+{
+	out.push_back(static_cast<char>(val >> 24));
+	out.push_back(static_cast<char>(val >> 16));
+	out.push_back(static_cast<char>(val >> 8));
+	out.push_back(static_cast<char>(val));
+}
+
+// length, type, data, and CRC of type and data
+void put_chunk(std::vector<char>& out, const char* type, const char* data, int len)
+{
+	put_int_be(out, len);
+	int crcstart = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + len);
+	put_int_be(out, crc32(&out[crcstart], len + 4, 0));
+}
+
+// Paeth predictor from the PNG spec
+inline int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = std::abs(p - a);
+	int pb = std::abs(p - b);
+	int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return a;
+	if (pb <= pc)
+		return b;
+	return c;
+}
+
+// filter a row of truecolor data, trying every filter type and keeping
+// the one with the smallest sum of absolute differences
+// (the heuristic the PNG spec suggests for truecolor images)
+void filter_row(const unsigned char* row, const unsigned char* prior, int rowbytes,
+	int pixbytes, unsigned char* dest, std::vector<unsigned char>& scratch)
+{
+	scratch.resize(rowbytes);
+	long bestsum = -1;
+	for (int type = 0; type < 5; type++)
+	{
+		long sum = 0;
+		for (int i = 0; i < rowbytes; i++)
+		{
+			int a = (i >= pixbytes) ? row[i - pixbytes] : 0;
+			int b = prior ? prior[i] : 0;
+			int c = (prior && i >= pixbytes) ? prior[i - pixbytes] : 0;
+			int pred = 0;
+			switch (type)
+			{
+			case 1: pred = a; break;
+			case 2: pred = b; break;
+			case 3: pred = (a + b) >> 1; break;
+			case 4: pred = paeth(a, b, c); break;
+			}
+			unsigned char f = static_cast<unsigned char>(row[i] - pred);
+			scratch[i] = f;
+			sum += (f < 128) ? f : 256 - f;
+		}
+		if (bestsum < 0 || sum < bestsum)
+		{
+			bestsum = sum;
+			dest[0] = type;
+			std::memcpy(dest + 1, &scratch[0], rowbytes);
+		}
+	}
+}
+
+};
+
+void encode_bitmapdata_png(BitmapData& bmpdat, std::vector<char>& out,
+	const PNGSettings& settings)
+{
+	int width = bmpdat.get_width();
+	int height = bmpdat.get_height();
+	const int* pixels = bmpdat.get_pixels();
+	int emptypixel = settings.transind;
+	if (width <= 0 || height <= 0)
+	{
+		width = 1;
+		height = 1;
+		pixels = &emptypixel;
+	}
+	int numpix = width * height;
+
+	bool indexed = bmpdat.get_palettized() && bmpdat.get_bpp() == 8;
+	int bitdepth = 8;
+	int numcolors = 0;
+	std::vector<unsigned char> raw;
+	int rowbytes;
+
+	if (indexed)
+	{
+		// only as much of the palette as is used
+		int maxindex = 0;
+		for (int i = 0; i < numpix; i++)
+			maxindex = std::max(maxindex, pixels[i] & 0xFF);
+		if (settings.transparent)
+			maxindex = std::max(maxindex, settings.transind & 0xFF);
+		numcolors = maxindex + 1;
+		if (numcolors <= 2)
+			bitdepth = 1;
+		else if (numcolors <= 4)
+			bitdepth = 2;
+		else if (numcolors <= 16)
+			bitdepth = 4;
+
+		// unfiltered rows, packed most significant bits first
+		rowbytes = (width * bitdepth + 7) / 8;
+		raw.assign((rowbytes + 1) * height, 0);
+		int perbyte = 8 / bitdepth;
+		for (int y = 0; y < height; y++)
+		{
+			unsigned char* dest = &raw[y * (rowbytes + 1) + 1];
+			const int* src = pixels + y * width;
+			if (bitdepth == 8)
+			{
+				for (int x = 0; x < width; x++)
+					dest[x] = static_cast<unsigned char>(src[x]);
+			}
+			else
+			{
+				for (int x = 0; x < width; x++)
+				{
+					int shift = 8 - bitdepth * (x % perbyte + 1);
+					dest[x / perbyte] |= (src[x] & 0xFF) << shift;
+				}
+			}
+		}
+	}
+	else
+	{
+		BitmapRGBConverter rgb(bmpdat);
+		rowbytes = width * 3;
+		std::vector<unsigned char> rgbrows(rowbytes * height);
+		for (int i = 0; i < numpix; i++)
+		{
+			int color = rgb(pixels[i]);
+			rgbrows[i * 3] = color & 0xFF;
+			rgbrows[i * 3 + 1] = (color >> 8) & 0xFF;
+			rgbrows[i * 3 + 2] = (color >> 16) & 0xFF;
+		}
+
+		raw.resize((rowbytes + 1) * height);
+		std::vector<unsigned char> scratch;
+		for (int y = 0; y < height; y++)
+		{
+			filter_row(&rgbrows[y * rowbytes], y ? &rgbrows[(y - 1) * rowbytes] : 0,
+				rowbytes, 3, &raw[y * (rowbytes + 1)], scratch);
+		}
+	}
+
+	out.insert(out.end(), png_signature, png_signature + 8);
+
+	char ihdr[13];
+	to_bytes(width, ihdr, 4, DatManip::be);
+	to_bytes(height, ihdr + 4, 4, DatManip::be);
+	ihdr[8] = bitdepth;
+	ihdr[9] = indexed ? png_color_indexed : png_color_truecolor;
+	ihdr[10] = 0;		// deflate
+	ihdr[11] = 0;		// adaptive filtering
+	ihdr[12] = 0;		// no interlacing
+	put_chunk(out, "IHDR", ihdr, 13);
+
+	if (indexed)
+	{
+		std::vector<char> plte(numcolors * 3);
+		BitmapRGBConverter rgb(bmpdat);
+		for (int i = 0; i < numcolors; i++)
+		{
+			int color = rgb(i);
+			plte[i * 3] = color & 0xFF;
+			plte[i * 3 + 1] = (color >> 8) & 0xFF;
+			plte[i * 3 + 2] = (color >> 16) & 0xFF;
+		}
+		put_chunk(out, "PLTE", &plte[0], plte.size());
+
+		if (settings.transparent)
+		{
+			// entries after the transparent one default to opaque
+			int transind = settings.transind & 0xFF;
+			std::vector<char> trns(transind + 1, static_cast<char>(0xFF));
+			trns[transind] = 0;
+			put_chunk(out, "tRNS", &trns[0], trns.size());
+		}
+	}
+
+	std::vector<char> idat;
+	zlib_compress(&raw[0], raw.size(), idat, settings.level);
+	put_chunk(out, "IDAT", &idat[0], idat.size());
+	put_chunk(out, "IEND", 0, 0);
+}
+
+void write_bitmapdata_png(BitmapData& bmpdat, const std::string& filename,
+	const PNGSettings& settings)
+{
+	std::vector<char> file;
+	encode_bitmapdata_png(bmpdat, file, settings);
+	std::ofstream ofs(filename.c_str(), std::ios_base::binary);
+	ofs.write(&file[0], file.size());
+}
+
+
+};	// end namespace RipUtil
@@ -0,0 +1,35 @@
+/* Writer for PNG images, with its own deflate compressor */
+
+#include "BitmapData.h"
+#include "Deflate.h"
+#include <string>
+#include <vector>
+
+namespace RipUtil
+{
+
+
+struct PNGSettings
+{
+	PNGSettings()
+		: level(deflate_strong), transparent(false), transind(0) { };
+
+	DeflateLevel level;
+	bool transparent;	// mark transind as transparent in indexed images?
+	int transind;
+};
+
+// encode an image as PNG, appending it to out. Palettized 8 bpp images
+// become indexed PNGs, with as few bits per pixel and palette entries as
+// the colors used allow; everything else becomes 24-bit truecolor.
+// An image without pixels becomes a single pixel of transind
+void encode_bitmapdata_png(BitmapData& bmpdat, std::vector<char>& out,
+	const PNGSettings& settings);
+
+void write_bitmapdata_png(BitmapData& bmpdat, const std::string& filename,
+	const PNGSettings& settings);
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "PixelPool.h"
+
+#include <vector>
+
+namespace RipUtil
+{
+
+
+namespace
+{
+
+const int min_class_bits = 10;		// smallest class: 1024 pixels
+const int num_classes = 15;			// largest class: 16M pixels
+const int max_kept_per_class = 4;
+
+struct PoolState
+{
+	std::vector<int*> kept[num_classes];
+};
+
+// the state is reached through a plain pointer so that bitmaps destroyed
+// after this thread's pool has been torn down (statics, for example) can
+// still release their buffers safely
+thread_local PoolState* local_state = 0;
+thread_local bool local_state_gone = false;
+
+struct PoolStateOwner
+{
+	~PoolStateOwner()
+	{
+		if (local_state)
+		{
+			for (int i = 0; i < num_classes; i++)
+				for (std::vector<int*>::size_type j = 0; j < local_state->kept[i].size(); j++)
+					delete[] local_state->kept[i][j];
+			delete local_state;
+		}
+		local_state = 0;
+		local_state_gone = true;
+	}
+};
+
+thread_local PoolStateOwner local_state_owner;
+
+PoolState* get_state()
+{
+	if (!local_state && !local_state_gone)
+	{
+		// touching the owner makes sure it exists to clean up at thread exit
+		(void)&local_state_owner;
+		local_state = new PoolState;
+	}
+	return local_state;
+}
+
+// index of the smallest class holding size pixels, or num_classes if none does
+int size_class(int size)
+{
+	int cls = 0;
+	while (cls < num_classes && (1 << (cls + min_class_bits)) < size)
+		++cls;
+	return cls;
+}
+
+};
+
+namespace PixelPool
+{
+
+int* acquire(int size, int& capacity)
+{
+	int cls = size_class(size);
+	if (cls == num_classes)
+	{
+		capacity = size;
+		return new int[size];
+	}
+
+	capacity = 1 << (cls + min_class_bits);
+	PoolState* state = get_state();
+	if (state && !state->kept[cls].empty())
+	{
+		int* buffer = state->kept[cls].back();
+		state->kept[cls].pop_back();
+		return buffer;
+	}
+	return new int[capacity];
+}
+
+void release(int* buffer, int capacity)
+{
+	if (!buffer)
+		return;
+
+	int cls = size_class(capacity);
+	PoolState* state = get_state();
+	if (cls < num_classes && (1 << (cls + min_class_bits)) == capacity
+		&& state && (int)state->kept[cls].size() < max_kept_per_class)
+		state->kept[cls].push_back(buffer);
+	else
+		delete[] buffer;
+}
+
+};
+
+
+};	// end namespace RipUtil
@@ -0,0 +1,45 @@
+/* Per-thread recycling of pixel buffers, so that the bitmaps created
+   and thrown away for every image ripped can reuse each other's memory */
+
+namespace RipUtil
+{
+
+
+// Buffers come in power-of-two size classes. A released buffer is kept by
+// the releasing thread for its next acquire() of the same class, up to a few
+// buffers per class; buffers larger than the biggest class aren't kept.
+// The contents of an acquired buffer are undefined
+namespace PixelPool
+{
+	// get a buffer of at least size ints; capacity receives its actual size
+	int* acquire(int size, int& capacity);
+	// hand back a buffer obtained from acquire()
+	void release(int* buffer, int capacity);
+};
+
+// scratch buffer drawn from the pool for the lifetime of the object
+class PixelBuffer
+{
+public:
+	explicit PixelBuffer(int size)
+		: buffer(PixelPool::acquire(size, capacity)) { };
+	~PixelBuffer()
+	{
+		PixelPool::release(buffer, capacity);
+	}
+
+	int* get() { return buffer; }
+	int& operator[](int i) { return buffer[i]; }
+
+private:
+	PixelBuffer(const PixelBuffer&);
+	PixelBuffer& operator=(const PixelBuffer&);
+
+	int* buffer;
+	int capacity;
+};
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "RectPacker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace RipUtil
+{
+
+
+RectPacker::RectPacker(int w, int pad)
+	: width(w), height(0), padding(pad)
+{
+	SkylineSegment start = { 0, 0, w + pad };
+	skyline.push_back(start);
+}
+
+int RectPacker::fit_at(int i, int rectwidth) const
+{
+	if (skyline[i].x + rectwidth > width + padding)
+		return -1;
+
+	// the rect rests on the highest segment it spans
+	int y = 0;
+	int remaining = rectwidth;
+	for (std::vector<SkylineSegment>::size_type j = i;
+		remaining > 0; j++)
+	{
+		y = std::max(y, skyline[j].y);
+		remaining -= skyline[j].width;
+	}
+	return y;
+}
+
+void RectPacker::insert(PackedRect& rect)
+{
+	int rectwidth = rect.width + padding;
+	int rectheight = rect.height + padding;
+
+	// widen the sheet if this rect wouldn't fit otherwise
+	if (rect.width > width)
+	{
+		SkylineSegment extra = { width + padding, 0, rect.width - width };
+		skyline.push_back(extra);
+		width = rect.width;
+	}
+
+	// lowest top edge wins; the skyline is ordered by x, so ties go to the
+	// leftmost position
+	int best = -1;
+	int besty = 0;
+	for (std::vector<SkylineSegment>::size_type i = 0; i < skyline.size(); i++)
+	{
+		int y = fit_at(i, rectwidth);
+		if (y != -1 && (best == -1 || y < besty))
+		{
+			best = i;
+			besty = y;
+		}
+	}
+
+	rect.x = skyline[best].x;
+	rect.y = besty;
+	height = std::max(height, besty + rect.height);
+
+	// the new segment replaces whatever it covers
+	SkylineSegment placed = { rect.x, besty + rectheight, rectwidth };
+	int right = rect.x + rectwidth;
+	std::vector<SkylineSegment>::size_type last = best;
+	while (last < skyline.size() && skyline[last].x + skyline[last].width <= right)
+		++last;
+	if (last < skyline.size() && skyline[last].x < right)
+	{
+		skyline[last].width -= right - skyline[last].x;
+		skyline[last].x = right;
+	}
+	skyline.erase(skyline.begin() + best, skyline.begin() + last);
+	skyline.insert(skyline.begin() + best, placed);
+
+	// merge neighbors of the same height
+	for (std::vector<SkylineSegment>::size_type i = 1; i < skyline.size(); )
+	{
+		if (skyline[i].y == skyline[i - 1].y)
+		{
+			skyline[i - 1].width += skyline[i].width;
+			skyline.erase(skyline.begin() + i);
+		}
+		else
+			++i;
+	}
+}
+
+namespace
+{
+
+// orders indices into a list of rects, tallest (then widest) first
+struct TallerRect
+{
+	TallerRect(const std::vector<PackedRect>& r)
+		: rects(r) { };
+
+	bool operator()(int a, int b) const
+	{
+		if (rects[a].height != rects[b].height)
+			return rects[a].height > rects[b].height;
+		return rects[a].width > rects[b].width;
+	}
+
+	const std::vector<PackedRect>& rects;
+};
+
+};
+
+void pack_rects(std::vector<PackedRect>& rects, int padding,
+	int& sheetwidth, int& sheetheight)
+{
+	// aim for a square sheet, allowing for the padding and a little waste
+	double area = 0;
+	int widest = 1;
+	std::vector<int> order;
+	for (std::vector<PackedRect>::size_type i = 0; i < rects.size(); i++)
+	{
+		rects[i].x = 0;
+		rects[i].y = 0;
+		if (rects[i].width <= 0 || rects[i].height <= 0)
+			continue;
+		area += (double)(rects[i].width + padding) * (rects[i].height + padding);
+		widest = std::max(widest, rects[i].width);
+		order.push_back(i);
+	}
+	int width = std::max(widest, (int)std::ceil(std::sqrt(area * 1.1)));
+
+	std::stable_sort(order.begin(), order.end(), TallerRect(rects));
+
+	RectPacker packer(width, padding);
+	for (std::vector<int>::size_type i = 0; i < order.size(); i++)
+		packer.insert(rects[order[i]]);
+
+	// the sheet only needs to be as wide as what was actually placed
+	sheetwidth = 1;
+	for (std::vector<int>::size_type i = 0; i < order.size(); i++)
+		sheetwidth = std::max(sheetwidth, rects[order[i]].x + rects[order[i]].width);
+	sheetheight = std::max(1, packer.get_height());
+}
+
+
+};	// end namespace RipUtil
@@ -0,0 +1,62 @@
+/* Skyline rectangle packer, for laying out many small images on a
+   single sheet */
+
+#include <vector>
+
+namespace RipUtil
+{
+
+
+// a rectangle to be packed: width and height are given, x and y are
+// filled in by the packer
+struct PackedRect
+{
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+// Places rectangles on a sheet of fixed width and unbounded height, each at
+// the lowest point along the top edge ("skyline") of those already placed,
+// leftmost first. padding pixels are left between neighboring rectangles.
+// A rectangle wider than the sheet widens it
+class RectPacker
+{
+public:
+	RectPacker(int w, int pad);
+
+	// find a place for rect and set its x and y
+	void insert(PackedRect& rect);
+
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+
+protected:
+	struct SkylineSegment
+	{
+		int x;
+		int y;
+		int width;
+	};
+
+	// y rect would be placed at if its left edge were at segment i,
+	// or -1 if it doesn't fit there
+	int fit_at(int i, int rectwidth) const;
+
+	std::vector<SkylineSegment> skyline;
+	int width;
+	int height;
+	int padding;
+};
+
+// pack rects, tallest first, onto a sheet of roughly square proportions;
+// the rects keep their order. Empty rects are put at 0, 0 and take no space.
+// sheetwidth and sheetheight receive the size of the sheet (at least 1x1)
+void pack_rects(std::vector<PackedRect>& rects, int padding,
+	int& sheetwidth, int& sheetheight);
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
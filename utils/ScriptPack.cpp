@@ -0,0 +1,134 @@
+#include "ScriptPack.h"
+#include "datmanip.h"
+#include <cstring>
+
+namespace RipUtil
+{
+
+
+namespace
+{
+
+
+void put_int(std::vector<char>& out, int pos, int val)
+{
+	to_bytes(val, &out[pos], 4, DatManip::le);
+}
+
+void put_kind(std::vector<char>& out, int pos, const std::string& kind)
+{
+	for (std::string::size_type i = 0; i < 4; i++)
+		out[pos + i] = (i < kind.size() ? kind[i] : ' ');
+}
+
+
+};
+
+
+void ScriptPackWriter::add(int room, const std::string& kind, int number,
+	const char* data, int length)
+{
+	ScriptPackEntry entry;
+	entry.room = room;
+	entry.kind = kind;
+	entry.number = number;
+	entry.offset = payloads.size();
+	entry.length = length;
+	entries.push_back(entry);
+
+	payloads.insert(payloads.end(), data, data + length);
+}
+
+void ScriptPackWriter::add(const ScriptPackWriter& other)
+{
+	for (std::vector<ScriptPackEntry>::size_type i = 0; i < other.entries.size(); i++)
+	{
+		entries.push_back(other.entries[i]);
+		entries.back().offset += payloads.size();
+	}
+	payloads.insert(payloads.end(), other.payloads.begin(), other.payloads.end());
+}
+
+void ScriptPackWriter::clear()
+{
+	entries.clear();
+	payloads.clear();
+}
+
+void ScriptPackWriter::build(std::vector<char>& out) const
+{
+	int indexsize = entries.size() * scriptpack_entry_size;
+	int datastart = scriptpack_header_size + indexsize;
+
+	out.assign(datastart, 0);
+	std::memcpy(&out[0], "HESP", 4);
+	put_int(out, 4, scriptpack_version);
+	put_int(out, 8, entries.size());
+	put_int(out, 12, scriptpack_header_size);
+
+	for (std::vector<ScriptPackEntry>::size_type i = 0; i < entries.size(); i++)
+	{
+		int pos = scriptpack_header_size + i * scriptpack_entry_size;
+		put_int(out, pos, entries[i].room);
+		put_kind(out, pos + 4, entries[i].kind);
+		put_int(out, pos + 8, entries[i].number);
+		put_int(out, pos + 12, datastart + entries[i].offset);
+		put_int(out, pos + 16, entries[i].length);
+	}
+
+	out.insert(out.end(), payloads.begin(), payloads.end());
+}
+
+ScriptPackReader::ScriptPackReader()
+	: data(0) { };
+
+bool ScriptPackReader::open(const char* dat, int size)
+{
+	data = 0;
+	entries.clear();
+
+	if (size < scriptpack_header_size || std::memcmp(dat, "HESP", 4)
+		|| to_int(dat + 4, 4, DatManip::le) != scriptpack_version)
+		return false;
+
+	int count = to_int(dat + 8, 4, DatManip::le);
+	int indexpos = to_int(dat + 12, 4, DatManip::le);
+	if (count < 0 || indexpos < scriptpack_header_size || indexpos > size
+		|| count > (size - indexpos) / scriptpack_entry_size)
+		return false;
+
+	for (int i = 0; i < count; i++)
+	{
+		const char* p = dat + indexpos + i * scriptpack_entry_size;
+		ScriptPackEntry entry;
+		entry.room = to_int(p, 4, DatManip::le);
+		entry.kind = std::string(p + 4, 4);
+		entry.number = to_int(p + 8, 4, DatManip::le);
+		entry.offset = to_int(p + 12, 4, DatManip::le);
+		entry.length = to_int(p + 16, 4, DatManip::le);
+		if (entry.offset < 0 || entry.length < 0 || entry.offset > size
+			|| entry.length > size - entry.offset)
+		{
+			entries.clear();
+			return false;
+		}
+		entries.push_back(entry);
+	}
+
+	data = dat;
+	return true;
+}
+
+int ScriptPackReader::find(int room, const std::string& kind, int number) const
+{
+	for (std::vector<ScriptPackEntry>::size_type i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].room == room && entries[i].number == number
+			&& entries[i].kind == kind)
+			return i;
+	}
+	return -1;
+}
+
+
+};	// end namespace RipUtil
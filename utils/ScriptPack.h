@@ -0,0 +1,77 @@
+/* Container for dumped script chunks: every payload stored back to back
+   behind a binary index, so that the whole file can be mapped and each
+   script found and read in place
+
+   Layout, with all integers 32-bit little-endian:
+     header   "HESP", version (1), entry count, offset of the index
+     index    per entry: room, kind (4 characters, e.g. "SCRP"), number,
+              offset of the payload from the start of the file, length
+     payloads one after another, in index order */
+
+#include <string>
+#include <vector>
+
+namespace RipUtil
+{
+
+
+const int scriptpack_version = 1;
+const int scriptpack_header_size = 16;
+const int scriptpack_entry_size = 20;
+
+struct ScriptPackEntry
+{
+	int room;
+	std::string kind;
+	int number;
+	int offset;
+	int length;
+};
+
+// collects scripts over a rip and lays out the container at the end
+class ScriptPackWriter
+{
+public:
+	// kind is padded or cut to 4 characters
+	void add(int room, const std::string& kind, int number,
+		const char* data, int length);
+	// add every script of other, after those already added
+	void add(const ScriptPackWriter& other);
+
+	bool empty() const { return entries.empty(); }
+	void clear();
+
+	// the finished container, replacing the contents of out
+	void build(std::vector<char>& out) const;
+
+protected:
+	std::vector<ScriptPackEntry> entries;	// offsets relative to payloads
+	std::vector<char> payloads;
+};
+
+// reads a container in memory without copying it; the data must outlive
+// the reader
+class ScriptPackReader
+{
+public:
+	ScriptPackReader();
+
+	// false if data isn't a container of a known version, or is cut short
+	bool open(const char* data, int size);
+
+	int size() const { return entries.size(); }
+	const ScriptPackEntry& entry(int index) const { return entries[index]; }
+	const char* payload(int index) const { return data + entries[index].offset; }
+
+	// index of the given script, or -1 if there isn't one
+	int find(int room, const std::string& kind, int number) const;
+
+protected:
+	const char* data;
+	std::vector<ScriptPackEntry> entries;
+};
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+
+namespace RipUtil
+{
+
+
+ThreadPool::ThreadPool(int numthreads)
+	: job(0), jobcount(0), nexttask(0), busyworkers(0), generation(0), stopping(false)
+{
+	for (int i = 1; i < numthreads; i++)
+		workers.push_back(std::thread(&ThreadPool::worker_loop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(statemutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::vector<std::thread>::size_type i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void ThreadPool::parallel_for(int count, const std::function<void(int)>& task)
+{
+	if (count <= 0)
+		return;
+
+	// nothing to gain from handing a single task to a worker
+	if (workers.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+			task(i);
+		return;
+	}
+
+	std::lock_guard<std::mutex> calllock(callmutex);
+	{
+		std::lock_guard<std::mutex> lock(statemutex);
+		job = &task;
+		jobcount = count;
+		nexttask = 0;
+		busyworkers = workers.size();
+		++generation;
+	}
+	wake.notify_all();
+
+	run_tasks();
+
+	std::unique_lock<std::mutex> lock(statemutex);
+	while (busyworkers > 0)
+		finished.wait(lock);
+	job = 0;
+}
+
+void ThreadPool::worker_loop()
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(statemutex);
+			while (!stopping && generation == seen)
+				wake.wait(lock);
+			if (stopping)
+				return;
+			seen = generation;
+		}
+
+		run_tasks();
+
+		std::lock_guard<std::mutex> lock(statemutex);
+		if (--busyworkers == 0)
+			finished.notify_all();
+	}
+}
+
+void ThreadPool::run_tasks()
+{
+	int i;
+	while ((i = nexttask++) < jobcount)
+		(*job)(i);
+}
+
+
+};	// end namespace RipUtil
@@ -0,0 +1,52 @@
+/* A fixed set of worker threads for splitting a loop of independent
+   tasks across cores */
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace RipUtil
+{
+
+
+class ThreadPool
+{
+public:
+	// numthreads counts the calling thread, so a pool of n starts n - 1 workers
+	explicit ThreadPool(int numthreads);
+	~ThreadPool();
+
+	int get_numthreads() const { return workers.size() + 1; }
+
+	// call task(i) for every i in [0, count) and wait for all calls to finish.
+	// The calls are spread over the workers and the calling thread, in no
+	// particular order; concurrent calls from different threads take turns
+	void parallel_for(int count, const std::function<void(int)>& task);
+
+private:
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+	void worker_loop();
+	void run_tasks();
+
+	std::vector<std::thread> workers;
+	std::mutex callmutex;			// held for the length of a parallel_for
+	std::mutex statemutex;			// guards everything below
+	std::condition_variable wake;
+	std::condition_variable finished;
+	const std::function<void(int)>* job;
+	int jobcount;
+	std::atomic<int> nexttask;
+	int busyworkers;
+	unsigned int generation;
+	bool stopping;
+};
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
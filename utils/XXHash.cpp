@@ -0,0 +1,118 @@
+#include "XXHash.h"
+
+#include <cstring>
+
+namespace RipUtil
+{
+
+
+namespace
+{
+
+const unsigned long long prime1 = 0x9E3779B185EBCA87ULL;
+const unsigned long long prime2 = 0xC2B2AE3D27D4EB4FULL;
+const unsigned long long prime3 = 0x165667B19E3779F9ULL;
+const unsigned long long prime4 = 0x85EBCA77C2B2AE63ULL;
+const unsigned long long prime5 = 0x27D4EB2F165667C5ULL;
+
+inline unsigned long long rotl(unsigned long long x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+// little-endian loads, whatever the host order
+inline unsigned long long read64(const unsigned char* p)
+{
+	unsigned long long v = 0;
+	for (int i = 7; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+inline unsigned long long read32(const unsigned char* p)
+{
+	return (unsigned long long)p[0] | ((unsigned long long)p[1] << 8)
+		| ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24);
+}
+
+inline unsigned long long round(unsigned long long acc, unsigned long long input)
+{
+	acc += input * prime2;
+	acc = rotl(acc, 31);
+	return acc * prime1;
+}
+
+inline unsigned long long merge_round(unsigned long long acc, unsigned long long val)
+{
+	acc ^= round(0, val);
+	return acc * prime1 + prime4;
+}
+
+};
+
+unsigned long long xxh64(const void* data, std::size_t len,
+	unsigned long long seed)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	const unsigned char* end = p + len;
+	unsigned long long h;
+
+	if (len >= 32)
+	{
+		// four lanes of 8 bytes each per 32-byte stripe
+		unsigned long long v1 = seed + prime1 + prime2;
+		unsigned long long v2 = seed + prime2;
+		unsigned long long v3 = seed;
+		unsigned long long v4 = seed - prime1;
+		const unsigned char* limit = end - 32;
+		do
+		{
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = merge_round(h, v1);
+		h = merge_round(h, v2);
+		h = merge_round(h, v3);
+		h = merge_round(h, v4);
+	}
+	else
+		h = seed + prime5;
+
+	h += len;
+
+	// remaining bytes, 8, then 4, then 1 at a time
+	while (p + 8 <= end)
+	{
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * prime1 + prime4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= read32(p) * prime1;
+		h = rotl(h, 23) * prime2 + prime3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		h ^= (*p) * prime5;
+		h = rotl(h, 11) * prime1;
+		++p;
+	}
+
+	// avalanche
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	h *= prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+
+};	// end namespace RipUtil
@@ -0,0 +1,16 @@
+/* XXH64, a fast non-cryptographic 64-bit hash, for recognizing repeated
+   output without comparing it byte for byte */
+
+#include <cstddef>
+
+namespace RipUtil
+{
+
+
+unsigned long long xxh64(const void* data, std::size_t len,
+	unsigned long long seed = 0);
+
+
+};	// end namespace RipUtil
+
+#pragma once
\ No newline at end of file
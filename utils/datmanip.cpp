@@ -100,6 +100,89 @@ std::string strip_extension(const std::string& fname)
 	return fname.substr(0, fname.find_last_of('.'));
 }
 
+std::string strip_path(const std::string& fname)
+{
+	std::string::size_type lastsep = fname.find_last_of("/\\");
+	if (lastsep == fname.npos)
+		return fname;
+	return fname.substr(lastsep + 1);
+}
+
+// length of the well-formed UTF-8 sequence starting at s[pos] (a lead byte
+// of 0x80 or more), or 0 if there isn't one: overlong forms, surrogates and
+// code points past U+10FFFF don't count
+int utf8_sequence_length(const std::string& s, std::string::size_type pos)
+{
+	unsigned char c = s[pos];
+	int length;
+	unsigned char lo = 0x80;
+	unsigned char hi = 0xBF;
+	if (c >= 0xC2 && c <= 0xDF)
+		length = 2;
+	else if (c >= 0xE0 && c <= 0xEF)
+	{
+		length = 3;
+		if (c == 0xE0)
+			lo = 0xA0;
+		else if (c == 0xED)
+			hi = 0x9F;
+	}
+	else if (c >= 0xF0 && c <= 0xF4)
+	{
+		length = 4;
+		if (c == 0xF0)
+			lo = 0x90;
+		else if (c == 0xF4)
+			hi = 0x8F;
+	}
+	else
+		return 0;
+
+	if (pos + length > s.size())
+		return 0;
+	unsigned char next = s[pos + 1];
+	if (next < lo || next > hi)
+		return 0;
+	for (int i = 2; i < length; i++)
+	{
+		next = s[pos + i];
+		if (next < 0x80 || next > 0xBF)
+			return 0;
+	}
+	return length;
+}
+
+std::string json_string(const std::string& s)
+{
+	const char* hexdigits = "0123456789abcdef";
+	std::string result = "\"";
+	for (std::string::size_type i = 0; i < s.size(); i++)
+	{
+		unsigned char c = s[i];
+		int seqlength;
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+			result += c;
+		}
+		else if (c >= 0x80 && (seqlength = utf8_sequence_length(s, i)))
+		{
+			result.append(s, i, seqlength);
+			i += seqlength - 1;
+		}
+		else if (c < 0x20 || c >= 0x7F)
+		{
+			result += "\\u00";
+			result += hexdigits[c >> 4];
+			result += hexdigits[c & 0xF];
+		}
+		else
+			result += c;
+	}
+	result += '"';
+	return result;
+}
+
 std::string strip_terminators(const std::string& fname, const std::string& chars)
 {
 	std::string::size_type lastper = fname.rfind(".");
@@ -32,6 +32,14 @@ template<typename T> std::string to_string(T in)
 	return oss.str();
 }
 
+// integers, which most file names are built from, without a stream
+inline std::string to_string(int in) { return std::to_string(in); }
+inline std::string to_string(unsigned int in) { return std::to_string(in); }
+inline std::string to_string(long in) { return std::to_string(in); }
+inline std::string to_string(unsigned long in) { return std::to_string(in); }
+inline std::string to_string(long long in) { return std::to_string(in); }
+inline std::string to_string(unsigned long long in) { return std::to_string(in); }
+
 // return a T representation of string in
 template<typename T> T from_string(std::string in)
 {
@@ -91,6 +99,15 @@ int set_end(int s, int n, DatManip::End e);
 // return a filename with extension stripped
 std::string strip_extension(const std::string& fname);
 
+// return a filename with any leading directories stripped
+std::string strip_path(const std::string& fname);
+
+// return s quoted and escaped as a JSON string. Well-formed UTF-8 is
+// passed through as it is, so UTF-8 names stay readable; any other byte
+// above 0x7F is taken to be Latin-1 (names from the game data are in the
+// game's codepage) and escaped, so the result is always valid UTF-8
+std::string json_string(const std::string& s);
+
 // return a filename with given characters removed from end
 std::string strip_terminators(const std::string& fname, const std::string& chars);
 